@@ -96,10 +96,47 @@ struct GRAYCORE_LINK StrFormat : public StrFormatParams {
     void RenderUInt(StrBuilder<TYPE>& out, const TYPE* pszPrefix, RADIX_t nRadix, char chRadixA, UINT64 uVal) const;
     void RenderFloat(StrBuilder<TYPE>& out, double dVal, char chE = -'e') const;
 
+    /// <summary>
+    /// The value of a single argument. Read from va_list or a StrFormatArgs pack.
+    /// </summary>
+    union ARG_t {
+        INT64 _nVal;         /// 'd','i','c'
+        UINT64 _uVal;        /// 'u','x','X','o','p'
+        double _dVal;        /// 'e','f','g', etc.
+        const TYPE* _pszVal; /// 's'
+    };
+
+    /// <summary>
+    /// Size of the argument for the current spec. 'p' is the size of a pointer.
+    /// </summary>
+    /// <returns>0=int (32 bit), 1=long, 2=long long (64 bit)</returns>
+    BYTE get_LongType() const noexcept {
+        if (_chSpec == 'p') {
+#ifdef USE_64BIT
+            return 2;
+#else
+            return 1;
+#endif
+        }
+        return _eLongType;
+    }
+
+    /// <summary>
+    /// Read the argument for the current spec. (not the width arg)
+    /// </summary>
+    ARG_t GetArgV(va_list* pvlist) const;
+
+    /// <summary>
+    /// Render the current single parameter/spec with its argument value.
+    /// </summary>
+    void RenderArg(StrBuilder<TYPE>& out, const ARG_t& arg) const;
+
     /// <summary>
     /// Render the current single parameter/spec.
     /// </summary>
-    void RenderParam(StrBuilder<TYPE>& out, va_list* pvlist) const;
+    void RenderParam(StrBuilder<TYPE>& out, va_list* pvlist) const {
+        RenderArg(out, GetArgV(pvlist));
+    }
 
     static void GRAYCALL V(StrBuilder<TYPE>& out, const TYPE* pszFormat, va_list vlist);
     static inline StrLen_t GRAYCALL V(cSpanX<TYPE> ret, const TYPE* pszFormat, va_list vlist);
@@ -109,6 +146,49 @@ struct GRAYCORE_LINK StrFormat : public StrFormatParams {
     static inline StrLen_t _cdecl F(cSpanX<TYPE> ret, const TYPE* pszFormat, ...);  // STRFORMAT_t for testing
 };
 
+/// <summary>
+/// Capture a printf() format and its arguments now. Render the string later. (if ever)
+/// Arguments are copied into a compact binary pack. Ints are 4 or 8 bytes, doubles 8, strings are copied in.
+/// So nothing the args point to needs to live on. Only the format string is kept as a pointer. It MUST be static. e.g. a literal.
+/// </summary>
+/// <typeparam name="TYPE">char or wchar_t</typeparam>
+template <typename TYPE = char>
+class GRAYCORE_LINK StrFormatArgs {
+ public:
+    static const size_t k_nSizeArgsMax = 224;  /// bytes of args we can hold.
+
+ private:
+    const TYPE* _pszFormat = nullptr;  /// static format string. nullptr = nothing captured.
+    WORD _nSizeArgs = 0;               /// bytes used in _Args.
+    BYTE _Args[k_nSizeArgsMax];        /// packed args in format order.
+
+ public:
+    bool isEmpty() const noexcept {
+        return _pszFormat == nullptr;
+    }
+    const TYPE* get_Format() const noexcept {
+        return _pszFormat;
+    }
+    size_t get_SizeArgs() const noexcept {
+        return _nSizeArgs;
+    }
+    void Clear() noexcept {
+        _pszFormat = nullptr;
+        _nSizeArgs = 0;
+    }
+
+    /// <summary>
+    /// Copy all the args for pszFormat out of vlist.
+    /// </summary>
+    /// <returns>false = args are too big or the format has something StrFormat doesn't support. (e.g. a single 'l' on non _WIN32) Must format now. vlist is used.</returns>
+    bool Capture(const TYPE* pszFormat, va_list vlist);
+
+    /// <summary>
+    /// Render the format with the captured args. Same as StrFormat::V() would have at Capture() time.
+    /// </summary>
+    void Render(StrBuilder<TYPE>& out) const;
+};
+
 /// <summary>
 /// strings may contain template blocks to be replaced. e.g. "&lt;?something?&gt;".
 /// similar to expressions.
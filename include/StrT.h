@@ -743,7 +743,8 @@ StrLen_t inline StrT::Len<char>(const char* pszStr) noexcept {  // count of char
     if (pszStr == nullptr) return 0;
     return CastN(StrLen_t, ::strlen(pszStr));
 #elif defined(__GNUC__)
-    return (StrLen_t)::__builtin_strlen(p1, p2, nSizeBlock);
+    if (pszStr == nullptr) return 0;
+    return CastN(StrLen_t, ::__builtin_strlen(pszStr));
 #else
     return Len2(pszStr, cStrConst::k_LEN_MAX);
 #endif
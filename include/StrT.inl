@@ -11,6 +11,7 @@
 #include "StrA.h"
 #include "StrConst.h"
 #include "cValT.h"
+#include "StrTSimd.inl"
 
 namespace Gray {
 //***************************************************************************
@@ -51,7 +52,7 @@ COMPARE_t GRAYCALL StrT::CmpI(const TYPE* pszStr1, const TYPE* pszStr2) noexcept
     if (pszStr1 == pszStr2) return COMPARE_Equal;
     if (pszStr1 == nullptr) return COMPARE_Less;
     if (pszStr2 == nullptr) return COMPARE_Greater;
-    for (StrLen_t i = 0;; i++) {
+    for (StrLen_t i = StrTSimd::CmpIStop(pszStr1, pszStr2, cStrConst::k_LEN_MAX);; i++) {  // skip the equal part.
         DEBUG_CHECK(i < cStrConst::k_LEN_MAX);
         const TYPE ch1 = pszStr1[i];
         const COMPARE_t iDiff = StrChar::CmpI(ch1, pszStr2[i]);
@@ -66,7 +67,7 @@ COMPARE_t GRAYCALL StrT::CmpIN(const TYPE* pszStr1, const TYPE* pszStr2, StrLen_
     if (pszStr2 == nullptr) return COMPARE_Greater;
     if (iLenMaxChars < 0) return COMPARE_Less;
     DEBUG_CHECK(iLenMaxChars <= cStrConst::k_LEN_MAX);
-    for (StrLen_t i = 0; i < iLenMaxChars; i++) {
+    for (StrLen_t i = StrTSimd::CmpIStop(pszStr1, pszStr2, iLenMaxChars); i < iLenMaxChars; i++) {  // skip the equal part.
         const COMPARE_t iDiff = StrChar::CmpI(pszStr1[i], pszStr2[i]);
         if (pszStr1[i] == '\0' || iDiff != 0) return iDiff;
     }
@@ -126,12 +127,9 @@ HASHCODE32_t GRAYCALL StrT::GetHashCode32(const cSpan<TYPE>& str) noexcept {
 template <typename TYPE>
 StrLen_t GRAYCALL StrT::FindCharN(const TYPE* pszStr, TYPE chFind, StrLen_t iLenMax) noexcept {
     if (pszStr == nullptr) return k_StrLen_UNK;
-    for (StrLen_t i = 0; iLenMax > 0; iLenMax--, i++) {
-        const TYPE chN = pszStr[i];
-        if (chN == chFind) return i;
-        if (chN == '\0') break;  // found the end.
-    }
-    return k_StrLen_UNK;
+    const StrLen_t i = StrTSimd::FindStop(pszStr, chFind, chFind, iLenMax);  // stops at the end too.
+    if (i >= iLenMax || pszStr[i] != chFind) return k_StrLen_UNK;
+    return i;
 }
 template <typename TYPE>
 TYPE* GRAYCALL StrT::FindChar(const TYPE* pszStr, TYPE chFind, StrLen_t iLenMax) noexcept {
@@ -154,25 +152,25 @@ TYPE* GRAYCALL StrT::FindTokens(const cSpan<TYPE>& str, const TYPE* pszTokens) {
     if (str.isNull() || pszTokens == nullptr) return nullptr;
     const StrLen_t iLenMax = str.get_MaxLen();
     const TYPE* pszStr = str;
-    for (StrLen_t i = 0;; i++, pszStr++) {
-        if (i >= iLenMax) return nullptr;
-        if (StrT::HasChar(pszTokens, *pszStr)) return const_cast<TYPE*>(pszStr);
-    }
+    const StrLen_t i = StrTSimd::FindTokens(pszStr, iLenMax, pszTokens);  // '\0' counts as a token.
+    if (i >= iLenMax) return nullptr;
+    return const_cast<TYPE*>(pszStr) + i;
 }
 
 template <typename TYPE>
 StrLen_t GRAYCALL StrT::FindStrN(const TYPE* pszText, const TYPE* pszSubStr, StrLen_t iLenMaxChars) {
     if (pszText == nullptr || pszSubStr == nullptr) return k_StrLen_UNK;
-    for (StrLen_t i = 0, iMatch = 0; i < iLenMaxChars; i++) {
-        const TYPE ch = pszText[i];
-        if (ch == '\0') break;
-        if (ch == pszSubStr[iMatch]) {
-            iMatch++;                                                // look for next char.
-            if (pszSubStr[iMatch] == '\0') return (i - iMatch) + 1;  // found match!
-        } else if (iMatch != 0) {
-            i -= iMatch;  // non match. must revert back to start of non match. handle internal repeats.
-            iMatch = 0;
+    const TYPE chFirst = pszSubStr[0];
+    if (chFirst == '\0') return k_StrLen_UNK;
+    for (StrLen_t i = 0; i < iLenMaxChars; i++) {
+        i += StrTSimd::FindStop(pszText + i, chFirst, chFirst, iLenMaxChars - i);  // skip to the next candidate.
+        if (i >= iLenMaxChars || pszText[i] == '\0') break;
+        StrLen_t iMatch = 1;
+        for (; pszSubStr[iMatch] != '\0'; iMatch++) {
+            if (i + iMatch >= iLenMaxChars) return k_StrLen_UNK;  // match can't fit.
+            if (pszText[i + iMatch] != pszSubStr[iMatch]) break;  // non match. try the next start.
         }
+        if (pszSubStr[iMatch] == '\0') return i;  // found match!
     }
     return k_StrLen_UNK;
 }
@@ -186,16 +184,17 @@ TYPE* GRAYCALL StrT::FindStr(const TYPE* pszText, const TYPE* pszSubStr, StrLen_
 template <typename TYPE>
 StrLen_t GRAYCALL StrT::FindStrNI(const TYPE* pszText, const TYPE* pszSubStr, StrLen_t iLenMaxChars) {
     if (pszText == nullptr || pszSubStr == nullptr) return k_StrLen_UNK;
-    for (StrLen_t i = 0, iMatch = 0; i < iLenMaxChars; i++) {
-        const TYPE ch = pszText[i];
-        if (ch == '\0') break;
-        if (StrChar::CmpI(ch, pszSubStr[iMatch]) == 0) {             // ignore case match.
-            iMatch++;                                                // look for next char.
-            if (pszSubStr[iMatch] == '\0') return (i - iMatch) + 1;  // found match!
-        } else if (iMatch != 0) {
-            i -= iMatch;  // non match. must revert back to start of non match. handle internal repeats.
-            iMatch = 0;
+    const TYPE chFirst = pszSubStr[0];
+    if (chFirst == '\0') return k_StrLen_UNK;
+    for (StrLen_t i = 0; i < iLenMaxChars; i++) {
+        i += StrTSimd::FindStopI(pszText + i, chFirst, iLenMaxChars - i);  // skip to the next candidate. ignore case.
+        if (i >= iLenMaxChars || pszText[i] == '\0') break;
+        StrLen_t iMatch = 1;
+        for (; pszSubStr[iMatch] != '\0'; iMatch++) {
+            if (i + iMatch >= iLenMaxChars) return k_StrLen_UNK;  // match can't fit.
+            if (StrChar::CmpI(pszText[i + iMatch], pszSubStr[iMatch]) != 0) break;  // non match. try the next start.
         }
+        if (pszSubStr[iMatch] == '\0') return i;  // found match!
     }
     return k_StrLen_UNK;
 }
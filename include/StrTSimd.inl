@@ -0,0 +1,335 @@
+//! @file StrTSimd.inl
+//! SSE2/AVX2 kernels for the StrT scanners. included by "StrT.inl" and "StrU.cpp" only.
+//! Kernels only find where the scalar loop must stop (or resume). So results are the same as the scalar code.
+//! @note aligned loads never cross a page so they may safely read past the '\0' (like the CRT strlen).
+//! But ASan/MSan and valgrind report it. So they get the scalar path. Define USE_VALGRIND for valgrind builds.
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+
+#ifndef _INC_StrTSimd_INL
+#define _INC_StrTSimd_INL
+#ifndef NO_PRAGMA_ONCE
+#pragma once
+#endif
+
+#include "StrChar.h"
+#include "StrConst.h"
+
+#if !defined(_MANAGED) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define USE_SIMD_SSE2 1
+#include <emmintrin.h>
+#if defined(_MSC_VER) || defined(__GNUC__)
+#define USE_SIMD_AVX2 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>  // __cpuid, _xgetbv
+#define STRSIMD_AVX2
+#else
+#define STRSIMD_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+#endif
+
+// The aligned kernels read before and after the string. Sanitizers can't know that is safe.
+#if defined(__SANITIZE_ADDRESS__) || defined(USE_VALGRIND)
+#define STRSIMD_NO_OVERREAD 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(memory_sanitizer)
+#define STRSIMD_NO_OVERREAD 1
+#endif
+#endif
+
+namespace Gray {
+/// <summary>
+/// Vector kernels for StrT. For char and wchar_t (2 or 4 bytes).
+/// Each has a scalar fallback if no USE_SIMD_SSE2 or the pointer is not aligned to the char size.
+/// </summary>
+struct StrTSimd {  // static
+    static const size_t k_nPageSize = 4096;  /// unaligned loads must not cross this.
+
+    /// <summary>
+    /// Lowest set bit index. ASSUME nMask != 0.
+    /// </summary>
+    static inline unsigned GetLowBit(UINT32 nMask) noexcept {
+#ifdef _MSC_VER
+        unsigned long nIndex;
+        ::_BitScanForward(&nIndex, nMask);
+        return CastN(unsigned, nIndex);
+#elif defined(__GNUC__)
+        return CastN(unsigned, __builtin_ctz(nMask));
+#else
+        unsigned nIndex = 0;
+        while ((nMask & 1) == 0) {
+            nMask >>= 1;
+            nIndex++;
+        }
+        return nIndex;
+#endif
+    }
+
+    template <typename TYPE>
+    static StrLen_t FindStopScalar(const TYPE* pszStr, TYPE ch1, TYPE ch2, StrLen_t iLenMax) noexcept {
+        StrLen_t i = 0;
+        for (; i < iLenMax; i++) {
+            const TYPE ch = pszStr[i];
+            if (ch == ch1 || ch == ch2 || ch == '\0') break;
+        }
+        return i;
+    }
+
+#ifdef USE_SIMD_SSE2
+    /// <summary>
+    /// compare lanes of 1,2,4 bytes (sizeof TYPE)
+    /// </summary>
+    template <size_t _SIZE>
+    struct cLane;
+
+    static bool GRAYCALL isAvx2() noexcept {
+        static const bool s_bAvx2 = DetectAvx2();  // once.
+        return s_bAvx2;
+    }
+    static bool GRAYCALL DetectAvx2() noexcept {
+#if !defined(USE_SIMD_AVX2)
+        return false;
+#elif defined(_MSC_VER)
+        int aInfo[4];
+        ::__cpuid(aInfo, 0);
+        if (aInfo[0] < 7) return false;
+        ::__cpuid(aInfo, 1);
+        if ((aInfo[2] & (1 << 27)) == 0 || (aInfo[2] & (1 << 28)) == 0) return false;  // OSXSAVE and AVX
+        if ((::_xgetbv(0) & 6) != 6) return false;                                   // OS saves YMM state.
+        ::__cpuidex(aInfo, 7, 0);
+        return (aInfo[1] & (1 << 5)) != 0;  // AVX2
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    /// <summary>
+    /// Scan 16 byte aligned blocks for ch1 or ch2 or '\0'.
+    /// </summary>
+    template <typename TYPE>
+    static StrLen_t FindStopSSE2(const TYPE* pszStr, TYPE ch1, TYPE ch2, StrLen_t iLenMax) noexcept {
+        typedef cLane<sizeof(TYPE)> LANE_t;
+        const __m128i v1 = LANE_t::Set(ch1);
+        const __m128i v2 = LANE_t::Set(ch2);
+        const __m128i vZero = _mm_setzero_si128();
+        const unsigned nOffset = CastN(unsigned, CastPtrToNum(pszStr) & 15);  // bytes before pszStr in the first block.
+        const __m128i* pBlock = reinterpret_cast<const __m128i*>(reinterpret_cast<const BYTE*>(pszStr) - nOffset);
+        __m128i v = _mm_load_si128(pBlock);
+        UINT32 nMask = CastN(UINT32, _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(LANE_t::CmpEq(v, v1), LANE_t::CmpEq(v, v2)), LANE_t::CmpEq(v, vZero)))) >> nOffset;
+        StrLen_t i = 0;  // index of the first char in nMask.
+        StrLen_t nBlockChars = CastN(StrLen_t, (16 - nOffset) / sizeof(TYPE));
+        for (;;) {
+            if (nMask != 0) return cValT::Min(i + CastN(StrLen_t, GetLowBit(nMask) / sizeof(TYPE)), iLenMax);
+            i += nBlockChars;
+            if (i >= iLenMax) return iLenMax;
+            nBlockChars = 16 / sizeof(TYPE);
+            v = _mm_load_si128(++pBlock);
+            nMask = CastN(UINT32, _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(LANE_t::CmpEq(v, v1), LANE_t::CmpEq(v, v2)), LANE_t::CmpEq(v, vZero))));
+        }
+    }
+
+#ifdef USE_SIMD_AVX2
+    /// <summary>
+    /// Scan 32 byte aligned blocks for ch1 or ch2 or '\0'.
+    /// </summary>
+    template <typename TYPE>
+    STRSIMD_AVX2 static StrLen_t FindStopAVX2(const TYPE* pszStr, TYPE ch1, TYPE ch2, StrLen_t iLenMax) noexcept {
+        typedef cLane<sizeof(TYPE)> LANE_t;
+        const __m256i v1 = LANE_t::Set256(ch1);
+        const __m256i v2 = LANE_t::Set256(ch2);
+        const __m256i vZero = _mm256_setzero_si256();
+        const unsigned nOffset = CastN(unsigned, CastPtrToNum(pszStr) & 31);
+        const __m256i* pBlock = reinterpret_cast<const __m256i*>(reinterpret_cast<const BYTE*>(pszStr) - nOffset);
+        __m256i v = _mm256_load_si256(pBlock);
+        UINT32 nMask = CastN(UINT32, _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(LANE_t::CmpEq256(v, v1), LANE_t::CmpEq256(v, v2)), LANE_t::CmpEq256(v, vZero)))) >> nOffset;
+        StrLen_t i = 0;
+        StrLen_t nBlockChars = CastN(StrLen_t, (32 - nOffset) / sizeof(TYPE));
+        for (;;) {
+            if (nMask != 0) return cValT::Min(i + CastN(StrLen_t, GetLowBit(nMask) / sizeof(TYPE)), iLenMax);
+            i += nBlockChars;
+            if (i >= iLenMax) return iLenMax;
+            nBlockChars = 32 / sizeof(TYPE);
+            v = _mm256_load_si256(++pBlock);
+            nMask = CastN(UINT32, _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(LANE_t::CmpEq256(v, v1), LANE_t::CmpEq256(v, v2)), LANE_t::CmpEq256(v, vZero))));
+        }
+    }
+#endif
+
+    /// <summary>
+    /// Fold 'A'-'Z' to 'a'-'z' in 16 chars. Same as StrChar::ToLowerA()
+    /// </summary>
+    static inline __m128i ToLowerA16(__m128i v) noexcept {
+        const __m128i vUpper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));  // signed. 0x80+ is never upper.
+        return _mm_add_epi8(v, _mm_and_si128(vUpper, _mm_set1_epi8('a' - 'A')));
+    }
+#endif  // USE_SIMD_SSE2
+
+    /// <summary>
+    /// Find the first char that is ch1 or ch2 or '\0'.
+    /// </summary>
+    /// <returns>index of the char or iLenMax if none before that.</returns>
+    template <typename TYPE>
+    static StrLen_t FindStop(const TYPE* pszStr, TYPE ch1, TYPE ch2, StrLen_t iLenMax) noexcept {
+        if (iLenMax <= 0) return 0;
+#if defined(USE_SIMD_SSE2) && !defined(STRSIMD_NO_OVERREAD)
+        if ((CastPtrToNum(pszStr) % sizeof(TYPE)) == 0) {  // else blocks would split chars.
+#ifdef USE_SIMD_AVX2
+            if (iLenMax >= CastN(StrLen_t, 32 / sizeof(TYPE)) && isAvx2()) return FindStopAVX2(pszStr, ch1, ch2, iLenMax);
+#endif
+            return FindStopSSE2(pszStr, ch1, ch2, iLenMax);
+        }
+#endif
+        return FindStopScalar(pszStr, ch1, ch2, iLenMax);
+    }
+
+    /// <summary>
+    /// Find the first char that StrChar::CmpI() matches chFind, or '\0'.
+    /// </summary>
+    /// <returns>index of the char or iLenMax if none before that.</returns>
+    template <typename TYPE>
+    static StrLen_t FindStopI(const TYPE* pszStr, TYPE chFind, StrLen_t iLenMax) noexcept {
+        // UNICODE case sets are not just pairs. stay scalar.
+        StrLen_t i = 0;
+        for (; i < iLenMax; i++) {
+            const TYPE ch = pszStr[i];
+            if (ch == '\0' || StrChar::CmpI(ch, chFind) == 0) break;
+        }
+        return i;
+    }
+
+    /// <summary>
+    /// Where must a StrChar::CmpI() compare loop look ? First index where the chars differ ignoring case or pszStr1 has '\0'.
+    /// </summary>
+    /// <returns>index -lte- iLenMax. scalar code takes over from here.</returns>
+    template <typename TYPE>
+    static StrLen_t CmpIStop(const TYPE* pszStr1, const TYPE* pszStr2, StrLen_t iLenMax) noexcept {
+        UNREFERENCED_PARAMETER(pszStr1);
+        UNREFERENCED_PARAMETER(pszStr2);
+        UNREFERENCED_PARAMETER(iLenMax);
+        return 0;  // UNICODE case folding is not simple. all scalar.
+    }
+
+    /// <summary>
+    /// Find the first char that is in pszTokens. '\0' in pszStr also stops. like strpbrk()
+    /// </summary>
+    /// <returns>index of the char or iLenMax if none before that.</returns>
+    template <typename TYPE>
+    static StrLen_t FindTokens(const TYPE* pszStr, StrLen_t iLenMax, const TYPE* pszTokens) noexcept {
+        StrLen_t i = 0;
+        for (; i < iLenMax; i++) {
+            const TYPE ch = pszStr[i];
+            if (ch == '\0') break;
+            StrLen_t j = 0;
+            while (pszTokens[j] != '\0' && pszTokens[j] != ch) j++;
+            if (pszTokens[j] != '\0') break;
+        }
+        return i;
+    }
+};
+
+#ifdef USE_SIMD_SSE2
+template <>
+struct StrTSimd::cLane<1> {
+    static inline __m128i Set(char ch) noexcept {
+        return _mm_set1_epi8(ch);
+    }
+    static inline __m128i CmpEq(__m128i a, __m128i b) noexcept {
+        return _mm_cmpeq_epi8(a, b);
+    }
+#ifdef USE_SIMD_AVX2
+    STRSIMD_AVX2 static inline __m256i Set256(char ch) noexcept {
+        return _mm256_set1_epi8(ch);
+    }
+    STRSIMD_AVX2 static inline __m256i CmpEq256(__m256i a, __m256i b) noexcept {
+        return _mm256_cmpeq_epi8(a, b);
+    }
+#endif
+};
+template <>
+struct StrTSimd::cLane<2> {
+    static inline __m128i Set(wchar_t ch) noexcept {
+        return _mm_set1_epi16(CastN(short, ch));
+    }
+    static inline __m128i CmpEq(__m128i a, __m128i b) noexcept {
+        return _mm_cmpeq_epi16(a, b);
+    }
+#ifdef USE_SIMD_AVX2
+    STRSIMD_AVX2 static inline __m256i Set256(wchar_t ch) noexcept {
+        return _mm256_set1_epi16(CastN(short, ch));
+    }
+    STRSIMD_AVX2 static inline __m256i CmpEq256(__m256i a, __m256i b) noexcept {
+        return _mm256_cmpeq_epi16(a, b);
+    }
+#endif
+};
+template <>
+struct StrTSimd::cLane<4> {
+    static inline __m128i Set(wchar_t ch) noexcept {
+        return _mm_set1_epi32(CastN(int, ch));
+    }
+    static inline __m128i CmpEq(__m128i a, __m128i b) noexcept {
+        return _mm_cmpeq_epi32(a, b);
+    }
+#ifdef USE_SIMD_AVX2
+    STRSIMD_AVX2 static inline __m256i Set256(wchar_t ch) noexcept {
+        return _mm256_set1_epi32(CastN(int, ch));
+    }
+    STRSIMD_AVX2 static inline __m256i CmpEq256(__m256i a, __m256i b) noexcept {
+        return _mm256_cmpeq_epi32(a, b);
+    }
+#endif
+};
+#endif
+
+template <>
+inline StrLen_t StrTSimd::FindStopI<char>(const char* pszStr, char chFind, StrLen_t iLenMax) noexcept {
+    // ASCII case pairs only. StrChar::CmpI() == 0 means the same ToLowerA().
+    return FindStop<char>(pszStr, StrChar::ToLowerA(chFind), StrChar::ToUpperA(chFind), iLenMax);
+}
+
+template <>
+inline StrLen_t StrTSimd::CmpIStop<char>(const char* pszStr1, const char* pszStr2, StrLen_t iLenMax) noexcept {
+    StrLen_t i = 0;
+#ifdef USE_SIMD_SSE2
+    const __m128i vZero = _mm_setzero_si128();
+    while (i + 16 <= iLenMax) {
+        if ((CastPtrToNum(pszStr1 + i) & (k_nPageSize - 1)) > k_nPageSize - 16 || (CastPtrToNum(pszStr2 + i) & (k_nPageSize - 1)) > k_nPageSize - 16) {
+            // A load would cross a page. do these 16 one at a time.
+            for (StrLen_t iEnd = i + 16; i < iEnd; i++) {
+                if (pszStr1[i] == '\0' || StrChar::CmpI(pszStr1[i], pszStr2[i]) != 0) return i;
+            }
+            continue;
+        }
+        const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pszStr1 + i));
+        const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pszStr2 + i));
+        const UINT32 nEqual = CastN(UINT32, _mm_movemask_epi8(_mm_cmpeq_epi8(ToLowerA16(v1), ToLowerA16(v2))));
+        const UINT32 nStop = (~nEqual & 0xFFFF) | CastN(UINT32, _mm_movemask_epi8(_mm_cmpeq_epi8(v1, vZero)));
+        if (nStop != 0) return i + CastN(StrLen_t, GetLowBit(nStop));
+        i += 16;
+    }
+#else
+    UNREFERENCED_PARAMETER(pszStr1);
+    UNREFERENCED_PARAMETER(pszStr2);
+    UNREFERENCED_PARAMETER(iLenMax);
+#endif
+    return i;
+}
+
+template <>
+inline StrLen_t StrTSimd::FindTokens<char>(const char* pszStr, StrLen_t iLenMax, const char* pszTokens) noexcept {
+    if (pszTokens[0] == '\0' || pszTokens[1] == '\0') return FindStop<char>(pszStr, pszTokens[0], pszTokens[0], iLenMax);
+    if (pszTokens[2] == '\0') return FindStop<char>(pszStr, pszTokens[0], pszTokens[1], iLenMax);
+    // Many tokens. Use a lookup table.
+    bool aIsToken[256] = {};
+    aIsToken[0] = true;  // '\0' always stops.
+    for (StrLen_t j = 0; pszTokens[j] != '\0'; j++) {
+        aIsToken[CastN(BYTE, pszTokens[j])] = true;
+    }
+    StrLen_t i = 0;
+    while (i < iLenMax && !aIsToken[CastN(BYTE, pszStr[i])]) i++;
+    return i;
+}
+}  // namespace Gray
+#endif  // _INC_StrTSimd_INL
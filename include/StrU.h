@@ -72,7 +72,7 @@ struct GRAYCORE_LINK StrU { // : public StrT // static
     /// <param name="wChar"></param>
     /// <param name="pInp"></param>
     /// <param name="iSizeInpBytes"></param>
-    /// <returns>The length used from input string. (lt) iSizeInpBytes, 0=FAILED. k_UTF8_SIZE_MAX</returns>
+    /// <returns>The length used from input string. (lt) iSizeInpBytes, k_UTF8_SIZE_MAX. 0 = split char, need more bytes. -lt- 0 = invalid coding.</returns>
     static StrLen_t GRAYCALL UTF8toUNICODEChar(OUT wchar_t& wChar, const char* pInp, StrLen_t iSizeInpBytes) noexcept;
 
     /// <summary>
@@ -121,6 +121,15 @@ struct GRAYCORE_LINK StrU { // : public StrT // static
     /// <returns>Number of wide chars copied. not including '\0'.</returns>
     static StrLen_t GRAYCALL UTF8toUNICODE(cSpanX<wchar_t> ret, const cSpan<char>& src) noexcept;
 
+    /// <summary>
+    /// UTF8toUNICODE() for streaming. src may end in the middle of a UTF8 sequence.
+    /// The unused tail of src (a split sequence, or no room in ret) should be put at the start of the next buffer.
+    /// Invalid bytes are passed as is and always used. So only a split sequence at the end of src is left unused if ret has room.
+    /// </summary>
+    /// <param name="iSizeInpUsed">Number of bytes used from src.</param>
+    /// <returns>Number of wide chars copied. not including '\0'.</returns>
+    static StrLen_t GRAYCALL UTF8toUNICODEPart(cSpanX<wchar_t> ret, const cSpan<char>& src, OUT StrLen_t& iSizeInpUsed) noexcept;
+
     /// <summary>
     /// convert CODEPAGE_t CP_UTF8 to UNICODE.
     /// similar to _WIN32 ::WideCharToMultiByte().
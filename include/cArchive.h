@@ -57,6 +57,13 @@ class GRAYCORE_LINK cArchive {
     /// <returns>-lt- 0 = error HRESULT_WIN32_C(ERROR_IO_INCOMPLETE)</returns>
     HRESULT Serialize(cMemSpan ret);
 
+    /// <summary>
+    /// Serialize many parts of a record together. All or fail. A single call/syscall if the stream supports it. cStreamOutput::WriteV()
+    /// </summary>
+    /// <param name="aParts">cSpan of cMemSpan</param>
+    /// <returns>total size. -lt- 0 = error HRESULT_WIN32_C(ERROR_IO_INCOMPLETE)</returns>
+    HRESULT SerializeV(const cSpan<cMemSpan>& aParts);
+
     /// <summary>.
     /// Write a compressed size. high bit of byte is reserved to say there is more to come. bytes stored low to high (Intel endian of course).
     /// MFC calls this "Count"
@@ -7,7 +7,7 @@
 #endif
 
 #include "cDebugAssert.h"  // THROW_IF()
-#include "cHeap.h"
+#include "cHeapArena.h"
 #include "cPtrFacade.h"
 #include "cSpan.h"
 
@@ -96,7 +96,7 @@ class cArrayImpl : public SPAN_TYPE {
     size_t CountHeapStats(OUT ITERATE_t& iAllocCount) const noexcept {
         if (this->isEmpty()) return 0;
         iAllocCount++;  // just the alloc for the array
-        return cHeap::GetSize(this->get_PtrConst());
+        return cHeapArenaHook::GetSize(this->get_PtrConst());
     }
 
     /// <summary>
@@ -104,7 +104,7 @@ class cArrayImpl : public SPAN_TYPE {
     /// like STL capacity()
     /// </summary>
     ITERATE_t get_HeapCount() const noexcept {
-        return CastN(ITERATE_t, cHeap::GetSize(this->get_PtrConst()) / sizeof(ELEM_t));
+        return CastN(ITERATE_t, cHeapArenaHook::GetSize(this->get_PtrConst()) / sizeof(ELEM_t));
     }
 
     /// <summary>
@@ -203,7 +203,7 @@ void cArrayImpl<SPAN_TYPE>::InsertArray(ITERATE_t i, const cSpan<ELEM_t>& src) {
     const ITERATE_t nSizeCopy = src.GetSize();
     const ITERATE_t nSizeNew = nCountPrev + nSizeCopy;  // new size.
     const ITERATE_t allocateCount = GetHeapCountChunk(nSizeNew);
-    ELEM_t* pData = PtrCast<ELEM_t>(cHeap::ReAllocPtr(this->get_PtrWork(), allocateCount * sizeof(ELEM_t)));
+    ELEM_t* pData = PtrCast<ELEM_t>(cHeapArenaHook::ReAllocPtr(this->get_PtrWork(), allocateCount * sizeof(ELEM_t)));
     ASSERT_NN(pData);
     SUPER_t::SetSpan2(pData, nSizeNew * sizeof(ELEM_t));
 
@@ -224,7 +224,7 @@ void cArrayImpl<SPAN_TYPE>::RemoveAll() {
         const ITERATE_t nSizeCur = this->GetSize();
         SUPER_t::SetSpanNull();
         cValSpan::DestructElementsX<ELEM_t>(pData, nSizeCur);
-        cHeap::FreePtr(pData);
+        cHeapArenaHook::FreePtr(pData);
     }
 }
 
@@ -245,7 +245,7 @@ void cArrayImpl<SPAN_TYPE>::SetSize(ITERATE_t nSizeNew) {
         ASSERT(nSizeNew > nCountPrev);
         ITERATE_t allocateCount = nSizeNew;
         if (nCountPrev != 0) allocateCount = GetHeapCountChunk(allocateCount);  // not the first time we have done this.
-        pData = PtrCast<ELEM_t>(cHeap::ReAllocPtr(pData, allocateCount * sizeof(ELEM_t)));
+        pData = PtrCast<ELEM_t>(cHeapArenaHook::ReAllocPtr(pData, allocateCount * sizeof(ELEM_t)));
         ASSERT_NN(pData);
         // construct new elements
         cValSpan::ConstructElementsX<ELEM_t>(&pData[nCountPrev], nSizeNew - nCountPrev);
@@ -7,7 +7,7 @@
 #pragma once
 #endif
 #include "cDebugAssert.h"  // THROW_IF()
-#include "cHeap.h"
+#include "cHeapArena.h"
 #include "cHeapObject.h"
 #include "cRefPtr.h"
 #include "cSpan.h"
@@ -50,7 +50,7 @@ class cArrayHeadT : public cRefBase, public cHeapObject {
     /// <returns></returns>
     static void* operator new(size_t stAllocateBlock, size_t sizePayload) {
         ASSERT(stAllocateBlock == sizeof(cArrayHeadT));
-        return cHeap::AllocPtr(stAllocateBlock + sizePayload);
+        return cHeapArenaHook::AllocPtr(stAllocateBlock + sizePayload);
     }
     cArrayHeadT(ITERATE_t nCount) noexcept : _nCount(nCount), _HashCode(k_HASHCODE_CLEAR) {}
 
@@ -58,11 +58,11 @@ class cArrayHeadT : public cRefBase, public cHeapObject {
     static void operator delete(void* pObj, size_t sizePayload) {
         // called by cRefBase onZeroRefCount
         UNREFERENCED_PARAMETER(sizePayload);
-        cHeap::FreePtr(pObj);
+        cHeapArenaHook::FreePtr(pObj);
     }
     static void operator delete(void* pObj) {
         // called by cRefBase onZeroRefCount
-        cHeap::FreePtr(pObj);
+        cHeapArenaHook::FreePtr(pObj);
     }
 
     /// <summary>
@@ -107,12 +107,21 @@ class cArrayHeadT : public cRefBase, public cHeapObject {
     /// </summary>
     /// <returns></returns>
     inline size_t get_BytesMalloc() const noexcept {
-        return cHeap::GetSize(this) - sizeof(cArrayHeadT);
+        return cHeapArenaHook::GetSize(this) - sizeof(cArrayHeadT);
     }
     inline ITERATE_t get_HeapCount() const noexcept {
         return CastN(ITERATE_t, get_BytesMalloc() / sizeof(_TYPE));
     }
 
+    size_t GetHeapStatsThis(OUT ITERATE_t& iAllocCount) const override {
+        iAllocCount++;
+        return cHeapArenaHook::GetSize(this);  // may be in a cHeapArena.
+    }
+    bool isValidCheck() const noexcept override {
+        if (cHeapArenaHook::FindArena(this) != nullptr) return cMem::IsValidApp(this);  // not a cHeap block.
+        return cHeapObject::isValidCheck();
+    }
+
     inline bool IsHashCodeSet() const noexcept {
         return _HashCode != k_HASHCODE_CLEAR && _nCount > 0;
     }
@@ -163,7 +172,7 @@ class cArrayHeadT : public cRefBase, public cHeapObject {
         _nCount = nCountNew;
         _HashCode = k_HASHCODE_CLEAR;  // invalidate hash.
 
-        THIS_t* pHeadNew = PtrCast<THIS_t>(cHeap::ReAllocPtr(this, GetMallocSize(allocateCount)));
+        THIS_t* pHeadNew = PtrCast<THIS_t>(cHeapArenaHook::ReAllocPtr(this, GetMallocSize(allocateCount)));
         ASSERT_NN(pHeadNew);
 
         if (construct) {
@@ -6,11 +6,43 @@
 #pragma once
 #endif
 #include "cAtom.h"
+#include "cArrayRef.h"
 #include "cHashTable.h"
+#include "cInterlockedVal.h"
 #include "cLogMgr.h"
 #include "cSingleton.h"
 
 namespace Gray {
+/// <summary>
+/// Lock free readable index of atoms by ATOMCODE_t. Open addressing with linear probe. Allows dupe ATOMCODE_t.
+/// Holds no refs. Only cAtomManager writes to it while holding its _Lock. Readers just read.
+/// Never resized in place. A new bigger index is published and the old one retired when full.
+/// </summary>
+struct cAtomIndex {
+    typedef cStringHeadT<ATOMCHAR_t> DATA_t;
+
+    ITERATE_t _nMask;                 /// slot qty - 1. power of 2.
+    ITERATE_t _nUsed;                 /// slots used including k_pDeleted. writer only.
+    cInterlockedPtr<DATA_t> _aSlots[1];  /// variable length. nullptr = never used.
+
+    static DATA_t* const k_pDeleted;  /// tombstone marker.
+
+    static cAtomIndex* Create(ITERATE_t nQty);
+    static void Free(cAtomIndex* pIndex);
+
+    inline DATA_t* GetSlot(ITERATE_t i) const noexcept {
+        return const_cast<DATA_t*>(static_cast<const DATA_t*>(_aSlots[i]));
+    }
+    /// <summary>
+    /// Find the slot holding an atom. Safe to call without a lock.
+    /// </summary>
+    /// <param name="pszName">nullptr = match any name with this hash.</param>
+    /// <returns>slot index or k_ITERATE_BAD</returns>
+    ITERATE_t FindISlot(ATOMCODE_t idAtom, const ATOMCHAR_t* pszName) const noexcept;
+    ITERATE_t FindISlotPtr(const DATA_t* pData) const noexcept;
+    void Insert(DATA_t* pData) noexcept;
+};
+
 /// <summary>
 /// an alpha sorted string lookup table. CASE IGNORED !
 /// @note Internal collection for the atoms. Don't use this publicly. Use cAtomRef.
@@ -25,9 +57,36 @@ struct GRAYCORE_LINK cAtomManager final : public cSingleton<cAtomManager> {
     typedef cRefPtr<DATA_t> REF_t;
 
  private:
-    static const int kRefsBase = 3;  // We only have 3 refs = we can be deleted. Magic number.
+    static const int kRefsBase = 3;          // We only have 3 refs = we can be deleted. Magic number.
+    static const ITERATE_t kReaderShards = 16;  // spread lock free readers over this many counters.
+
+    /// <summary>
+    /// Count readers of _pIndex for each epoch. Padded to its own cache line.
+    /// </summary>
+    struct cReaderShard {
+        cInterlockedInt _nCount[2];
+        BYTE _Pad[64 - 2 * sizeof(cInterlockedInt)];
+    };
 
-    mutable cThreadLockableX _Lock;               /// make it thread safe.
+    /// <summary>
+    /// Stack guard for a lock free reader of _pIndex. Anything it sees stays alive until it exits.
+    /// </summary>
+    class cReadGuard {
+        cInterlockedInt* _pCount;
+
+     public:
+        cReadGuard(const cAtomManager& rMgr) noexcept;
+        ~cReadGuard() noexcept {
+            _pCount->DecV();
+        }
+    };
+
+    mutable cThreadLockableX _Lock;               /// make it thread safe. only needed for writers.
+    cInterlockedPtr<cAtomIndex> _pIndex;          /// Lock free readable index of all atoms by ATOMCODE_t.
+    mutable cReaderShard _aReaders[kReaderShards];  /// lock free readers in each epoch.
+    cInterlockedInt _nEpoch;                      /// low bit = which _nCount readers use now.
+    cArrayRef<DATA_t> _aRetired[2];               /// removed atoms kept alive until readers of that epoch are gone.
+    cArrayPtr<cAtomIndex> _aRetiredIndex[2];      /// replaced _pIndex kept until readers of that epoch are gone.
     cHashTableName<DATA_t, 4> _aNames;             /// Sorted by ATOMCHAR_t Text. NO DUPES
     cHashTableRef<DATA_t, ATOMCODE_t, 5> _aHashes;  /// Sorted by ATOMCODE_t GetHashCode32(s) DUPES?
     cArraySortHash<DATA_t, ATOMCODE_t> _aStatics;  /// Put atoms here to persist even with no refs. NO DUPES.
@@ -36,6 +95,21 @@ struct GRAYCORE_LINK cAtomManager final : public cSingleton<cAtomManager> {
     bool RemoveAtom(DATA_t* pDef);
     cAtomRef CreateAtom(const cHashIterator& index, COMPARE_t iCompareRes, DATA_t* pData);
 
+    /// <summary>
+    /// Lock free lookup in _pIndex.
+    /// </summary>
+    /// <param name="pszName">nullptr = any name with this hash.</param>
+    /// <param name="bFound">false = definitely not here. else true. (maybe returned empty because it changed under us)</param>
+    cAtomRef FindAtomIndex(ATOMCODE_t idAtom, const ATOMCHAR_t* pszName, OUT bool& bFound) const noexcept;
+    /// <summary>
+    /// Add to _pIndex. grow by publishing a new copy if needed. ASSUME _Lock.
+    /// </summary>
+    void AddIndex(DATA_t* pData);
+    /// <summary>
+    /// Free retired stuff that no lock free reader can still see. ASSUME _Lock. never waits.
+    /// </summary>
+    void Reclaim();
+
     /// <summary>
     /// Make this atom permanent. never removed from the atom tables. adds an extra ref.
     /// </summary>
@@ -45,6 +119,8 @@ struct GRAYCORE_LINK cAtomManager final : public cSingleton<cAtomManager> {
     cAtomManager();
 
  public:
+    ~cAtomManager();
+
     /// <summary>
     /// Get the atom that corresponds to a string. do not create it.
     /// </summary>
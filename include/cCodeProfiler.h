@@ -1,6 +1,6 @@
 //! @file cCodeProfiler.h
 //! Declare entry/exit from a function such that it will build a profile.
-//! Write out a profile PCP file.
+//! Stats are aggregated in memory per thread and written as a text report on demand or periodically.
 //! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
 
 #ifndef _INC_cCodeProfiler_H
@@ -9,39 +9,190 @@
 #pragma once
 #endif
 
+#include "ITextWriter.h"
+#include "cArray.h"
 #include "cDebugAssert.h"
+#include "cRefPtr.h"
+#include "cSingleton.h"
+#include "cThreadLock.h"
 #include "cTimeSys.h"
 
 namespace Gray {
+struct cCodeProfilerThread;
+class cCodeProfilerSnapshot;
+
+/// <summary>
+/// Stats for a single calling context. (a function as called from a particular chain of profiled callers)
+/// Nodes form a tree (calling context tree). _iParent is the caller node. So caller/callee edges are kept.
+/// </summary>
+struct cCodeProfilerNode {
+    const cDebugSourceLine* _pSrc;  /// the function. static.
+    ITERATE_t _iParent;             /// index of the calling node. -1 = not called from any profiled function.
+    UINT64 _nCalls;                 /// how many times was it called from here?
+    TIMEPERF_t _nTimeIncl;          /// total time inside. including callees.
+    TIMEPERF_t _nTimeExcl;          /// total time inside. excluding profiled callees. (self)
+    TIMEPERF_t _nTimeMin;           /// shortest single call. inclusive.
+    TIMEPERF_t _nTimeMax;           /// longest single call. inclusive.
+};
+
+/// <summary>
+/// Fixed size hash table of cCodeProfilerNode keyed by cDebugSourceLine pointer and parent node.
+/// No heap use after construct. So it can be used while profiling the heap.
+/// The owner thread adds nodes. Other threads may read get_Count() nodes at any time (stats may be slightly stale).
+/// </summary>
+class GRAYCORE_LINK cCodeProfilerTable {
+ public:
+    static const ITERATE_t k_nQtyDef = 4096;  /// default max nodes per thread.
+
+ private:
+    const ITERATE_t _nQtyMax;      /// max nodes.
+    const ITERATE_t _nMaskHash;    /// hash slots - 1. power of 2. -gt- 2 * _nQtyMax.
+    cCodeProfilerNode* _pNodes;    /// in order added. parents always before children.
+    ITERATE_t* _pHash;             /// node index + 1. 0 = empty.
+    INTER32_t VOLATILE _nQty = 0;  /// nodes in use. published after the node is filled in.
+
+ public:
+    UINT _nQtyDropped = 0;  /// calls not recorded because the table was full.
+
+ public:
+    explicit cCodeProfilerTable(ITERATE_t nQtyMax = k_nQtyDef);
+    ~cCodeProfilerTable();
+
+    ITERATE_t get_Count() const noexcept {
+        return _nQty;
+    }
+    const cCodeProfilerNode& GetAt(ITERATE_t i) const noexcept {
+        DEBUG_CHECK(IS_INDEX_GOOD(i, _nQty));
+        return _pNodes[i];
+    }
+
+    /// <summary>
+    /// Find (or add) the node for this function called from iParent.
+    /// </summary>
+    /// <returns>node index. -1 = table full.</returns>
+    ITERATE_t FindNode(ITERATE_t iParent, const cDebugSourceLine* pSrc) noexcept;
+
+    /// <summary>
+    /// Record a call.
+    /// </summary>
+    void AddCall(ITERATE_t i, TIMEPERF_t nTimeIncl, TIMEPERF_t nTimeExcl) noexcept;
+
+    /// <summary>
+    /// Merge all of another table into this one.
+    /// </summary>
+    void AddTable(const cCodeProfilerTable& src);
+
+    /// <summary>
+    /// Zero all stats. Keep the nodes. Calls in progress on other threads may still be counted.
+    /// </summary>
+    void ClearStats() noexcept;
+
+    /// <summary>
+    /// Write flat stats per function. merged over all calling contexts.
+    /// </summary>
+    HRESULT WriteReport(ITextWriter& o) const;
+    /// <summary>
+    /// Write "Caller;Callee;... usec" lines of exclusive time for each calling context. folded stacks for flamegraph.pl.
+    /// </summary>
+    HRESULT WriteFolded(ITextWriter& o) const;
+};
+
 /// <summary>
 /// profile the entry/exit for a function.
 /// This is ALWAYS stack based so its thread safe.
+/// Time is added to a per thread cCodeProfilerTable. No locks, no heap, no I/O.
 /// </summary>
 class GRAYCORE_LINK cCodeProfileFunc {
     friend class cCodeProfilerControl;
 
-    const cDebugSourceLine _Src;  /// Record source location of this function.
-    const cTimePerf _nTimeStart;  /// Function enter Start time in system clock ticks
+    const cDebugSourceLine* const _pSrc;      /// Record source location of this function. static.
+    cCodeProfilerThread* _pThread = nullptr;  /// nullptr = not measuring this call.
+    cCodeProfileFunc* _pParent = nullptr;     /// profiled caller on this thread.
+    ITERATE_t _iNode = -1;                    /// my node in _pThread table. -1 = table full.
+    TIMEPERF_t _nTimeStart = 0;               /// Function enter Start time in system clock ticks
+    TIMEPERF_t _nTimeChild = 0;               /// time spent in profiled callees.
 
     static bool sm_bActive;  /// are we actively measuring? Thread Safe read.
 
  private:
+    void StartTime() noexcept;
     void StopTime() noexcept;
 
  public:
-    cCodeProfileFunc(cDebugSourceLine src) noexcept : _Src(src), _nTimeStart(sm_bActive) {  // Cheat a little and burn off 4 instructions inside counted function time.
-        //! record Start/Record cycle count on object construct.
+    explicit cCodeProfileFunc(const cDebugSourceLine* pSrc) noexcept : _pSrc(pSrc) {
+        if (sm_bActive) {  // inline check for maximum speed.
+            StartTime();
+        }
     }
     ~cCodeProfileFunc() {
-        if (sm_bActive) {  // inline check for maximum speed.
+        if (_pThread != nullptr) {  // finish even if no longer sm_bActive.
             StopTime();
         }
     }
 };
 
+/// <summary>
+/// Control the profiler. Owns all the per thread tables. Merge them for a report.
+/// </summary>
+class GRAYCORE_LINK cCodeProfilerControl final : public cSingleton<cCodeProfilerControl> {
+    friend class cCodeProfileFunc;
+    friend class cCodeProfilerSnapshot;
+
+ public:
+    DECLARE_cSingleton(cCodeProfilerControl);
+
+ private:
+    mutable cThreadLockableX _Lock;             /// protect _aThreads. NOT used to record calls.
+    cArrayPtr<cCodeProfilerThread> _aThreads;   /// all thread tables. kept after the thread exits. never freed.
+    cRefPtr<cCodeProfilerSnapshot> _pSnapshot;  /// periodic report writer thread.
+
+ private:
+    cCodeProfilerThread* GetThreadCurrent() noexcept;
+
+ protected:
+    cCodeProfilerControl();
+    ~cCodeProfilerControl() override;
+
+ public:
+    ITERATE_t _nQtyNodes = cCodeProfilerTable::k_nQtyDef;  /// max nodes per thread. for new threads.
+
+    bool get_Active() const noexcept {
+        return cCodeProfileFunc::sm_bActive;
+    }
+    bool put_Active(bool bActive);
+
+    /// <summary>
+    /// Zero the stats for all threads.
+    /// </summary>
+    void ClearStats();
+
+    /// <summary>
+    /// Merge the tables for all threads.
+    /// </summary>
+    void GetSnapshot(cCodeProfilerTable& rTable) const;
+
+    /// <summary>
+    /// Merge all threads and write the report and/or folded stacks files.
+    /// </summary>
+    /// <param name="pszFileReport">flat text report. nullptr = none.</param>
+    /// <param name="pszFileFolded">folded stacks for flame graphs. nullptr = none.</param>
+    HRESULT WriteSnapshot(const FILECHAR_t* pszFileReport, const FILECHAR_t* pszFileFolded = nullptr) const;
+
+    /// <summary>
+    /// Start a background thread that calls WriteSnapshot() every nInterval.
+    /// </summary>
+    HRESULT StartSnapshots(const FILECHAR_t* pszFileReport, const FILECHAR_t* pszFileFolded, TIMESYSD_t nInterval);
+    /// <summary>
+    /// Stop the background thread after a final WriteSnapshot().
+    /// </summary>
+    void StopSnapshots();
+};
+
 // cCodeProfileFunc usage requires only single declaration at beginning of function
-#if 0  // defined(_DEBUG)
-#define CODEPROFILEFUNC() cCodeProfileFunc _tagPROFILE_CLASS(DEBUGSOURCELINE)
+#ifdef USE_CODEPROFILER
+#define CODEPROFILEFUNC()                                                                      \
+    static const ::Gray::cDebugSourceLine _tagPROFILE_SRC(__FILE__, __FUNCTION__, (WORD)__LINE__); \
+    ::Gray::cCodeProfileFunc _tagPROFILE_FUNC(&_tagPROFILE_SRC)
 #else
 #define CODEPROFILEFUNC() __noop  // compile out profiling. Do nothing.
 #endif
@@ -31,7 +31,7 @@ struct cDebugSourceLine {
     const char* _pszFile;      /// name of the source file. static text. __FILE__
     const char* _pszFunction;  /// name of the source function. __func__, __FUNCTION__, __FUNCDNAME__, and __FUNCSIG__. static text.
     WORD _uLine;               /// line number in the source _pszFile. (1 based) __LINE__
-    cDebugSourceLine(const char* pszFile = "", const char* pszFunction = "", WORD uLine = 0) noexcept : _pszFile(pszFile), _pszFunction(pszFunction), _uLine(uLine) {}
+    constexpr cDebugSourceLine(const char* pszFile = "", const char* pszFunction = "", WORD uLine = 0) noexcept : _pszFile(pszFile), _pszFunction(pszFunction), _uLine(uLine) {}
 };
 
 //! __FILE__ is valid for __GNUC__ and _MSC_VER.
@@ -71,6 +71,8 @@ enum OF_FLAGS_ENUM_t : OF_FLAGS_t {
 };
 
 struct GRAYCORE_LINK cFileStatus;
+class GRAYCORE_LINK cFileAsyncReq;
+DECLARE_INTERFACE(IFileAsyncCallback);
 
 /// <summary>
 /// Wrapper for General OS file access interface.
@@ -191,6 +193,20 @@ class GRAYCORE_LINK cFile : public cObject, public cOSHandle, public cStream {
     /// ERROR_IO_PENDING = must wait!?</returns>
     HRESULT WriteX(const cMemSpan& m) override;  
 
+    // Positional and vectored. Native. ReadAt/WriteAt don't move the file position.
+    HRESULT ReadAt(cMemSpan ret, STREAM_POS_t nPos) noexcept override {
+        return cOSHandle::ReadAt(ret, nPos);
+    }
+    HRESULT ReadV(const cSpan<cMemSpan>& aRet) noexcept override {
+        return cOSHandle::ReadV(aRet);
+    }
+    HRESULT WriteAt(const cMemSpan& m, STREAM_POS_t nPos) override {
+        return cOSHandle::WriteAt(m, nPos);
+    }
+    HRESULT WriteV(const cSpan<cMemSpan>& aSrc) override {
+        return cOSHandle::WriteV(aSrc);
+    }
+
     HRESULT FlushX() override;
 
     /// <summary>
@@ -208,6 +224,19 @@ class GRAYCORE_LINK cFile : public cObject, public cOSHandle, public cStream {
         return cOSHandle::SeekX(nOffset, eSeekOrigin);
     }
 
+    /// <summary>
+    /// Start an asynchronous read at a position. Does not move the file position. cFileAsync.
+    /// Keep the file open and ret valid till complete.
+    /// </summary>
+    /// <param name="pReq">filled in and submitted. held by the engine till complete.</param>
+    /// <param name="pCallback">nullptr = poll cFileAsync::GetCompletion()</param>
+    /// <returns>-lt- 0 = error.</returns>
+    HRESULT ReadAtAsync(cFileAsyncReq* pReq, cMemSpan ret, STREAM_POS_t nOffset, IFileAsyncCallback* pCallback = nullptr);
+    /// <summary>
+    /// Start an asynchronous write at a position. Does not move the file position. cFileAsync.
+    /// </summary>
+    HRESULT WriteAtAsync(cFileAsyncReq* pReq, const cMemSpan& m, STREAM_POS_t nOffset, IFileAsyncCallback* pCallback = nullptr);
+
     static HRESULT GRAYCALL DeletePath(const FILECHAR_t* pszFileName);  // NOTE: MFC Remove() returns void
     static HRESULT GRAYCALL DeletePathX(const FILECHAR_t* pszFilePath, FILEOPF_t nFileFlags = FILEOPF_t::_None);
     static HRESULT GRAYCALL LoadFile(const FILECHAR_t* pszFilePath, OUT cBlob& blob, size_t nSizeExtra = 0);
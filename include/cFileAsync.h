@@ -0,0 +1,156 @@
+//! @file cFileAsync.h
+//! Asynchronous positional file reads and writes. io_uring on __linux__. else a cThreadPool.
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+
+#ifndef _INC_cFileAsync_H
+#define _INC_cFileAsync_H
+#ifndef NO_PRAGMA_ONCE
+#pragma once
+#endif
+
+#include "cArrayRef.h"
+#include "cInterlockedVal.h"
+#include "cOSHandle.h"
+#include "cRefPtr.h"
+#include "cSingleton.h"
+#include "cStreamProgress.h"
+#include "cThreadLock.h"
+#include "cThreadPool.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define USE_IOURING  // raw syscalls. no liburing needed.
+#endif
+#endif
+
+#ifdef __linux__
+#include <sys/uio.h>  // struct iovec
+#endif
+
+namespace Gray {
+class cFileAsync;
+class cFileAsyncRing;
+class cFileAsyncReq;
+
+/// <summary>
+/// Called when a cFileAsyncReq is complete. On some engine thread. Should be quick and not block.
+/// May Submit() more requests. The completed request no longer counts as in flight. cFileAsync::WaitIdle() may return before this does.
+/// </summary>
+DECLARE_INTERFACE(IFileAsyncCallback) {
+    IGNORE_WARN_INTERFACE(IFileAsyncCallback);
+    virtual void onFileAsyncComplete(cFileAsyncReq * pReq) = 0;
+};
+
+/// <summary>
+/// A single positional read or write in flight. Does not move the file position.
+/// The caller keeps the file open and the buffer valid till it completes.
+/// The engine holds a reference while in flight. A short read or write is NOT retried.
+/// </summary>
+class GRAYCORE_LINK cFileAsyncReq : public cRefBase {
+    friend class cFileAsync;
+    friend class cFileAsyncRing;
+
+ public:
+    ::HANDLE _hFile = INVALID_HANDLE_VALUE;  /// cOSHandle::get_Handle()
+    cMemSpan _Data;                          /// read into or write from.
+    STREAM_POS_t _nOffset = 0;               /// position in the file.
+    bool _bWrite = false;
+    IFileAsyncCallback* _pCallback = nullptr;  /// nullptr = put on the cFileAsync completion queue instead.
+    HRESULT _hResult = S_OK;                   /// length done or -lt- 0 = error. HRESULT_WIN32_C(ERROR_IO_INCOMPLETE) while in flight.
+
+ private:
+#ifdef __linux__
+    struct ::iovec _iov;  /// io_uring READV/WRITEV.
+#endif
+
+ public:
+    cFileAsyncReq() noexcept {}
+    cFileAsyncReq(::HANDLE hFile, const cMemSpan& data, STREAM_POS_t nOffset, bool bWrite, IFileAsyncCallback* pCallback = nullptr) noexcept
+        : _hFile(hFile), _Data(data), _nOffset(nOffset), _bWrite(bWrite), _pCallback(pCallback) {}
+
+    bool isPending() const noexcept {
+        return _hResult == HRESULT_WIN32_C(ERROR_IO_INCOMPLETE);
+    }
+};
+
+/// <summary>
+/// Engine for asynchronous file I/O. Many requests can be in flight at once. e.g. large scans or log flushes.
+/// Uses io_uring if the kernel supports it. Else emulates with pread()/pwrite() on a cThreadPool.
+/// Completions go to cFileAsyncReq::_pCallback or a completion queue polled with GetCompletion() / WaitCompletion().
+/// </summary>
+class GRAYCORE_LINK cFileAsync final : public cSingleton<cFileAsync> {
+    friend class cFileAsyncRing;
+
+ public:
+    DECLARE_cSingleton(cFileAsync);
+    static const ITERATE_t k_nQtyMaxDef = 256;  /// default max requests in flight.
+
+ private:
+    mutable cThreadLockableX _Lock;       /// protect _aDone and start/stop.
+    cArrayRef<cFileAsyncReq> _aDone;      /// completion queue for requests with no _pCallback.
+    INTER32_t VOLATILE _nQtyInFlight = 0;
+    INTER32_t VOLATILE _nWakeSeq = 0;     /// park on this for completions or room to submit. cThreadLockable::ParkAddr()
+    ITERATE_t _nQtyMax = 0;               /// 0 = not started.
+    cRefPtr<cFileAsyncRing> _pRing;       /// io_uring. nullptr = use _Pool.
+    cThreadPool _Pool;                    /// emulation.
+
+ private:
+    void CompleteReq(cFileAsyncReq* pReq, HRESULT hResult) noexcept;
+    static HRESULT GRAYCALL RunReqSync(cFileAsyncReq* pReq) noexcept;
+
+ protected:
+    cFileAsync();
+    ~cFileAsync() override;
+
+ public:
+    bool isStarted() const noexcept {
+        return _nQtyMax > 0;
+    }
+    /// <summary>
+    /// Is io_uring in use? false = thread pool emulation.
+    /// </summary>
+    bool isRing() const noexcept {
+        return _pRing.get_Ptr() != nullptr;
+    }
+    ITERATE_t get_QtyInFlight() const noexcept {
+        return _nQtyInFlight;
+    }
+
+    /// <summary>
+    /// Start the engine. Optional. Submit() starts with defaults.
+    /// </summary>
+    /// <param name="nQtyMax">max requests in flight. Submit() waits for room past this.</param>
+    /// <param name="bUseRing">false = force the thread pool emulation.</param>
+    HRESULT Start(ITERATE_t nQtyMax = k_nQtyMaxDef, bool bUseRing = true);
+    /// <summary>
+    /// Wait for all requests in flight and stop.
+    /// </summary>
+    void Stop();
+
+    /// <summary>
+    /// Submit a batch of requests. A single syscall for io_uring.
+    /// Waits if there is no room for more in flight.
+    /// </summary>
+    /// <returns>number submitted. the first n of ppReqs. less than nQty = the rest failed and are not in flight. -lt- 0 = error. none submitted.</returns>
+    HRESULT Submit(cFileAsyncReq* const* ppReqs, ITERATE_t nQty);
+    HRESULT Submit(cFileAsyncReq* pReq) {
+        return Submit(&pReq, 1);
+    }
+
+    /// <summary>
+    /// Poll the completion queue. For requests with no _pCallback.
+    /// </summary>
+    /// <returns>nullptr = none yet.</returns>
+    cRefPtr<cFileAsyncReq> GetCompletion();
+    /// <summary>
+    /// Wait for the next completion.
+    /// </summary>
+    /// <returns>nullptr = timeout.</returns>
+    cRefPtr<cFileAsyncReq> WaitCompletion(TIMESYSD_t nTimeWait = cTimeSys::k_INF);
+    /// <summary>
+    /// Wait till nothing is in flight.
+    /// </summary>
+    void WaitIdle();
+};
+}  // namespace Gray
+#endif
@@ -105,6 +105,9 @@ struct GRAYCORE_LINK DECLSPEC_NOVTABLE IFileCopier {
 /// </summary>
 class GRAYCORE_LINK cFileCopier : public IFileCopier {
  public:
+    static const size_t k_nSizeChunk = (8 * 1024 * 1024);  /// kernel copy this much between progress callbacks.
+    static const size_t k_nSizeBlock = (1 * 1024 * 1024);  /// user space copy block size when the kernel can't copy.
+
     cStringF _sRemoteRoot;  /// Prefix all server/remote side (non local) paths with this.
 
  protected:
@@ -142,6 +145,12 @@ class GRAYCORE_LINK cFileCopier : public IFileCopier {
                                                  ::HANDLE hSourceFile, ::HANDLE hDestinationFile, void* lpData);
 #endif
 
+    /// <summary>
+    /// Copy a range of an open file to the same place in another open file. Kernel zero copy if possible.
+    /// </summary>
+    /// <param name="nSize">bytes to copy. may be far more than 2G.</param>
+    /// <returns>S_OK or -lt- 0 = error.</returns>
+    static HRESULT GRAYCALL CopyFileHandle(cFile& fileSrc, cFile& fileDst, STREAM_POS_t nOffsetStart, STREAM_POS_t nSize, IStreamProgressCallback* pProgress = nullptr);
     static HRESULT GRAYCALL CopyFileStream(cStreamInput& stmIn, const FILECHAR_t* pszDstFileName, bool bFailIfExists = false, IStreamProgressCallback* pProgress = nullptr, FILE_SIZE_t nOffsetStart = 0);
 
     static HRESULT GRAYCALL CopyFileX(const FILECHAR_t* pszSrcName, const FILECHAR_t* pszDstName, IStreamProgressCallback* pProgress = nullptr, bool bFailIfExists = false);
@@ -0,0 +1,109 @@
+//! @file cFileMapped.h
+//! Read only memory mapped file. Zero copy cStreamInput.
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+
+#ifndef _INC_cFileMapped_H
+#define _INC_cFileMapped_H
+#ifndef NO_PRAGMA_ONCE
+#pragma once
+#endif
+
+#include "cFile.h"
+#include "cNonCopyable.h"
+
+namespace Gray {
+/// <summary>
+/// Access pattern hints for the OS paging of a cFileMapped. like madvise().
+/// </summary>
+enum class FILEMAP_ADVISE_t : BYTE {
+    _Normal,      /// MADV_NORMAL. no hint.
+    _Sequential,  /// MADV_SEQUENTIAL. read ahead aggressively. drop pages behind.
+    _Random,      /// MADV_RANDOM. no read ahead.
+    _WillNeed,    /// MADV_WILLNEED. start paging in the window now.
+    _DontNeed,    /// MADV_DONTNEED. drop the pages of the window.
+};
+
+/// <summary>
+/// Read only memory mapped file. Exposed as a cMemSpan and as a seek-able cStreamInput.
+/// GetReadSpan() gives spans straight from the mapping with no copy. e.g. for cTextReaderStream.
+/// Maps the whole file if it fits the address space. Else maps a window of the file at a time and moves it on demand.
+/// Spans are only valid till the next read, seek or Close(). The window may move.
+/// The file should not be truncated while mapped. (SIGBUS)
+/// </summary>
+class GRAYCORE_LINK cFileMapped : public cStreamInput, protected cNonCopyable {
+ public:
+    static const size_t k_nSizeWindowDef = 64 * 1024 * 1024;  /// window size if the whole file won't fit the address space.
+
+ protected:
+    cFile _File;
+#ifdef _WIN32
+    ::HANDLE _hMapping = NULL;  /// CreateFileMapping()
+#endif
+    STREAM_POS_t _nSizeFile = 0;   /// total file size. fixed at open.
+    size_t _nSizeWindowMax = 0;    /// 0 = map the whole file at once.
+    STREAM_POS_t _nWindowPos = 0;  /// file offset of _pWindow. aligned to get_Granularity().
+    BYTE* _pWindow = nullptr;      /// current mapped view. nullptr = none.
+    size_t _nWindowSize = 0;       /// bytes mapped at _pWindow.
+    STREAM_POS_t _nPos = 0;        /// current read position in the file.
+    FILEMAP_ADVISE_t _eAdvise = FILEMAP_ADVISE_t::_Normal;
+
+ protected:
+    static size_t GRAYCALL get_Granularity() noexcept;
+    void UnmapWindow() noexcept;
+    HRESULT MapWindow(STREAM_POS_t nPos, size_t nSizeMin) noexcept;
+    void AdviseWindow() noexcept;
+
+ public:
+    cFileMapped() noexcept {}
+    ~cFileMapped() override {
+        Close();
+    }
+
+    bool isOpen() const noexcept {
+        return _File.isValidHandle();
+    }
+    size_t get_SizeWindowMax() const noexcept {
+        return _nSizeWindowMax;
+    }
+
+    /// <summary>
+    /// Open and map a file read only.
+    /// </summary>
+    /// <param name="nSizeWindowMax">0 = whole file if it fits the address space, else k_nSizeWindowDef. Rounded up to the page size.</param>
+    HRESULT OpenX(cStringF sFilePath, size_t nSizeWindowMax = 0);
+    void Close() noexcept;
+
+    /// <summary>
+    /// Set the access pattern hint. Kept and applied to each window as it is mapped.
+    /// </summary>
+    HRESULT Advise(FILEMAP_ADVISE_t eAdvise) noexcept;
+
+    /// <summary>
+    /// Get the mapping from nPos to the end of the window. At least nSizeMin bytes unless EOF.
+    /// May move the window. Empty = EOF or error.
+    /// </summary>
+    cMemSpan GetSpanAt(STREAM_POS_t nPos, size_t nSizeMin = 1) noexcept;
+    /// <summary>
+    /// The whole file as a single span. Empty if the file is mapped in windows.
+    /// </summary>
+    cMemSpan get_Span() noexcept;
+
+    cMemSpan GetReadSpan(size_t nSizeMin = 1) noexcept override {
+        return GetSpanAt(_nPos, nSizeMin);
+    }
+
+    HRESULT ReadX(cMemSpan ret) noexcept override;
+    HRESULT ReadPeek(cMemSpan ret) noexcept override;
+    HRESULT ReadStringLine(cSpanX<char> ret) override;
+    using cStreamInput::ReadStringLine;
+
+    HRESULT SeekX(STREAM_OFFSET_t nOffset, SEEK_t eSeekOrigin = SEEK_t::_Set) noexcept override;
+    STREAM_POS_t GetPosition() const noexcept override {
+        return _nPos;
+    }
+    STREAM_POS_t GetLength() const noexcept override {
+        return _nSizeFile;
+    }
+};
+}  // namespace Gray
+#endif
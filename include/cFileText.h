@@ -118,6 +118,20 @@ class GRAYCORE_LINK cFileText : public cFileTextBase { // Try to be compatible w
     STREAM_POS_t GetPosition() const noexcept override;
     HRESULT FlushX() override;
 
+    // NOT the native cFile versions. They would bypass the FILE* buffer. Use SeekX()/ReadX()/WriteX() defaults.
+    HRESULT ReadAt(cMemSpan ret, STREAM_POS_t nPos) noexcept override {
+        return cStreamInput::ReadAt(ret, nPos);
+    }
+    HRESULT ReadV(const cSpan<cMemSpan>& aRet) noexcept override {
+        return cStreamInput::ReadV(aRet);
+    }
+    HRESULT WriteAt(const cMemSpan& m, STREAM_POS_t nPos) override {
+        return cStreamOutput::WriteAt(m, nPos);
+    }
+    HRESULT WriteV(const cSpan<cMemSpan>& aSrc) override {
+        return cStreamOutput::WriteV(aSrc);
+    }
+
     HRESULT WriteString(const char* pszStr) override;
     HRESULT WriteString(const wchar_t* pszStr) override {
         return SUPER_t::WriteString(pszStr);
@@ -0,0 +1,398 @@
+//! @file cHashMapOpen.h
+//! An open addressing (Robin Hood) hash map with a HASHCODE_t as the key. Grows as needed.
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+
+#ifndef _INC_cHashMapOpen_H
+#define _INC_cHashMapOpen_H
+#ifndef NO_PRAGMA_ONCE
+#pragma once
+#endif
+
+#include "cHashTable.h"
+#include "cHeap.h"
+#include "cNonCopyable.h"
+#include "cRefPtr.h"
+
+namespace Gray {
+
+/// <summary>
+/// Get the key for a struct element. ASSUME TYPE has a get_HashCode() method.
+/// </summary>
+template <class TYPE, typename TYPE_HASHCODE>
+struct cHashKeyStruct {  // static
+    static inline TYPE_HASHCODE GetKey(const TYPE& rElem) noexcept {
+        return rElem.get_HashCode();
+    }
+};
+
+/// <summary>
+/// Get the key for a cRefPtr element. ASSUME TYPE is cRefBase and implements get_HashCode().
+/// </summary>
+template <class TYPE, typename TYPE_HASHCODE>
+struct cHashKeyRef {  // static
+    static inline TYPE_HASHCODE GetKey(const cRefPtr<TYPE>& rElem) noexcept {
+        return rElem->get_HashCode();
+    }
+};
+
+/// <summary>
+/// base/internal class for an open addressing hash map. Robin Hood insertion with backward shift delete.
+/// Unlike cHashTableT the bucket count is dynamic. It grows to keep the load below k_nLoadMax/k_nLoadDiv.
+/// Slots never wrap around. There are _nProbeMax extra slots at the end so removal while iterating forward is safe.
+/// Elements are relocated as raw bytes (like cValSpan::ShiftElements) so TYPE must not hold pointers to itself.
+/// Must have external lock to make thread safe.
+/// Compatible with cHashIterator and FOREACH_HASH_TABLE. Each slot acts as a bucket of size 0 or 1.
+/// </summary>
+/// <typeparam name="_TYPE_ELEM">The element stored.</typeparam>
+/// <typeparam name="TYPE_HASHCODE"></typeparam>
+/// <typeparam name="_TYPE_KEYER">static GetKey(const _TYPE_ELEM&)</typeparam>
+template <class _TYPE_ELEM, typename TYPE_HASHCODE, class _TYPE_KEYER>
+class cHashMapOpenT : protected cNonCopyable {
+ public:
+    typedef _TYPE_ELEM ELEM_t;
+    typedef cHashIterator iterator;        // like STL.
+    typedef cHashIterator const_iterator;  // like STL
+
+    static const BIT_ENUM_t k_nHashBitsMin = 3;  /// 8 buckets min.
+    static const ITERATE_t k_nLoadMax = 7;       /// max load = 7/8 full.
+    static const ITERATE_t k_nLoadDiv = 8;
+
+ protected:
+    ELEM_t* _pElems = nullptr;  /// allocated slots. get_SlotQty(). Uninitialized unless _pProbe[i] != 0.
+    BYTE* _pProbe = nullptr;    /// distance from home bucket + 1. 0 = empty slot. follows _pElems in the same allocation.
+    ITERATE_t _nCount = 0;      /// number of used slots.
+    BIT_ENUM_t _nHashBits = 0;  /// 2^_nHashBits = home bucket count. 0 = not allocated.
+    BYTE _nProbeMax = 0;        /// max allowed probe distance. extra slots at the end.
+
+ protected:
+    /// <summary>
+    /// Get the home bucket for a hash code. Fibonacci hashing spreads sequential codes.
+    /// </summary>
+    inline ITERATE_t GetBucketNum(TYPE_HASHCODE key) const noexcept {
+        return CastN(ITERATE_t, (CastN(UINT64, key) * 11400714819323198485ULL) >> (64 - _nHashBits));
+    }
+    inline ITERATE_t get_HomeQty() const noexcept {
+        return (_nHashBits == 0) ? 0 : cBits::Mask1<ITERATE_t>(_nHashBits);
+    }
+
+    /// <summary>
+    /// Find the slot for the key.
+    /// </summary>
+    /// <returns>slot index or k_ITERATE_BAD</returns>
+    ITERATE_t FindISlot(TYPE_HASHCODE key) const noexcept {
+        if (_nCount <= 0) return k_ITERATE_BAD;
+        ITERATE_t i = GetBucketNum(key);
+        for (BYTE nDist = 1;; nDist++, i++) {
+            const BYTE nProbe = _pProbe[i];
+            if (nProbe < nDist) return k_ITERATE_BAD;  // empty or a richer element. key is not here.
+            if (nProbe == nDist && _TYPE_KEYER::GetKey(_pElems[i]) == key) return i;
+        }
+    }
+
+    /// <summary>
+    /// Place (move) the raw bytes of an element into the table. Robin Hood displaces richer elements.
+    /// ASSUME the key is not already here and there is room.
+    /// </summary>
+    /// <returns>false = probe distance exceeded. pElemRaw holds the element still to be placed.</returns>
+    bool PlaceRaw(BYTE* pElemRaw, OUT ITERATE_t& iSlotNew) noexcept {
+        ITERATE_t i = GetBucketNum(_TYPE_KEYER::GetKey(*PtrCast<ELEM_t>(pElemRaw)));
+        iSlotNew = k_ITERATE_BAD;
+        for (BYTE nDist = 1;; nDist++, i++) {
+            if (nDist > _nProbeMax) return false;
+            const BYTE nProbe = _pProbe[i];
+            if (nProbe == 0) {
+                cMem::Copy(&_pElems[i], pElemRaw, sizeof(ELEM_t));
+                _pProbe[i] = nDist;
+                _nCount++;
+                if (iSlotNew < 0) iSlotNew = i;
+                return true;
+            }
+            if (nProbe < nDist) {
+                // Take from the rich. swap and carry the displaced element on.
+                alignas(ELEM_t) BYTE tmp[sizeof(ELEM_t)];
+                cMem::Copy(tmp, &_pElems[i], sizeof(ELEM_t));
+                cMem::Copy(&_pElems[i], pElemRaw, sizeof(ELEM_t));
+                cMem::Copy(pElemRaw, tmp, sizeof(ELEM_t));
+                _pProbe[i] = nDist;
+                nDist = nProbe;
+                if (iSlotNew < 0) iSlotNew = i;
+            }
+        }
+    }
+
+    /// <summary>
+    /// Allocate a new empty table and move all existing elements into it.
+    /// </summary>
+    void Rehash(BIT_ENUM_t nHashBits) {
+        ELEM_t* pElemsOld = _pElems;
+        BYTE* pProbeOld = _pProbe;
+        const ITERATE_t nSlotsOld = get_SlotQty();
+
+        for (;;) {
+            _nHashBits = nHashBits;
+            _nProbeMax = CastN(BYTE, cValT::Max<BIT_ENUM_t>(nHashBits, 4) + 1);
+            const ITERATE_t nSlots = get_SlotQty();
+            const size_t nSizeElems = nSlots * sizeof(ELEM_t);
+            _pElems = PtrCast<ELEM_t>(cHeap::AllocPtr(nSizeElems + nSlots));
+            _pProbe = PtrCast<BYTE>(_pElems) + nSizeElems;
+            cMem::Zero(_pProbe, nSlots);
+            _nCount = 0;
+
+            ITERATE_t i = 0;
+            for (; i < nSlotsOld; i++) {
+                if (pProbeOld[i] == 0) continue;
+                alignas(ELEM_t) BYTE tmp[sizeof(ELEM_t)];  // PlaceRaw may swap into this. keep the old table intact.
+                cMem::Copy(tmp, &pElemsOld[i], sizeof(ELEM_t));
+                ITERATE_t iSlotNew;
+                if (!PlaceRaw(tmp, iSlotNew)) break;  // this should be very rare.
+            }
+            if (i >= nSlotsOld) break;
+            // Too many collisions. Undo and try again bigger. Old elements are still intact.
+            cHeap::FreePtr(_pElems);
+            nHashBits++;
+        }
+
+        cHeap::FreePtr(pElemsOld);  // no destructors. elements were moved.
+    }
+
+    /// <summary>
+    /// Move a new element in. Grow if needed.
+    /// </summary>
+    /// <returns>The slot where the new element ended up.</returns>
+    ITERATE_t AddRaw(BYTE* pElemRaw) {
+        if ((_nCount + 1) * k_nLoadDiv > get_HomeQty() * k_nLoadMax) {
+            Rehash(CastN(BIT_ENUM_t, (_nHashBits == 0) ? k_nHashBitsMin : (_nHashBits + 1)));
+        }
+        const TYPE_HASHCODE key = _TYPE_KEYER::GetKey(*PtrCast<ELEM_t>(pElemRaw));
+        ITERATE_t iSlotNew;
+        while (!PlaceRaw(pElemRaw, iSlotNew)) {
+            // pElemRaw is now some displaced element. The table is otherwise intact.
+            Rehash(CastN(BIT_ENUM_t, _nHashBits + 1));
+        }
+        if (_TYPE_KEYER::GetKey(_pElems[iSlotNew]) != key) {
+            iSlotNew = FindISlot(key);  // we rehashed after placing it.
+        }
+        return iSlotNew;
+    }
+
+    /// <summary>
+    /// Remove a used slot. backward shift the following elements.
+    /// </summary>
+    void RemoveSlot(ITERATE_t i) {
+        DEBUG_CHECK(IS_INDEX_GOOD(i, get_SlotQty()) && _pProbe[i] != 0);
+        _pElems[i].~ELEM_t();
+        _nCount--;
+        const ITERATE_t nSlots = get_SlotQty();
+        for (; i + 1 < nSlots; i++) {
+            const BYTE nProbe = _pProbe[i + 1];
+            if (nProbe <= 1) break;  // empty or at home.
+            cMem::Copy(&_pElems[i], &_pElems[i + 1], sizeof(ELEM_t));
+            _pProbe[i] = CastN(BYTE, nProbe - 1);
+        }
+        _pProbe[i] = 0;
+    }
+
+ public:
+    ~cHashMapOpenT() {
+        RemoveAll();
+    }
+
+    /// <summary>
+    /// Total slots allocated. Includes the overflow slots.
+    /// </summary>
+    inline ITERATE_t get_SlotQty() const noexcept {
+        return (_nHashBits == 0) ? 0 : (get_HomeQty() + _nProbeMax);
+    }
+
+    /// <summary>
+    /// for FOREACH_HASH_TABLE. Each slot is a bucket.
+    /// </summary>
+    inline ITERATE_t get_BucketQty() const noexcept {
+        return get_SlotQty();
+    }
+    inline bool IsValidBucketNum(ITERATE_t nBucketNum) const noexcept {
+        return IS_INDEX_GOOD(nBucketNum, get_SlotQty());
+    }
+    /// <summary>
+    /// Get the current fill level of a particular slot. 0 or 1.
+    /// </summary>
+    inline ITERATE_t GetBucketSize(ITERATE_t nBucketNum) const noexcept {
+        DEBUG_CHECK(IsValidBucketNum(nBucketNum));
+        return (_pProbe[nBucketNum] != 0) ? 1 : 0;
+    }
+
+    bool IsEmpty() const noexcept {
+        return _nCount <= 0;
+    }
+    ITERATE_t get_TotalCount() const noexcept {
+        return _nCount;
+    }
+
+    /// <summary>
+    /// Make sure we can hold nCount elements without growing.
+    /// </summary>
+    void SetCapacity(ITERATE_t nCount) {
+        BIT_ENUM_t nHashBits = k_nHashBitsMin;
+        while (nCount * k_nLoadDiv > cBits::Mask1<ITERATE_t>(nHashBits) * k_nLoadMax) nHashBits++;
+        if (nHashBits > _nHashBits) Rehash(nHashBits);
+    }
+
+    /// <summary>
+    /// AKA Empty(). Frees the slots.
+    /// </summary>
+    void RemoveAll() {
+        const ITERATE_t nSlots = get_SlotQty();
+        for (ITERATE_t i = 0; i < nSlots; i++) {
+            if (_pProbe[i] != 0) _pElems[i].~ELEM_t();
+        }
+        cHeap::FreePtr(_pElems);
+        _pElems = nullptr;
+        _pProbe = nullptr;
+        _nCount = 0;
+        _nHashBits = 0;
+        _nProbeMax = 0;
+    }
+
+    /// <summary>
+    /// Remove while iterating. The next element (if any) shifts back into this slot so we revisit it.
+    /// </summary>
+    void RemoveAt(cHashIterator& i) {
+        ASSERT(IsValidBucketNum(i._b) && i._j == 0);
+        RemoveSlot(i._b);
+        i.SkipRemoved();
+    }
+
+    const ELEM_t& GetAtHash(const cHashIterator& i) const {
+        //! get from hash table. i must exist.
+        ASSERT(IsValidBucketNum(i._b) && i._j == 0 && _pProbe[i._b] != 0);
+        return _pElems[i._b];
+    }
+
+    /// <summary>
+    /// Find the key.
+    /// </summary>
+    /// <returns>iterator. isValid() = false if not found.</returns>
+    cHashIterator FindIForKey(TYPE_HASHCODE rid) const {
+        const ITERATE_t i = FindISlot(rid);
+        return cHashIterator(i, (i < 0) ? k_ITERATE_BAD : 0);
+    }
+
+    bool DeleteKey(TYPE_HASHCODE rid) {
+        //! delete it
+        const ITERATE_t i = FindISlot(rid);
+        if (i < 0) return false;
+        RemoveSlot(i);
+        return true;
+    }
+};
+
+/// <summary>
+/// Open addressing hash map that holds structs not references/pointers. Grows as needed.
+/// Drop in replacement for cHashTableStruct. ASSUME TYPE is just a class that has a get_HashCode() method.
+/// @note Add() of a duplicate hash code replaces the old element.
+/// </summary>
+/// <typeparam name="TYPE"></typeparam>
+/// <typeparam name="TYPE_HASHCODE"></typeparam>
+template <class TYPE, typename TYPE_HASHCODE = HASHCODE_t>
+class cHashMapOpen : public cHashMapOpenT<TYPE, TYPE_HASHCODE, cHashKeyStruct<TYPE, TYPE_HASHCODE> > {
+    typedef cHashMapOpenT<TYPE, TYPE_HASHCODE, cHashKeyStruct<TYPE, TYPE_HASHCODE> > SUPER_t;
+
+ public:
+    typedef const TYPE& ARG_t;  // How to refer to this? value or ref or pointer?
+
+ public:
+    const TYPE* FindArgForKey(TYPE_HASHCODE rid) const {
+        const ITERATE_t i = this->FindISlot(rid);
+        if (i < 0) return nullptr;
+        return &this->_pElems[i];
+    }
+    const TYPE& Add(ARG_t rNew) {
+        ITERATE_t i = this->FindISlot(rNew.get_HashCode());
+        if (i >= 0) {
+            this->_pElems[i] = rNew;  // replace.
+            return this->_pElems[i];
+        }
+        alignas(TYPE) BYTE tmp[sizeof(TYPE)];
+        ::new ((void*)tmp) TYPE(rNew);
+        i = this->AddRaw(tmp);
+        return this->_pElems[i];
+    }
+    /// <summary>
+    /// Add only new hash node.
+    /// </summary>
+    /// <param name="rNew"></param>
+    /// <returns>pointer ONLY if existing hash node. nullptr = it was new.</returns>
+    TYPE* AddSpecial(ARG_t rNew) {
+        const ITERATE_t i = this->FindISlot(rNew.get_HashCode());
+        if (i >= 0) return &this->_pElems[i];  // special return that says it already was here.
+        alignas(TYPE) BYTE tmp[sizeof(TYPE)];
+        ::new ((void*)tmp) TYPE(rNew);
+        this->AddRaw(tmp);
+        return nullptr;  // special return that says i added it.
+    }
+};
+
+/// <summary>
+/// Open addressing hash map that holds refs. Grows as needed.
+/// Drop in replacement for cHashTableRef. ASSUME TYPE is cRefBase and implements get_HashCode().
+/// Must have external lock to make thread safe.
+/// </summary>
+/// <typeparam name="TYPE"></typeparam>
+/// <typeparam name="TYPE_HASHCODE"></typeparam>
+template <class TYPE, typename TYPE_HASHCODE = HASHCODE_t>
+class cHashMapOpenRef : public cHashMapOpenT<cRefPtr<TYPE>, TYPE_HASHCODE, cHashKeyRef<TYPE, TYPE_HASHCODE> > {
+ protected:
+    typedef cHashMapOpenT<cRefPtr<TYPE>, TYPE_HASHCODE, cHashKeyRef<TYPE, TYPE_HASHCODE> > SUPER_t;
+    typedef cRefPtr<TYPE> REF_t;
+
+ public:
+    TYPE* FindArgForKey(TYPE_HASHCODE rid) const {
+        const ITERATE_t i = this->FindISlot(rid);
+        if (i < 0) return nullptr;
+        return this->_pElems[i].get_Ptr();
+    }
+    /// <summary>
+    /// Add or replace the existing ref with the same hash code.
+    /// </summary>
+    /// <returns>slot index</returns>
+    ITERATE_t Add(TYPE* pNew) {
+        ASSERT_NN(pNew);
+        const ITERATE_t i = this->FindISlot(pNew->get_HashCode());
+        if (i >= 0) {
+            this->_pElems[i] = pNew;  // replace.
+            return i;
+        }
+        alignas(REF_t) BYTE tmp[sizeof(REF_t)];
+        ::new ((void*)tmp) REF_t(pNew);
+        return this->AddRaw(tmp);
+    }
+    bool DeleteArg(TYPE* pObj) {
+        if (pObj == nullptr) return false;
+        const ITERATE_t i = this->FindISlot(pObj->get_HashCode());
+        if (i < 0 || this->_pElems[i].get_Ptr() != pObj) return false;
+        this->RemoveSlot(i);
+        return true;
+    }
+
+    /// <summary>
+    /// Like RemoveAll() but Dispose. Called at destructor time?
+    /// ASSUME TYPE supports DisposeThis(); like cXObject
+    /// @note DisposeThis() may remove itself from the table. so start over when that happens.
+    /// </summary>
+    void DisposeAll() {
+        for (ITERATE_t i = 0; i < this->get_SlotQty();) {
+            if (this->_pProbe[i] == 0) {
+                i++;
+                continue;
+            }
+            const ITERATE_t nCount = this->_nCount;
+            REF_t pObj = this->_pElems[i];
+            if (pObj != nullptr) pObj->DisposeThis();
+            i = (nCount != this->_nCount) ? 0 : (i + 1);
+        }
+        this->RemoveAll();
+    }
+};
+}  // namespace Gray
+
+#endif  // _INC_cHashMapOpen_H
@@ -11,6 +11,7 @@
 #include "Index.h"
 #include "cArraySortRef.h"
 #include "cBits.h"
+#include "cString.h"
 
 namespace Gray {
 
@@ -68,6 +69,12 @@ class cHashStorageT {
     _TYPE_BUCKET _aBucket[k_HASH_BUCKET_QTY];  // array of buckets
 
  public:
+    /// <summary>
+    /// for FOREACH_HASH_TABLE. same interface as cHashMapOpenT.
+    /// </summary>
+    static constexpr ITERATE_t get_BucketQty() noexcept {
+        return k_HASH_BUCKET_QTY;
+    }
     inline bool IsValidBucketNum(ITERATE_t nBucketNum) const {
         return IS_INDEX_GOOD(nBucketNum, k_HASH_BUCKET_QTY);
     }
@@ -232,6 +239,7 @@ class cHashTableRef : public cHashTableT<cArraySortHash<TYPE, TYPE_HASHCODE>, TY
 
 /// <summary>
 /// Hash table that holds refs ordered by alpha. Typical Map. ASSUME TYPE is cRefBase and implements get_Name()
+/// Bucket is the (case ignored) StrT::GetHashCode32() of the name. So a cStringA or cStringHashedA key uses its cached hash code.
 /// </summary>
 /// <typeparam name="TYPE">cRefBase that supports get_Name()</typeparam>
 /// <typeparam name="TYPE_HASHBITS"></typeparam>
@@ -243,23 +251,43 @@ class cHashTableName : public cHashStorageT<cArraySortName<TYPE, char>, TYPE_HAS
     typedef cRefPtr<TYPE> REF_t;
     typedef const char* KEY_t;
 
+    inline ITERATE_t GetBucketNumHash(HASHCODE32_t nHashCode) const noexcept {
+        return CastN(ITERATE_t, nHashCode & (SUPER_t::k_HASH_BUCKET_QTY - 1));
+    }
     inline ITERATE_t GetBucketNum(KEY_t pszName) const noexcept {
-        return CastN(ITERATE_t, pszName[0] & (SUPER_t::k_HASH_BUCKET_QTY - 1));
+        return GetBucketNumHash(StrT::GetHashCode32<char>(StrT::ToSpanStr(pszName)));
     }
 
     REF_t FindArgForKey(KEY_t pszName) const {
         const ITERATE_t nBucketNum = this->GetBucketNum(pszName);
         return this->_aBucket[nBucketNum].FindArgForKey(pszName);
     }
+    REF_t FindArgForKey(const cStringHashedA& sName) const {
+        const ITERATE_t nBucketNum = this->GetBucketNumHash(sName.get_HashCode());
+        return this->_aBucket[nBucketNum].FindArgForKey(sName.get_CPtr());
+    }
 
     cHashIterator FindINearKey(KEY_t pszName, OUT COMPARE_t& iCompareRes) const {
         const ITERATE_t nBucketNum = GetBucketNum(pszName);
         return cHashIterator(nBucketNum, this->_aBucket[nBucketNum].FindINearKey(pszName, iCompareRes));
     }
+    cHashIterator FindINearKey(const cSpan<char>& name, OUT COMPARE_t& iCompareRes) const {
+        const ITERATE_t nBucketNum = GetBucketNumHash(StrT::GetHashCode32<char>(name));
+        return cHashIterator(nBucketNum, this->_aBucket[nBucketNum].FindINearKey(name.get_PtrConst(), iCompareRes));
+    }
+    cHashIterator FindINearKey(const cStringA& sName, OUT COMPARE_t& iCompareRes) const {
+        const ITERATE_t nBucketNum = GetBucketNumHash(sName.get_HashCode());  // cached in the head.
+        return cHashIterator(nBucketNum, this->_aBucket[nBucketNum].FindINearKey(sName.get_CPtr(), iCompareRes));
+    }
+    cHashIterator FindINearKey(const cStringHashedA& sName, OUT COMPARE_t& iCompareRes) const {
+        const ITERATE_t nBucketNum = GetBucketNumHash(sName.get_HashCode());
+        return cHashIterator(nBucketNum, this->_aBucket[nBucketNum].FindINearKey(sName.get_CPtr(), iCompareRes));
+    }
 
     ITERATE_t InsertAt(const cHashIterator& index, COMPARE_t iCompareRes, TYPE* pNew) {
         ASSERT_NN(pNew);
-        const ITERATE_t nBucketNum = GetBucketNum(pNew->get_Name());
+        const ITERATE_t nBucketNum = index._b;  // from FindINearKey().
+        DEBUG_CHECK(nBucketNum == GetBucketNum(pNew->get_Name()));
         return this->_aBucket[nBucketNum].AddPresorted(index._j, iCompareRes, pNew);
     }
     ITERATE_t Add(TYPE* pNew) {
@@ -281,8 +309,9 @@ class cHashTableName : public cHashStorageT<cArraySortName<TYPE, char>, TYPE_HAS
 };
 
 // Iterate through all members. iterator i; 	// similar to BOOST_FOREACH()
-#define FOREACH_HASH_TABLE(h, i)                              \
-    for (cHashIterator i; i._b < h.k_HASH_BUCKET_QTY; i._b++) \
+// Works for cHashTableT and cHashMapOpenT.
+#define FOREACH_HASH_TABLE(h, i)                            \
+    for (cHashIterator i; i._b < h.get_BucketQty(); i._b++) \
         for (i._j = 0; i._j < h.GetBucketSize(i._b); i._j++)
 }  // namespace Gray
 
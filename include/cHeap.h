@@ -54,7 +54,8 @@ struct GRAYCORE_LINK cHeapCommon : public cMem {  // static class
 #ifdef _WIN32
     static ::HANDLE g_hHeap;  /// ::GetProcessHeap() _WIN32
 #endif
-    static cHeapStats g_Stats;
+    static cHeapStats g_Stats;     /// may lag behind if sm_bThreadCache. use GetStats().
+    static bool sm_bThreadCache;  /// cHeap keeps freed small blocks in a per thread cache. Set by Init().
 
     /// <summary>
     /// What is the alignment of this pointer?
@@ -75,7 +76,17 @@ struct GRAYCORE_LINK cHeapCommon : public cMem {  // static class
     /// </summary>
     static UINT64 GRAYCALL get_PhysAvail();
 
-    static void GRAYCALL Init(int nFlags = 0);
+    /// <summary>
+    /// Get g_Stats plus the per thread stats not yet added to it (sm_bThreadCache).
+    /// </summary>
+    static cHeapStats GRAYCALL GetStats() noexcept;
+
+    /// <summary>
+    /// Initialize the heap.
+    /// </summary>
+    /// <param name="nFlags">_CRTDBG_ALLOC_MEM_DF | _CRTDBG_DELAY_FREE_MEM_DF etc. for _DEBUG heap.</param>
+    /// <param name="bThreadCache">use a per thread cache of small blocks in cHeap. sm_bThreadCache</param>
+    static void GRAYCALL Init(int nFlags = 0, bool bThreadCache = false);
     static bool GRAYCALL Check();
 };
 
@@ -100,6 +111,12 @@ struct GRAYCORE_LINK cHeap : public cHeapCommon {  // static class
 
     static void* GRAYCALL ReAllocPtr(void* pData, size_t nSize);
 
+    /// <summary>
+    /// Give this threads cached blocks back to the heap and add its stats to g_Stats. sm_bThreadCache
+    /// Done automatically on thread exit. Call before a leak check.
+    /// </summary>
+    static void GRAYCALL FlushThreadCache() noexcept;
+
     /// helpers
 
     /// <summary>
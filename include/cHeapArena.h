@@ -0,0 +1,142 @@
+//! @file cHeapArena.h
+//! Bump pointer arena allocator. Many small allocations freed together.
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+
+#ifndef _INC_cHeapArena_H
+#define _INC_cHeapArena_H
+#ifndef NO_PRAGMA_ONCE
+#pragma once
+#endif
+
+#include "cHeap.h"
+#include "cNonCopyable.h"
+
+namespace Gray {
+/// <summary>
+/// Region/monotonic allocator. Allocate by bumping a pointer in a chunk. Chain more chunks from cHeap as needed.
+/// FreePtr() of a single block does nothing (unless it was the last block). Reset() frees everything at once.
+/// Use with cHeapArenaScope so cArrayImpl, cArrayT (cQueueDyn) and cStringT allocate from it.
+/// @note NOT thread safe. Use one per thread/request.
+/// @note Anything allocated here is invalid after Reset() or destruct.
+/// </summary>
+class GRAYCORE_LINK cHeapArena : protected cNonCopyable {
+ public:
+    static const size_t k_nChunkSizeDef = 16 * 1024;    /// size of the first chunk.
+    static const size_t k_nChunkSizeMax = 1024 * 1024;  /// chunks double in size up to this.
+
+ private:
+    /// <summary>
+    /// Header for a chunk of memory from cHeap. Blocks follow.
+    /// </summary>
+    struct cChunk {
+        cChunk* _pNext;  /// older chunk.
+        BYTE* _pEnd;     /// end of this chunk.
+    };
+    static const size_t k_nChunkHead = (sizeof(cChunk) + cHeapCommon::k_SizeAlignDef - 1) & ~(cHeapCommon::k_SizeAlignDef - 1);
+    static const size_t k_nBlockHead = cHeapCommon::k_SizeAlignDef;  /// each block has its size stored before it. padded to keep alignment.
+
+    cChunk* _pChunks = nullptr;  /// List of chunks. Newest (current) first.
+    BYTE* _pNext = nullptr;      /// next free byte in the current chunk.
+    BYTE* _pLast = nullptr;      /// the last block allocated in the current chunk. may grow/free in place.
+    size_t _nChunkSize;          /// size of the next chunk to allocate.
+    size_t _nSizeUsed = 0;       /// total bytes given out. (including block headers)
+    const BYTE* _pMin = nullptr;  /// lowest address of any chunk. IsInside() rejects most cHeap blocks without walking the chunks.
+    const BYTE* _pMax = nullptr;  /// end of the highest chunk.
+
+ private:
+    static inline size_t GetBlockSize(size_t nSize) noexcept {
+        return k_nBlockHead + ((nSize + cHeapCommon::k_SizeAlignDef - 1) & ~(cHeapCommon::k_SizeAlignDef - 1));
+    }
+    static inline size_t& RefSize(void* pData) noexcept {
+        return *PtrCast<size_t>(PtrCast<BYTE>(pData) - k_nBlockHead);
+    }
+    BYTE* AllocChunk(size_t nSizeBlock);
+    bool IsInsideChunks(const void* pData) const noexcept;
+    void FreeChunks(cChunk* pKeep) noexcept;  /// Free all chunks except pKeep.
+
+ public:
+    explicit cHeapArena(size_t nChunkSize = k_nChunkSizeDef) noexcept : _nChunkSize(nChunkSize) {}
+    ~cHeapArena() noexcept {
+        FreeChunks(nullptr);
+    }
+
+    /// <summary>
+    /// Total bytes given out since Reset(). including per block overhead.
+    /// </summary>
+    size_t get_SizeUsed() const noexcept {
+        return _nSizeUsed;
+    }
+
+    /// <summary>
+    /// Was pData allocated from this arena ? Quick reject outside the range of all chunks. else walk the chunks.
+    /// </summary>
+    bool IsInside(const void* pData) const noexcept {
+        if (pData < static_cast<const void*>(_pMin) || pData >= static_cast<const void*>(_pMax)) return false;
+        return IsInsideChunks(pData);
+    }
+
+    /// <summary>
+    /// Get the size of a block. ASSUME IsInside().
+    /// </summary>
+    static size_t GRAYCALL GetSize(const void* pData) noexcept {
+        return *PtrCast<const size_t>(PtrCast<const BYTE>(pData) - k_nBlockHead);
+    }
+
+    void* AllocPtr(size_t nSize);
+
+    /// <summary>
+    /// Give back a block. ASSUME IsInside(). Only the last block is really reclaimed. Others wait for Reset().
+    /// </summary>
+    void FreePtr(void* pData) noexcept;
+
+    /// <summary>
+    /// Resize a block. ASSUME IsInside(). The last block grows in place if it can. Others get copied.
+    /// </summary>
+    void* ReAllocPtr(void* pData, size_t nSize);
+
+    /// <summary>
+    /// Free all blocks at once. Keep the newest (biggest) chunk for re-use.
+    /// </summary>
+    void Reset() noexcept;
+};
+
+/// <summary>
+/// Make cHeapArenaHook use this arena for the current thread till this goes out of scope.
+/// Can be nested. A nullptr arena goes back to cHeap (for things that must outlive the arena) while still knowing the outer arena blocks.
+/// @note anything allocated in the arena must be freed (or abandoned) before the scope ends.
+/// </summary>
+class GRAYCORE_LINK cHeapArenaScope : protected cNonCopyable {
+    friend struct cHeapArenaHook;
+    cHeapArena* const _pArena;       /// may be nullptr = use cHeap.
+    cHeapArenaScope* const _pPrev;  /// outer scope for this thread.
+
+ public:
+    explicit cHeapArenaScope(cHeapArena* pArena) noexcept;
+    explicit cHeapArenaScope(cHeapArena& rArena) noexcept : cHeapArenaScope(&rArena) {}
+    ~cHeapArenaScope() noexcept;
+};
+
+/// <summary>
+/// Allocator hook for cArrayImpl, cArrayHeadT and cStringHeadT. Same footprint as cHeap.
+/// Allocate from the current thread cHeapArenaScope arena or cHeap if none.
+/// Blocks from any arena in scope are recognized and sent back to it.
+/// </summary>
+struct GRAYCORE_LINK cHeapArenaHook : public cHeapCommon {  // static class
+    /// <summary>
+    /// Get the arena the current thread allocates from. nullptr = cHeap.
+    /// </summary>
+    static cHeapArena* GRAYCALL get_Arena() noexcept;
+
+    /// <summary>
+    /// Get the arena in scope that holds pData. nullptr = cHeap.
+    /// </summary>
+    static cHeapArena* GRAYCALL FindArena(const void* pData) noexcept;
+
+    static bool GRAYCALL IsValidHeap(const void* pData) noexcept;
+    static size_t GRAYCALL GetSize(const void* pData) noexcept;
+    static void* GRAYCALL AllocPtr(size_t nSize);
+    static void GRAYCALL FreePtr(void* pData) noexcept;
+    static void* GRAYCALL ReAllocPtr(void* pData, size_t nSize);
+};
+}  // namespace Gray
+#endif  // _INC_cHeapArena_H
@@ -0,0 +1,162 @@
+//! @file cHistogramHdr.h
+//! High dynamic range histogram of values. e.g. cTimePerf latency.
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+
+#ifndef _INC_cHistogramHdr_H
+#define _INC_cHistogramHdr_H
+#ifndef NO_PRAGMA_ONCE
+#pragma once
+#endif
+
+#include "ITextWriter.h"
+#include "cArray.h"
+#include "cBits.h"
+#include "cNonCopyable.h"
+#include "cThreadLocalSys.h"
+#include "cThreadLock.h"
+#include "cTimeSys.h"
+
+namespace Gray {
+struct cLogProcessor;
+
+/// <summary>
+/// Log-linear histogram of UINT64 values. Like HdrHistogram.
+/// Values below k_nSubQty have exact buckets. Each power of 2 above that is split into k_nHalfQty linear buckets. So relative error is -lt- 1/k_nHalfQty. (3%)
+/// Fixed size. No heap. Mergeable. NOT thread safe. Use cHistogramHdrShared for many threads.
+/// </summary>
+class GRAYCORE_LINK cHistogramHdr {
+ public:
+    static const BIT_ENUM_t k_nSubBits = 6;
+    static const ITERATE_t k_nSubQty = 1 << k_nSubBits;   /// values below this are exact.
+    static const ITERATE_t k_nHalfQty = k_nSubQty / 2;    /// buckets per power of 2 above k_nSubQty.
+    static const ITERATE_t k_nBuckets = ((64 - k_nSubBits) + 2) * k_nHalfQty;  /// covers all of UINT64.
+
+ protected:
+    UINT64 _nCount = 0;  /// total values recorded.
+    UINT64 _nTotal = 0;  /// sum of all values. for mean.
+    UINT64 _nMin = cTypeLimit<UINT64>::Max();
+    UINT64 _nMax = 0;
+    UINT64 _aBuckets[k_nBuckets];
+
+ public:
+    cHistogramHdr() noexcept {
+        cMem::Zero(_aBuckets, sizeof(_aBuckets));
+    }
+
+    /// <summary>
+    /// Get the bucket index for a value.
+    /// </summary>
+    static inline ITERATE_t GetBucket(UINT64 nVal) noexcept {
+        if (nVal < CastN(UINT64, k_nSubQty)) return CastN(ITERATE_t, nVal);
+        const BIT_ENUM_t nShift = cBits::Highest1Bit(nVal) - k_nSubBits;  // keep the top k_nSubBits bits.
+        return CastN(ITERATE_t, nShift * k_nHalfQty) + CastN(ITERATE_t, nVal >> nShift);
+    }
+    /// <summary>
+    /// Lowest value that goes in bucket i.
+    /// </summary>
+    static UINT64 GRAYCALL GetBucketMin(ITERATE_t i) noexcept;
+    /// <summary>
+    /// Highest value that goes in bucket i.
+    /// </summary>
+    static UINT64 GRAYCALL GetBucketMax(ITERATE_t i) noexcept;
+
+    UINT64 get_Count() const noexcept {
+        return _nCount;
+    }
+    UINT64 get_Min() const noexcept {
+        return (_nCount > 0) ? _nMin : 0;
+    }
+    UINT64 get_Max() const noexcept {
+        return _nMax;
+    }
+    double get_Mean() const noexcept {
+        return (_nCount > 0) ? (CastN(double, _nTotal) / CastN(double, _nCount)) : 0.0;
+    }
+    UINT64 GetBucketCount(ITERATE_t i) const noexcept {
+        DEBUG_CHECK(IS_INDEX_GOOD(i, k_nBuckets));
+        return _aBuckets[i];
+    }
+
+    /// <summary>
+    /// Record a single value. a few instructions.
+    /// </summary>
+    void Add(UINT64 nVal) noexcept {
+        _aBuckets[GetBucket(nVal)]++;
+        _nCount++;
+        _nTotal += nVal;
+        if (nVal < _nMin) _nMin = nVal;
+        if (nVal > _nMax) _nMax = nVal;
+    }
+    /// <summary>
+    /// Record the cTimePerf time since tStart.
+    /// </summary>
+    void AddPerf(const cTimePerf& tStart) noexcept {
+        Add(tStart.get_AgePerf());
+    }
+
+    /// <summary>
+    /// Add all values of another histogram to this one.
+    /// </summary>
+    void Merge(const cHistogramHdr& src) noexcept;
+    void Reset() noexcept;
+
+    /// <summary>
+    /// Get the value at a percentile. Highest value of its bucket. within _nMin and _nMax.
+    /// </summary>
+    /// <param name="dPercent">0 to 100. e.g. 99.9</param>
+    UINT64 GetPercentile(double dPercent) const noexcept;
+
+    /// <summary>
+    /// Format a one line summary. count, min, p50, p90, p99, p999, max, mean.
+    /// </summary>
+    /// <param name="pszName">label for the line.</param>
+    /// <param name="bPerf">values are cTimePerf units. show as microseconds.</param>
+    /// <returns>length</returns>
+    StrLen_t GetSummary(cSpanX<char> ret, const char* pszName, bool bPerf = true) const;
+    HRESULT WriteSummary(ITextWriter& o, const char* pszName, bool bPerf = true) const;
+    HRESULT LogSummary(cLogProcessor& rLog, const char* pszName, bool bPerf = true) const;
+};
+
+/// <summary>
+/// cHistogramHdr recorded from many threads. Each thread records into its own cHistogramHdr with no locks or interlocked ops.
+/// GetSnapshot() merges them all. Stats from other threads may be slightly stale.
+/// Uses a cThreadLocalSys slot per instance. So these should be long lived and few. (limited number of slots per process)
+/// </summary>
+class GRAYCORE_LINK cHistogramHdrShared : protected cNonCopyable {
+    cThreadLocalSysT<cHistogramHdr> _TLS;     /// this threads histogram in _aThreads.
+    mutable cThreadLockableX _Lock;           /// protect _aThreads. NOT used to record.
+    cArrayPtr<cHistogramHdr> _aThreads;       /// kept after the thread exits.
+
+ private:
+    cHistogramHdr* CreateThreadCurrent() noexcept;
+
+ public:
+    cHistogramHdrShared() noexcept {}
+    ~cHistogramHdrShared();
+
+    void Add(UINT64 nVal) noexcept {
+        cHistogramHdr* pHist = _TLS.GetData();
+        if (pHist == nullptr) {
+            pHist = CreateThreadCurrent();
+            if (pHist == nullptr) return;
+        }
+        pHist->Add(nVal);
+    }
+    void AddPerf(const cTimePerf& tStart) noexcept {
+        Add(tStart.get_AgePerf());
+    }
+
+    /// <summary>
+    /// Merge all threads into rHist.
+    /// </summary>
+    void GetSnapshot(cHistogramHdr& rHist) const;
+    /// <summary>
+    /// Zero all threads. Values being recorded at the same time on other threads may be lost or partly counted.
+    /// </summary>
+    void Reset();
+
+    HRESULT WriteSummary(ITextWriter& o, const char* pszName, bool bPerf = true) const;
+    HRESULT LogSummary(cLogProcessor& rLog, const char* pszName, bool bPerf = true) const;
+};
+}  // namespace Gray
+#endif
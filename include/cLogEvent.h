@@ -8,6 +8,7 @@
 #endif
 
 #include "StrBuilder.h"
+#include "StrFormat.h"
 #include "cLogSink.h"
 #include "cTimeInt.h"
 
@@ -22,18 +23,56 @@ enum class LOG_FIELD_t {
 
 /// <summary>
 /// Store a single log event (ref counted) instance for asynchronous processing.
-/// TODO store log event as (format,stringarg1,stringargN) and allow translation of the format but assume stringargs are always proper names (not translatable)
+/// The message is either text (_sMsg) or a static format and its args (_Args) that are not rendered until some sink wants the text.
+/// TODO allow translation of the format but assume stringargs are always proper names (not translatable)
 /// </summary>
 struct GRAYCORE_LINK cLogEvent : public cLogEventParams, public cRefBase {
+ private:
+    mutable INTER32_t VOLATILE _nFormattedState = 0;  /// 0 = not rendered, 1 = rendering, 2 = _sFormatted is ready.
+    mutable cStringL _sFormatted;                      /// cached get_FormattedSpan(). rendered once for all sinks.
+
+ public:
     TIMESEC_t _nTimeSec = 0;            /// when did this happen? as cTimeInt. maybe not set until needed. ! isTimeValid()
     const char* _pszSubject = nullptr;  /// static allocated general subject matter tag. can be filled in by cLogSubject. Script source ?
-    cStringL _sMsg;                     /// free form message text.
+    cStringL _sMsg;                     /// free form message text. empty if _Args is used.
+    StrFormatArgs<LOGCHAR_t> _Args;     /// deferred formatting. static format and packed args. render only when needed.
 
     cLogEvent(LOG_ATTR_MASK_t uAttrMask, LOGLVL_t eLogLevel, cStringL sMsg) noexcept : cLogEventParams(uAttrMask, eLogLevel), _sMsg(sMsg) {}
+    /// <summary>
+    /// Make an event with no message. Caller must fill in _Args (or _sMsg).
+    /// </summary>
+    cLogEvent(LOG_ATTR_MASK_t uAttrMask, LOGLVL_t eLogLevel) noexcept : cLogEventParams(uAttrMask, eLogLevel) {}
+
+    bool isMsgEmpty() const noexcept {
+        return _sMsg.IsEmpty() && _Args.isEmpty();
+    }
+
+    /// <summary>
+    /// Make sure _sMsg is not in the current thread cHeapArena. Call before keeping the event past the addEvent() call.
+    /// </summary>
+    void MakeHeapMsg();
+
+    /// <summary>
+    /// Add just the message text. Render _Args if that is how it was stored.
+    /// </summary>
+    void GetMsg(StrBuilder<LOGCHAR_t>& s) const;
+    /// <summary>
+    /// Get just the message text. Render _Args if that is how it was stored.
+    /// </summary>
+    cStringL get_Msg() const;
 
     /// take all my attributes and make a single string in normal/default format. adds FILE_EOL.
     void GetFormattedDefault(StrBuilder<LOGCHAR_t>& s) const;
-    cStringL get_FormattedDefault() const;
+
+    /// <summary>
+    /// The default format text. Rendered once (thread safe) and cached for all sinks. Don't change the event after this.
+    /// </summary>
+    /// <returns>view of the text. valid as long as this event. '\0' terminated.</returns>
+    cSpan<LOGCHAR_t> get_FormattedSpan() const;
+    cStringL get_FormattedDefault() const {
+        get_FormattedSpan();
+        return _sFormatted;
+    }
 };
 typedef cRefPtr<cLogEvent> cLogEventPtr;
 }  // namespace Gray
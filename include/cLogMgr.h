@@ -15,8 +15,11 @@
 #include "cArrayRef.h"
 #include "cDebugAssert.h"
 #include "cException.h"
+#include "cLogEvent.h"
 #include "cLogSink.h"
+#include "cQueueLockFree.h"
 #include "cSingleton.h"
+#include "cThreadBase.h"
 #include "cTimeSys.h"
 #include "cTimeUnits.h"
 #include "cTypeInfo.h"
@@ -24,6 +27,80 @@
 // #define _DEBUG_FAST	// put debug in release mode optimized code.
 
 namespace Gray {
+class cLogNexus;
+
+/// <summary>
+/// What an async cLogNexus does with a new event when its queue is full.
+/// </summary>
+enum class LOG_OVERFLOW_t : BYTE {
+    _Block,       /// Wait for the writer thread to make room. Lose nothing.
+    _DropOldest,  /// Toss the oldest queued event to make room.
+    _DropDebug,   /// Toss the new event if it is just debug/trace detail. else wait like _Block.
+};
+
+/// <summary>
+/// Writer thread for an async cLogNexus.
+/// Producers push cLogEventPtr into a bounded lock free queue. This thread drains it to the sinks in batches.
+/// </summary>
+class GRAYCORE_LINK cLogNexusAsync final : public cThreadRef {
+    friend class cLogNexus;
+
+ public:
+    static const ITERATE_t k_nQtyDef = 8 * 1024;  /// default queue size.
+    static const ITERATE_t k_nBatchMax = 256;     /// max events popped per batch.
+
+ private:
+    cLogNexus& _rNexus;
+    cQueueLockFree<cLogEventPtr> _Queue;
+    LOG_OVERFLOW_t _eOverflow;  /// only set while the thread is not running.
+
+    INTER32_t VOLATILE _nWriterParked = 0;    /// the writer thread is (about to be) parked on _nWriterSeq.
+    INTER32_t VOLATILE _nWriterSeq = 0;       /// wake the writer thread.
+    INTER32_t VOLATILE _nProducersParked = 0;  /// producers parked on _nSpaceSeq waiting for room.
+    INTER32_t VOLATILE _nSpaceSeq = 0;        /// wake producers.
+    INTER32_t VOLATILE _nDonePos = 0;         /// all queue positions before this are delivered (or dropped).
+    cInterlockedUInt _nQtyDropped;            /// events tossed because the queue was full.
+    UINT _nQtyDroppedLast = 0;                /// _nQtyDropped already reported. writer thread only.
+
+ private:
+    static bool GRAYCALL IsDebugDetail(const cLogEvent& rEvent) noexcept;
+    void WakeWriter() noexcept;
+    void WakeProducers() noexcept;
+    HRESULT PushBlock(const cLogEventPtr& pEvent) noexcept;
+    ITERATE_t DrainBatch();
+    THREAD_EXITCODE_t Run() override;
+
+ public:
+    cLogNexusAsync(cLogNexus& rNexus, ITERATE_t nQtyMax, LOG_OVERFLOW_t eOverflow);
+    ~cLogNexusAsync() override;
+
+    /// <summary>
+    /// Should new events for this nexus go to the queue? Not if we are the writer (a sink logging) or stopping.
+    /// </summary>
+    bool isAsync() const noexcept {
+        return isThreadRunning() && !isThreadStopping() && !isCurrentThread();
+    }
+    UINT get_QtyDropped() const noexcept {
+        return _nQtyDropped.get_Value();
+    }
+
+    /// <summary>
+    /// Queue an event for the writer thread. Any thread. Apply LOG_OVERFLOW_t if full.
+    /// </summary>
+    /// <returns>1 = queued. -lt- 0 = dropped.</returns>
+    HRESULT Push(cLogEvent& rEvent) noexcept;
+
+    /// <summary>
+    /// Wait for the writer thread to deliver everything queued before this call. FlushLogs() barrier.
+    /// </summary>
+    void WaitForDelivered() noexcept;
+
+    /// <summary>
+    /// Stop the writer thread and deliver anything left on the calling thread.
+    /// </summary>
+    void StopAsync();
+};
+
 /// <summary>
 /// A nexus for routing log messages. (may have sub sinks)
 /// can submit directly instead of using cLogSubject = default
@@ -31,18 +108,37 @@ namespace Gray {
 /// Actual cLogEvent may be routed or filtered to multiple Sink/destinations/appender from here.
 /// Array of attached Sinks to say where the logged events go.
 /// addEvent() is multi thread safe.
+/// Optionally async. StartAsync() moves delivery to the sinks onto a dedicated writer thread.
 /// </summary>
 class GRAYCORE_LINK cLogNexus : public cLogProcessor {
+    friend class cLogNexusAsync;
+
  protected:
     cArrayIUnk<cLogSink> _aSinks;      /// where do the log messages go? child sinks. Protect with _LockLog.
+    cRefPtr<cLogNexusAsync> _pAsync;   /// writer thread if async. Never replaced once made. StartAsync() restarts it. so producers may use the raw pointer.
+
+ protected:
+    /// <summary>
+    /// Send the event to all sinks on the calling thread.
+    /// </summary>
+    HRESULT DispatchEvent(cLogEvent& rEvent) noexcept;
+    /// <summary>
+    /// Send the event to the writer thread if async. else DispatchEvent().
+    /// </summary>
+    HRESULT RouteEvent(cLogEvent& rEvent) noexcept;
+    /// <summary>
+    /// FlushLogs() all sinks on the calling thread. No barrier. Report pending repeats (cLogThrottle) first.
+    /// </summary>
+    void FlushSinks();
 
  public:
     cLogEventParams _LogFilter;         /// Union filter of what goes out to ALL sinks
-    cLogThrottle _LogThrottle;          /// Measure how fast messages are going.
+    cLogThrottle _LogThrottle;          /// Rate limit and coalesce messages for ALL sinks. default = off.
     mutable cThreadLockableX _LockLog;  /// serialize multiple threads for _aSinks
 
  public:
     cLogNexus(LOG_ATTR_MASK_t uAttrMask = LOG_ATTR_ALL_MASK, LOGLVL_t eLogLevel = LOGLVL_t::_ANY);
+    ~cLogNexus() override;
  
     /// <summary>
     /// Is this a cLogNexus or just a cLogProcessor?
@@ -66,8 +162,29 @@ class GRAYCORE_LINK cLogNexus : public cLogProcessor {
     /// <returns>-lt- 0 = failed, 0=not processed by anyone, # = number of processors.</returns>
     HRESULT addEvent(cLogEvent& rEvent) noexcept override;
 
+    /// <summary>
+    /// Deliver everything logged so far (waits for the async writer thread) then flush all sinks.
+    /// </summary>
     HRESULT FlushLogs() override;
 
+    /// <summary>
+    /// Start async mode. addEvent() just queues events and a writer thread delivers them to the sinks.
+    /// </summary>
+    /// <param name="nQtyMax">Size of the queue. rounded up to a power of 2. Ignored on a restart after StopAsync(). the queue is kept.</param>
+    /// <param name="eOverflow">What to do when the queue is full.</param>
+    /// <returns>S_FALSE = already async.</returns>
+    HRESULT StartAsync(ITERATE_t nQtyMax = cLogNexusAsync::k_nQtyDef, LOG_OVERFLOW_t eOverflow = LOG_OVERFLOW_t::_Block);
+
+    /// <summary>
+    /// Go back to delivering events on the calling thread. Delivers anything still queued.
+    /// </summary>
+    void StopAsync();
+
+    bool isAsync() const noexcept {
+        const cLogNexusAsync* pAsync = _pAsync.get_Ptr();
+        return pAsync != nullptr && pAsync->isThreadRunning() && !pAsync->isThreadStopping();
+    }
+
     // manage sinks. ASSUME _LockLog
     cLogSink* EnumSinks(ITERATE_t i) {
         return _aSinks.GetAtCheck(i);
@@ -7,11 +7,15 @@
 #pragma once
 #endif
 
+#include "cArray.h"
+#include "cArrayRef.h"
+#include "cIUnkPtr.h"
 #include "cLogLevel.h"
 #include "cRefPtr.h"
 #include "cStream.h"
 #include "cString.h"
 #include "cThreadLock.h"
+#include "cTimeSys.h"
 
 namespace Gray {
 struct cLogEvent;
@@ -105,23 +109,84 @@ class GRAYCORE_LINK cLogEventParams {
 };
 
 /// <summary>
-/// Parameters for time throttle of log messages. Queue messages up if they are coming too fast.
+/// Time throttle of log messages. Used by cLogNexus and optionally each cLogSink.
+/// Rate limit = token bucket. Allow a burst of _nBurst events then _fLogThrottle events/sec. Drop the rest. (GCRA with a single CompareExchange)
+/// Coalesce = repeats of the same (subject, static format) within a time window are counted not sent.
+///  The next one after the window gets a "Repeated N times" summary. Only deferred format events (StrFormatArgs) are coalesced.
+/// CheckEvent() is O(1) and lock free. Counters may be a bit off under heavy contention.
 /// </summary>
-struct GRAYCORE_LINK cLogThrottle {
-    // throttle.
-    float _fLogThrottle;             /// how fast sent to me? (messages/second)
-    mutable TIMESYS_t _TimeLogLast;  /// Last time period for throttling (1 sec).
-    mutable UINT _nQtyLogLast;       /// Qty of messages since _TimeLogLast.
+class GRAYCORE_LINK cLogThrottle {
+ public:
+    static const ITERATE_t k_nQtyRepeats = 64;  /// size of the coalesce table. power of 2. collisions just lose a summary.
+
+ private:
+    struct cRepeat {
+        UINT_PTR VOLATILE _nKey;           /// hash of subject and format. 0 = empty.
+        INT64 VOLATILE _nTimeStart;        /// start of the coalesce window. cTimePerf
+        INTER32_t VOLATILE _nQty;          /// repeats coalesced in this window.
+        const LOGCHAR_t* _pszFormat;       /// static format for the summary.
+        const char* _pszSubject;           /// static subject for the summary.
+        LOG_ATTR_MASK_t _nAttrMask;
+        LOGLVL_t _eLogLevel;
+    };
+
+    float _fLogThrottle = 0;          /// target rate. (messages/second) 0 = no limit.
+    INT64 _nTimeRate = 0;             /// cTimePerf ticks per event. 0 = no limit.
+    INT64 _nTimeBurst = 0;            /// how far ahead of now _nTimeTat may get. burst size.
+    INT64 VOLATILE _nTimeTat = 0;     /// theoretical arrival time of the next event. cTimePerf
+    INT64 _nTimeCoalesce = 0;         /// coalesce window in cTimePerf ticks. 0 = off.
+    cRepeat _aRepeats[k_nQtyRepeats];
+
+ private:
+    bool AllowRate() noexcept;
+
+ public:
+    LOGLVL_t _eLevelNoLimit = LOGLVL_t::_ERROR;  /// events at or above this level are never rate limited. (still coalesced)
+    cInterlockedUInt _nQtyPassed;                /// events allowed.
+    cInterlockedUInt _nQtyDropped;               /// events dropped by the rate limit.
+    cInterlockedUInt _nQtyCoalesced;             /// events counted as repeats and not sent.
 
+ public:
     cLogThrottle() noexcept;
 
     /// <summary>
-    /// Get throttle target as messages/sec
+    /// Get throttle target as messages/sec. 0 = no limit.
     /// </summary>
-    /// <returns></returns>
     float get_LogThrottle() const noexcept {
         return _fLogThrottle;
     }
+    /// <summary>
+    /// Set the rate limit. Call before use. Not thread safe.
+    /// </summary>
+    /// <param name="fPerSec">messages/sec. 0 = no limit.</param>
+    /// <param name="nBurst">allow this many at once. 0 = 1 second worth.</param>
+    void put_LogThrottle(float fPerSec, UINT nBurst = 0) noexcept;
+
+    /// <summary>
+    /// Set the coalesce window. Call before use. Not thread safe.
+    /// </summary>
+    /// <param name="nTimeMS">0 = off.</param>
+    void put_CoalesceTime(TIMESYSD_t nTimeMS) noexcept;
+
+    bool isActive() const noexcept {
+        return _nTimeRate != 0 || _nTimeCoalesce != 0;
+    }
+
+    /// <summary>
+    /// Should this event be sent? Any thread. O(1). No locks.
+    /// </summary>
+    /// <param name="rnRepeats">send a summary of this many repeats (MakeRepeatEvent) before this event.</param>
+    /// <returns>false = drop or coalesce it.</returns>
+    bool CheckEvent(const cLogEvent& rEvent, OUT UINT& rnRepeats) noexcept;
+
+    /// <summary>
+    /// Take a repeat summary that has not been sent yet. for FlushLogs()
+    /// </summary>
+    /// <param name="i">start at 0. iterator.</param>
+    /// <returns>nullptr = no more.</returns>
+    cRefPtr<cLogEvent> TakeRepeatEvent(ITERATE_t& i);
+
+    static cRefPtr<cLogEvent> GRAYCALL MakeRepeatEvent(LOG_ATTR_MASK_t uAttrMask, LOGLVL_t eLogLevel, const char* pszSubject, const LOGCHAR_t* pszFormat, UINT nRepeats);
 };
 
 //***********************************************************************
@@ -189,9 +254,17 @@ struct GRAYCORE_LINK cLogProcessor : public ILogProcessor, public ITextWriter {
     /// <returns>-lt- 0 = failed, 0=not processed by anyone</returns>
     HRESULT addEventS(LOG_ATTR_MASK_t uAttrMask, LOGLVL_t eLogLevel, cStringL sMsg) noexcept;
 
+    /// <summary>
+    /// Dispatch the event. Formatting is deferred (StrFormatArgs) until a sink wants the text.
+    /// @note pszFormat MUST be static (a literal). It may be rendered later on another thread.
+    /// </summary>
     HRESULT addEventV(LOG_ATTR_MASK_t uAttrMask, LOGLVL_t eLogLevel, const LOGCHAR_t* pszFormat, ::va_list vargs) noexcept;
+    /// <summary>
+    /// Dispatch the event. Format it now. Use this if pszFormat is NOT static. e.g. a cString or stack buffer.
+    /// </summary>
+    HRESULT addEventVNow(LOG_ATTR_MASK_t uAttrMask, LOGLVL_t eLogLevel, const LOGCHAR_t* pszFormat, ::va_list vargs) noexcept;
 
-    // Variadic helpers.
+    // Variadic helpers. Formatting is deferred. pszFormat MUST be static (a literal). else use addEventNowF().
     HRESULT _cdecl addEventF(LOG_ATTR_MASK_t uAttrMask, LOGLVL_t eLogLevel, const LOGCHAR_t* pszFormat, ...) noexcept {
         ::va_list vargs;
         va_start(vargs, pszFormat);
@@ -200,7 +273,19 @@ struct GRAYCORE_LINK cLogProcessor : public ILogProcessor, public ITextWriter {
         return hRes;
     }
 
+    /// <summary>
+    /// Same as addEventF() but format now. pszFormat need not be static.
+    /// </summary>
+    HRESULT _cdecl addEventNowF(LOG_ATTR_MASK_t uAttrMask, LOGLVL_t eLogLevel, const LOGCHAR_t* pszFormat, ...) noexcept {
+        ::va_list vargs;
+        va_start(vargs, pszFormat);
+        const HRESULT hRes = addEventVNow(uAttrMask, eLogLevel, pszFormat, vargs);
+        va_end(vargs);
+        return hRes;
+    }
+
     HRESULT _cdecl addInfoF(const LOGCHAR_t* pszFormat, ...) {
+        //! @note pszFormat MUST be static. formatting is deferred.
         //! @return <0 = failed, 0=not processed by anyone, # = number of processors.
         ::va_list vargs;
         va_start(vargs, pszFormat);
@@ -211,6 +296,7 @@ struct GRAYCORE_LINK cLogProcessor : public ILogProcessor, public ITextWriter {
 
     HRESULT _cdecl addDebugErrorF(const LOGCHAR_t* pszFormat, ...) {
         //! Add message with LOG_ATTR_DEBUG
+        //! @note pszFormat MUST be static. formatting is deferred.
         //! @return <0 = failed, 0=not processed by anyone, # = number of processors.
         ::va_list vargs;
         va_start(vargs, pszFormat);
@@ -219,6 +305,7 @@ struct GRAYCORE_LINK cLogProcessor : public ILogProcessor, public ITextWriter {
         return hRes;
     }
     HRESULT _cdecl addDebugWarnF(const LOGCHAR_t* pszFormat, ...) {
+        //! @note pszFormat MUST be static. formatting is deferred.
         ::va_list vargs;
         va_start(vargs, pszFormat);
         const HRESULT hRes = addEventV(LOG_ATTR_DEBUG, LOGLVL_t::_WARN, pszFormat, vargs);
@@ -226,6 +313,7 @@ struct GRAYCORE_LINK cLogProcessor : public ILogProcessor, public ITextWriter {
         return hRes;
     }
     HRESULT _cdecl addDebugInfoF(const LOGCHAR_t* pszFormat, ...) {
+        //! @note pszFormat MUST be static. formatting is deferred.
         ::va_list vargs;
         va_start(vargs, pszFormat);
         const HRESULT hRes = addEventV(LOG_ATTR_DEBUG, LOGLVL_t::_INFO, pszFormat, vargs);
@@ -233,6 +321,7 @@ struct GRAYCORE_LINK cLogProcessor : public ILogProcessor, public ITextWriter {
         return hRes;
     }
     HRESULT _cdecl addDebugTraceF(const LOGCHAR_t* pszFormat, ...) {
+        //! @note pszFormat MUST be static. formatting is deferred.
         ::va_list vargs;
         va_start(vargs, pszFormat);
         const HRESULT hRes = addEventV(LOG_ATTR_DEBUG, LOGLVL_t::_TRACE, pszFormat, vargs);
@@ -254,6 +343,8 @@ struct GRAYCORE_LINK cLogProcessor : public ILogProcessor, public ITextWriter {
 struct GRAYCORE_LINK cLogSink : public ::IUnknown, public cLogProcessor {
     friend class cLogNexus;
 
+    cLogThrottle _Throttle;  /// optional rate limit and coalesce just for this sink. default = off.
+
     /// <summary>
     /// Remove myself from the list of valid sink in cLogMgr.
     /// will descend into child cLogNexus as well.
@@ -276,12 +367,70 @@ class GRAYCORE_LINK cLogSinkDebug : public cLogSink, public cRefBase {
 };
 
 /// <summary>
-/// @todo Append (or cache) detailed messages here and hold them until some error triggers them.
-/// Once some error triggers, then we can emit all these detail messages to some file for processing.
-/// If no trigger occurs in time then trash these messages.
+/// Flight recorder. Cache detailed messages here and hold them until some error triggers them.
+/// Each thread writes into its own fixed size ring of events. No locks. Oldest are overwritten.
+/// Once an event -ge- _eLevelTrigger arrives, all rings are merged by time and sent to _pSinkOut followed by the trigger event.
+/// If no trigger occurs in time (_nCacheHold) then trash these messages.
+/// @note _pSinkOut is normally NOT also attached to the cLogNexus. else it sees the trigger twice.
 /// </summary>
 class GRAYCORE_LINK cLogSinkCache : public cLogSink, public cRefBase {
-    TIMESYS_t _nCacheHold;  /// How long to hold messages. toss detail messages if nothing special happens.
+ public:
+    static const ITERATE_t k_nQtyRingDef = 1024;  /// default events per thread ring.
+
+ private:
+    struct cSlot {
+        UINT_PTR VOLATILE _nEvent;  /// cLogEvent* with a reference held. 0 = empty. swap in/out with Interlocked.
+        TIMEPERF_t _nTime;          /// when cached.
+    };
+
+    /// <summary>
+    /// Ring of events for a single thread. Only the owner thread writes. Dump takes slots with Interlocked Exchange.
+    /// Held by the cLogSinkCache and by its thread. Given to a new thread after its thread exits.
+    /// </summary>
+    struct cRing : public cRefBase {
+        const UINT _nCacheId;           /// the cLogSinkCache this is for.
+        const ITERATE_t _nMask;         /// slot qty - 1. power of 2.
+        ITERATE_t _nWritePos = 0;       /// owner thread only.
+        INTER32_t VOLATILE _nFree = 0;  /// 1 = owner thread exited. take with CompareExchange under _Lock.
+        cSlot* _pSlots;
+
+        cRing(UINT nCacheId, ITERATE_t nQty);
+        ~cRing() override;
+        void Add(cLogEvent* pEvent, TIMEPERF_t nTime) noexcept;
+    };
+    friend struct cLogSinkCacheRingCur;
+    friend struct cLogSinkCacheThread;
+
+    static cInterlockedUInt sm_nCacheIdLast;  /// make _nCacheId unique.
+    const UINT _nCacheId;                     /// so threads can tell if their cached ring is still for me.
+    const ITERATE_t _nQtyRing;
+    mutable cThreadLockableX _Lock;  /// protect _aRings (add/remove) and serialize dumps. NOT used to cache events.
+    cArrayRef<cRing> _aRings;        /// all thread rings. live and free.
+
+ private:
+    cRing* GetRingCurrent();
+    void DumpRings();
+
+ public:
+    TIMESYS_t _nCacheHold = 10 * cTimeSys::k_FREQ;  /// How long to hold messages. toss detail messages if nothing special happens.
+    LOGLVL_t _eLevelTrigger = LOGLVL_t::_ERROR;     /// events at or above this level dump the cache.
+    cIUnkPtr<cLogSink> _pSinkOut;                   /// where do the dumped events go ?
+
+ public:
+    /// <param name="pSinkOut">downstream sink for dumped events.</param>
+    /// <param name="nQtyRing">events per thread. rounded up to a power of 2.</param>
+    cLogSinkCache(cLogSink* pSinkOut = nullptr, ITERATE_t nQtyRing = k_nQtyRingDef);
+    ~cLogSinkCache() override;
+
+    /// <summary>
+    /// Trash all cached events.
+    /// </summary>
+    void ClearCache();
+
+    HRESULT FlushLogs() override;
+    HRESULT addEvent(cLogEvent& rEvent) noexcept override;
+
+    IUNKNOWN_DISAMBIG(cRefBase)
 };
 }  // namespace Gray
 
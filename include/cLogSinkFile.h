@@ -0,0 +1,105 @@
+//! @file cLogSinkFile.h
+//! Log sink that writes to rotating files.
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+
+#ifndef _INC_cLogSinkFile_H
+#define _INC_cLogSinkFile_H
+#ifndef NO_PRAGMA_ONCE
+#pragma once
+#endif
+
+#include "cBlob.h"
+#include "cFile.h"
+#include "cLogSink.h"
+#include "cTimeInt.h"
+#include "cTimeSys.h"
+
+namespace Gray {
+/// <summary>
+/// How hard should cLogSinkFile try to get events onto the disk? (not just the OS cache)
+/// </summary>
+enum class LOG_DURABLE_t : BYTE {
+    _None = 0,  /// just write(). leave the rest to the OS. fastest.
+    _Group,     /// fsync() at most every _nSyncInterval and when idle. many events share one fsync. (group commit)
+    _Error,     /// like _Group but an event -ge- LOGLVL_t::_ERROR is written and fsync() before addEvent returns.
+};
+
+/// <summary>
+/// Append formatted log events to a file. like cLogFileDay.
+/// Events are formatted into a big memory buffer and written with a single WriteX() per batch.
+/// The buffer is written when full, when it gets older than _nFlushDelay, on FlushLogs() or when the async writer (cLogNexusAsync) goes idle.
+/// Rotate to a new file by size and/or time. File names are [Prefix]YYYYMMDD_HHMMSS[_N].log in local time.
+/// @note Without cLogNexus::StartAsync() or FlushLogs() the tail of the buffer may wait for the next event.
+/// </summary>
+class GRAYCORE_LINK cLogSinkFile : public cLogSink, public cRefBase {
+ public:
+    static const size_t k_nSizeBufDef = 256 * 1024;  /// default buffer size.
+
+    STREAM_POS_t _nRotateSize = 64 * 1024 * 1024;            /// Start a new file when this big. 0 = never.
+    TIMESECD_t _nRotateTime = cTimeUnits::k_nSecondsPerDay;  /// Start a new file on this period boundary (UTC). 0 = never.
+    TIMESYSD_t _nFlushDelay = cTimeSys::k_FREQ;              /// max age of buffered events before they are written.
+    TIMESYSD_t _nSyncInterval = cTimeSys::k_FREQ;            /// LOG_DURABLE_t::_Group. max time between fsync() while busy.
+
+ private:
+    mutable cThreadLockableX _Lock;  /// multiple threads may add events. (unless async)
+    const cStringF _sDir;            /// folder for the files.
+    const cStringF _sPrefix;         /// file name prefix.
+    const LOG_DURABLE_t _eDurable;
+    cFile _File;                     /// current file. may be closed = open on next write.
+    cBlob _Buf;                      /// formatted events not yet written.
+    size_t _nBufUsed = 0;            /// bytes used in _Buf.
+    STREAM_POS_t _nFileSize = 0;     /// size of the current file.
+    TIMESEC_t _nFileTime = 0;        /// _nRotateTime period of the current file.
+    cStringF _sFileTitleLast;        /// time part of the last file name.
+    UINT _nFileSeq = 0;              /// files opened with the same _sFileTitleLast.
+    cTimeSys _tBufFirst;             /// when the oldest event in _Buf was added.
+    cTimeSys _tSyncLast;             /// when did we last fsync().
+    bool _isSyncNeeded = false;      /// something was written since the last fsync().
+
+ private:
+    HRESULT OpenFileNew();
+    HRESULT WriteFile(const cMemSpan& m);
+    HRESULT AddBuf(const cMemSpan& m);
+    HRESULT WriteBuf(bool bSync);
+
+ public:
+    /// <summary>
+    /// Make a file sink. Attach with cLogNexus::AddSink().
+    /// </summary>
+    /// <param name="pszDir">folder for the log files.</param>
+    /// <param name="pszPrefix">file name prefix.</param>
+    /// <param name="eDurable">how hard to try to make sure events hit the disk.</param>
+    /// <param name="nSizeBuf">size of the write buffer.</param>
+    cLogSinkFile(const FILECHAR_t* pszDir, const FILECHAR_t* pszPrefix = _FN("Log"), LOG_DURABLE_t eDurable = LOG_DURABLE_t::_Group, size_t nSizeBuf = k_nSizeBufDef);
+    ~cLogSinkFile() override;
+
+    LOG_DURABLE_t get_Durable() const noexcept {
+        return _eDurable;
+    }
+    /// <summary>
+    /// Path of the current file. empty if not open yet.
+    /// </summary>
+    cStringF get_FilePath() const {
+        const auto guard(_Lock.Lock());
+        return _File.get_FilePath();
+    }
+
+    /// <summary>
+    /// Write all buffered events and close the current file. The next event opens a new one.
+    /// </summary>
+    void Close();
+
+    /// <summary>
+    /// Add raw text. no formatting.
+    /// </summary>
+    HRESULT WriteString(const LOGCHAR_t* pszMsg) override;
+    /// <summary>
+    /// Write everything buffered. fsync() unless LOG_DURABLE_t::_None.
+    /// </summary>
+    HRESULT FlushLogs() override;
+    HRESULT addEvent(cLogEvent& rEvent) noexcept override;
+
+    IUNKNOWN_DISAMBIG(cRefBase)
+};
+}  // namespace Gray
+#endif  // _INC_cLogSinkFile_H
@@ -12,6 +12,7 @@
 #include "cDebugAssert.h"  // ASSERT
 #include "cMemSpan.h"
 #include "cNonCopyable.h"
+#include "cSpan.h"
 #include "cStreamProgress.h"  // STREAM_OFFSET_t , STREAM_POS_t, SEEK_t
 #include "cTimeSys.h"         // TIMESYSD_t
 
@@ -21,6 +22,7 @@ static const HANDLE INVALID_HANDLE_VALUE = ((HANDLE)-1);  /// Invalid OS Handle.
 
 typedef void* HMODULE;  /// ::dlclose() is different for __linux__ than _WIN32
 typedef void* HINSTANCE;
+#include <sys/uio.h>  // readv()
 #endif
 
 namespace Gray {
@@ -185,6 +187,65 @@ class GRAYCORE_LINK cOSHandle : protected cNonCopyable {
         return CastN(HRESULT, nLengthRead);
     }
 
+    /// <summary>
+    /// Positional read. Does not move the file position. On __linux__ it doesn't use it either. So many threads can read the same handle.
+    /// @note _WIN32 OVERLAPPED on a synchronous handle moves the file position. So put it back. NOT safe for many threads.
+    /// </summary>
+    /// <returns>-lt- 0 = error. 0 = EOF. else length read.</returns>
+    HRESULT ReadAt(cMemSpan ret, STREAM_POS_t nPos) const noexcept {
+        if (ret.isEmpty()) return S_OK;
+#ifdef _WIN32
+        const STREAM_POS_t nPosPrev = SeekRaw(0, SEEK_t::_Cur);
+        ::OVERLAPPED ov;
+        cMem::Zero(&ov, sizeof(ov));
+        ov.Offset = CastN(DWORD, nPos);
+        ov.OffsetHigh = CastN(DWORD, CastN(UINT64, nPos) >> 32);
+        DWORD nLengthRead = 0;
+        const HRESULT hRes = ::ReadFile(_h, ret.get_BytePtrW(), CastN(DWORD, ret.get_SizeBytes()), &nLengthRead, &ov) ? S_OK : HResult::GetLastDef(HRESULT_WIN32_C(ERROR_READ_FAULT));
+        if (nPosPrev != k_STREAM_POS_ERR) SeekRaw(CastN(STREAM_OFFSET_t, nPosPrev), SEEK_t::_Set);
+        if (FAILED(hRes)) return (hRes == HRESULT_WIN32_C(ERROR_HANDLE_EOF)) ? 0 : hRes;
+#elif defined(__linux__)
+        const ssize_t nLengthRead = ::pread(_h, ret.get_BytePtrW(), ret.get_SizeBytes(), CastN(off_t, nPos));
+        if (nLengthRead < 0) return HResult::GetLastDef(HRESULT_WIN32_C(ERROR_READ_FAULT));
+#endif
+        return CastN(HRESULT, nLengthRead);
+    }
+
+    /// <summary>
+    /// Positional write. Does not move the file position. On __linux__ it doesn't use it either.
+    /// @note _WIN32 OVERLAPPED on a synchronous handle moves the file position. So put it back. NOT safe for many threads.
+    /// </summary>
+    /// <returns>-lt- 0 = error. else length written.</returns>
+    HRESULT WriteAt(const cMemSpan& m, STREAM_POS_t nPos) const noexcept {
+        if (m.isEmpty()) return S_OK;
+#ifdef _WIN32
+        const STREAM_POS_t nPosPrev = SeekRaw(0, SEEK_t::_Cur);
+        ::OVERLAPPED ov;
+        cMem::Zero(&ov, sizeof(ov));
+        ov.Offset = CastN(DWORD, nPos);
+        ov.OffsetHigh = CastN(DWORD, CastN(UINT64, nPos) >> 32);
+        DWORD nLengthWritten = 0;
+        const HRESULT hRes = ::WriteFile(_h, m.get_BytePtrC(), CastN(DWORD, m.get_SizeBytes()), &nLengthWritten, &ov) ? S_OK : HResult::GetLastDef(HRESULT_WIN32_C(ERROR_WRITE_FAULT));
+        if (nPosPrev != k_STREAM_POS_ERR) SeekRaw(CastN(STREAM_OFFSET_t, nPosPrev), SEEK_t::_Set);
+        if (FAILED(hRes)) return hRes;
+#elif defined(__linux__)
+        const ssize_t nLengthWritten = ::pwrite(_h, m.get_BytePtrC(), m.get_SizeBytes(), CastN(off_t, nPos));
+        if (nLengthWritten < 0) return HResult::GetLastDef(HRESULT_WIN32_C(ERROR_WRITE_FAULT));
+#endif
+        return CastN(HRESULT, nLengthWritten);
+    }
+
+    /// <summary>
+    /// Scatter read into many spans at the current file position. A single readv() on __linux__.
+    /// </summary>
+    /// <returns>-lt- 0 = error and nothing read. else total length read. less than all = EOF or a later error.</returns>
+    HRESULT ReadV(const cSpan<cMemSpan>& aRet) const noexcept;
+    /// <summary>
+    /// Gather write from many spans at the current file position. A single writev() on __linux__.
+    /// </summary>
+    /// <returns>-lt- 0 = error and nothing written. else total length written. may be partial.</returns>
+    HRESULT WriteV(const cSpan<cMemSpan>& aSrc) const noexcept;
+
     /// <summary>
     /// synchronous flush of write data to file.
     /// </summary>
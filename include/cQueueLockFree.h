@@ -0,0 +1,141 @@
+//! @file cQueueLockFree.h
+//! Bounded lock free queue for passing items between threads.
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+
+#ifndef _INC_cQueueLockFree_H
+#define _INC_cQueueLockFree_H
+#ifndef NO_PRAGMA_ONCE
+#pragma once
+#endif
+
+#include "cBits.h"
+#include "cHeap.h"
+#include "cInterlockedVal.h"
+#include "cNonCopyable.h"
+
+namespace Gray {
+/// <summary>
+/// Bounded lock free ring queue. Many writers (producers) and typically a single reader (consumer).
+/// Each slot has a sequence number that says if it is ready to be written or read for the current lap of the ring.
+/// Writers (and readers) claim a position with a single CompareExchange then fill the slot. No locks, no allocation after construct.
+/// Readers also claim positions so a writer may remove the oldest item to make room. (e.g. drop oldest)
+/// Positions are 32 bit and are allowed to wrap around.
+/// </summary>
+/// <typeparam name="TYPE">Element type. must be default constructible and assignable. e.g. cRefPtr.</typeparam>
+template <class TYPE>
+class cQueueLockFree : protected cNonCopyable {
+    typedef cQueueLockFree<TYPE> THIS_t;
+
+    struct cSlot {
+        INTER32_t VOLATILE _nSeq;  /// == position = ready to write. == position+1 = ready to read.
+        TYPE _Val;
+    };
+
+    cSlot* _pSlots;              /// _nMask+1 slots. power of 2.
+    const INTER32_t _nMask;      /// slot qty - 1.
+    BYTE _Pad0[64 - sizeof(cSlot*) - sizeof(INTER32_t)];
+    INTER32_t VOLATILE _nWritePos = 0;  /// next position to write. shared by all writers.
+    BYTE _Pad1[64 - sizeof(INTER32_t)];
+    INTER32_t VOLATILE _nReadPos = 0;  /// next position to read.
+    BYTE _Pad2[64 - sizeof(INTER32_t)];
+
+    static inline INTER32_t GetDiff(INTER32_t nSeq, INTER32_t nPos) noexcept {
+        return CastN(INTER32_t, CastN(UINT32, nSeq) - CastN(UINT32, nPos));  // allow wrap.
+    }
+
+ public:
+    /// <summary>
+    /// Allocate the ring.
+    /// </summary>
+    /// <param name="nQtyMax">rounded up to a power of 2.</param>
+    explicit cQueueLockFree(ITERATE_t nQtyMax) : _nMask(CastN(INTER32_t, (1U << cBits::Highest1Bit(CastN(UINT32, cValT::Max<ITERATE_t>(nQtyMax, 2) - 1))) - 1)) {
+        _pSlots = PtrCast<cSlot>(cHeap::AllocPtr(get_QtyMax() * sizeof(cSlot)));
+        for (INTER32_t i = 0; i <= _nMask; i++) {
+            ::new ((void*)&_pSlots[i]) cSlot{i, TYPE()};
+        }
+    }
+    ~cQueueLockFree() {
+        for (INTER32_t i = 0; i <= _nMask; i++) {
+            _pSlots[i].~cSlot();
+        }
+        cHeap::FreePtr(_pSlots);
+    }
+
+    ITERATE_t get_QtyMax() const noexcept {
+        return CastN(ITERATE_t, _nMask) + 1;
+    }
+
+    /// <summary>
+    /// Approximate number of items waiting. Other threads may change it at any time.
+    /// </summary>
+    ITERATE_t get_QtyApprox() const noexcept {
+        const INTER32_t nDiff = GetDiff(_nWritePos, _nReadPos);
+        return nDiff < 0 ? 0 : CastN(ITERATE_t, nDiff);
+    }
+    bool isEmptyApprox() const noexcept {
+        return _nWritePos == _nReadPos;
+    }
+
+    /// <summary>
+    /// Positions written (or being written) so far. Use as a ticket. compare with get_ReadPos().
+    /// </summary>
+    INTER32_t get_WritePos() const noexcept {
+        return _nWritePos;
+    }
+    INTER32_t get_ReadPos() const noexcept {
+        return _nReadPos;
+    }
+
+    /// <summary>
+    /// Add an item to the end. Never waits. Any thread.
+    /// </summary>
+    /// <returns>false = full.</returns>
+    bool TryPush(const TYPE& rVal) noexcept {
+        INTER32_t nPos = _nWritePos;
+        for (;;) {
+            cSlot& rSlot = _pSlots[nPos & _nMask];
+            const INTER32_t nDiff = GetDiff(rSlot._nSeq, nPos);
+            if (nDiff == 0) {
+                const INTER32_t nPosPrev = InterlockedN::CompareExchange(&_nWritePos, nPos + 1, nPos);
+                if (nPosPrev == nPos) {
+                    rSlot._Val = rVal;
+                    InterlockedN::Exchange(&rSlot._nSeq, nPos + 1);  // publish to the reader.
+                    return true;
+                }
+                nPos = nPosPrev;  // another writer got it.
+            } else if (nDiff < 0) {
+                return false;  // the reader has not freed this slot from the last lap. full.
+            } else {
+                nPos = _nWritePos;  // another writer got it.
+            }
+        }
+    }
+
+    /// <summary>
+    /// Remove the oldest item. Never waits. Any thread. (though normally just the single consumer)
+    /// </summary>
+    /// <returns>false = empty. (or the oldest item is still being written)</returns>
+    bool TryPop(OUT TYPE& rVal) noexcept {
+        INTER32_t nPos = _nReadPos;
+        for (;;) {
+            cSlot& rSlot = _pSlots[nPos & _nMask];
+            const INTER32_t nDiff = GetDiff(rSlot._nSeq, nPos + 1);
+            if (nDiff == 0) {
+                const INTER32_t nPosPrev = InterlockedN::CompareExchange(&_nReadPos, nPos + 1, nPos);
+                if (nPosPrev == nPos) {
+                    rVal = rSlot._Val;
+                    rSlot._Val = TYPE();
+                    InterlockedN::Exchange(&rSlot._nSeq, nPos + _nMask + 1);  // free for the next lap.
+                    return true;
+                }
+                nPos = nPosPrev;
+            } else if (nDiff < 0) {
+                return false;  // empty.
+            } else {
+                nPos = _nReadPos;
+            }
+        }
+    }
+};
+}  // namespace Gray
+#endif  // _INC_cQueueLockFree_H
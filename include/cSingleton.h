@@ -11,6 +11,7 @@
 
 #include "cDebugAssert.h"
 #include "cDependRegister.h"
+#include "cHeapArena.h"
 #include "cHeapObject.h"
 #include "cNonCopyable.h"
 #include "cObject.h"
@@ -188,16 +189,17 @@ class cSingleton : public cSingletonType<TYPE>, public cDependRegister, public c
     DECLARE_cHeapObject(TYPE);
 
 /// This MUST be declared in the HMODULE that we want associated with the singleton. the implementation of the class.
-/// Double Check Lock for multi threaded safety.  // Register only when fully constructed TYPE.
-#define cSingleton_IMPL(TYPE)                      \
-    TYPE* GRAYCALL TYPE::get_Single() noexcept {   \
-        if (!isSingleCreated()) {                  \
-            const auto guard(GetLockAll());   \
-            if (!isSingleCreated()) {              \
-                (new TYPE())->RegisterSingleton(); \
-            }                                      \
-        }                                          \
-        return cSingletonType<TYPE>::get_Single(); \
+/// Double Check Lock for multi threaded safety.  // Register only when fully constructed TYPE. Never in a cHeapArena.
+#define cSingleton_IMPL(TYPE)                             \
+    TYPE* GRAYCALL TYPE::get_Single() noexcept {          \
+        if (!isSingleCreated()) {                         \
+            const auto guard(GetLockAll());               \
+            if (!isSingleCreated()) {                     \
+                const cHeapArenaScope scopeHeap(nullptr); \
+                (new TYPE())->RegisterSingleton();        \
+            }                                             \
+        }                                                 \
+        return cSingletonType<TYPE>::get_Single();        \
     }
 }  // namespace Gray
 #endif  // _INC_cSingleton_H
@@ -64,7 +64,8 @@ struct GRAYCORE_LINK cStreamStats {
 /// </summary>
 struct GRAYCORE_LINK cStreamBase {
     static const BYTE k_SIZE_MASK = 0x80;                 /// Used for WriteSize(). 7 bits.
-    static const size_t k_FILE_BLOCK_SIZE = (32 * 1024);  /// default arbitrary transfer block size. more than this is NOT more efficient.
+    static const size_t k_FILE_BLOCK_SIZE = (32 * 1024);  /// default arbitrary transfer block size. WriteStream() may grow past this for big transfers.
+    static const size_t k_SIZE_PACKED_MAX = ((sizeof(size_t) * 8) + 6) / 7;  /// max bytes for a packed size. WriteSize()
 
     virtual ~cStreamBase() {}
 
@@ -145,6 +146,20 @@ struct GRAYCORE_LINK cStreamOutput : public cStreamBase, public ITextWriter {
         return hRes;
     }
 
+    /// <summary>
+    /// Write at a position. Does not move the current position. (if natively supported)
+    /// Default = SeekX() there, WriteX() and SeekX() back. NOT safe for many threads.
+    /// </summary>
+    /// <returns>Number of bytes written. -lt- 0 = error.</returns>
+    virtual HRESULT WriteAt(const cMemSpan& m, STREAM_POS_t nPos);
+
+    /// <summary>
+    /// Gather write many spans as one. A single call/syscall if natively supported.
+    /// Default = WriteX() each. Stops at the first partial write.
+    /// </summary>
+    /// <returns>Total bytes written. -lt- 0 = error and nothing written. An error after some data is written returns the partial total.</returns>
+    virtual HRESULT WriteV(const cSpan<cMemSpan>& aSrc);
+
     /// Write the base types directly. Host endian order.
     template <typename TYPE>
     HRESULT WriteT(TYPE val) {
@@ -160,6 +175,11 @@ struct GRAYCORE_LINK cStreamOutput : public cStreamBase, public ITextWriter {
     /// <param name="nSize"></param>
     /// <returns> -lt- 0 = error.</returns>
     HRESULT WriteSize(size_t nSize);
+    /// <summary>
+    /// Pack a size for WriteSize() into a buffer of at least k_SIZE_PACKED_MAX.
+    /// </summary>
+    /// <returns>bytes used.</returns>
+    static size_t GRAYCALL GetSizePacked(BYTE* pOut, size_t nSize) noexcept;
 
     HRESULT WriteHashCode(HASHCODE_t nHashCode) {
         //! opposite of ReadHashCode()
@@ -184,12 +204,7 @@ struct GRAYCORE_LINK cStreamOutput : public cStreamBase, public ITextWriter {
     /// <param name="pBuffer"></param>
     /// <param name="nSize"></param>
     /// <returns>-lt- 0 = error</returns>
-    HRESULT WriteBlob(const cMemSpan& b) {
-        const HRESULT hRes = WriteSize(b.get_SizeBytes());
-        if (FAILED(hRes)) return hRes;
-        if (b.isEmpty()) return S_OK;
-        return WriteSpan(b);
-    }
+    HRESULT WriteBlob(const cMemSpan& b);
 
     /// <summary>
     /// Write out a string with the length prefix. ReadBlobStr()
@@ -205,6 +220,8 @@ struct GRAYCORE_LINK cStreamOutput : public cStreamBase, public ITextWriter {
     /// <summary>
     /// Copy data from a read stream (stmIn) to this write stream.
     /// like the IStream::CopyTo() or MFC CopyFrom().
+    /// A large transfer with no nTimeout reads on a second thread while this writes. Block size adapts up to 4M.
+    /// On cancel or error sInp is left just after the data written. If it can't seek it may be up to 3 blocks (12M) past that.
     /// </summary>
     /// <param name="stmIn"></param>
     /// <param name="nSizeMax">Length of file or some arbitrary max to the stream size.</param>
@@ -277,6 +294,20 @@ struct GRAYCORE_LINK cStreamInput : public cStreamBase {
         if (hRes == CastN(HRESULT, ret.get_SizeBytes())) return hRes;  // OK
         return HRESULT_WIN32_C(ERROR_IO_INCOMPLETE);                   // maybe HRESULT_WIN32_C(ERROR_HANDLE_EOF) ? maybe SeekX back and try again ?
     }
+
+    /// <summary>
+    /// Read at a position. Does not move the current position. (if natively supported)
+    /// Default = SeekX() there, ReadX() and SeekX() back. NOT safe for many threads.
+    /// </summary>
+    /// <returns>Length read. -lt- 0 = error.</returns>
+    virtual HRESULT ReadAt(cMemSpan ret, STREAM_POS_t nPos) noexcept;
+
+    /// <summary>
+    /// Scatter read into many spans. A single call/syscall if natively supported.
+    /// Default = ReadX() each. Stops at the first partial read.
+    /// </summary>
+    /// <returns>Total length read. -lt- 0 = error and nothing read. An error after some data is read returns the partial total.</returns>
+    virtual HRESULT ReadV(const cSpan<cMemSpan>& aRet) noexcept;
     template <typename TYPE = BYTE>
     HRESULT ReadT(OUT TYPE& val) noexcept {
         return ReadSpan(TOSPANT(val));
@@ -370,6 +401,17 @@ struct GRAYCORE_LINK cStreamInput : public cStreamBase {
     }
 
     virtual HRESULT ReadPeek(cMemSpan ret) noexcept;
+
+    /// <summary>
+    /// Zero copy. Get a view of the data at the current read position without reading it. ReadX(nullptr) to skip over it after use.
+    /// Only valid till the next read or seek. Most streams can't do this.
+    /// </summary>
+    /// <param name="nSizeMin">try to get at least this much. may get less at EOF.</param>
+    /// <returns>empty = not supported or EOF.</returns>
+    virtual cMemSpan GetReadSpan(size_t nSizeMin = 1) noexcept {
+        UNREFERENCED_PARAMETER(nSizeMin);
+        return cMemSpan();
+    }
 };
 
 /// <summary>
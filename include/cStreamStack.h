@@ -47,6 +47,7 @@ class GRAYCORE_LINK cStreamStackOut : public cStreamQueue { // cStreamOutput, pr
     cStreamOutput* _pStreamOut;  /// End result output stream. called by WriteFlush()
  protected:
     HRESULT WriteFlush();
+    HRESULT WriteFlush(const cMemSpan& m);
  public:
     cStreamStackOut(cStreamOutput* pStreamOut = nullptr, size_t nSizeBuffer = cStream::k_FILE_BLOCK_SIZE) noexcept : cStreamQueue(8 * 1024, nSizeBuffer), _pStreamOut(pStreamOut) {}
     HRESULT WriteX(const cMemSpan& m) override = 0;  // cStreamOutput override calls WriteFlush() // MUST be overridden
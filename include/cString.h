@@ -93,13 +93,33 @@ class GRAYCORE_LINK cStringHeadT final : public cArrayHeadT<_TYPE_CH> {
         return this->_HashCode;
     }
 
+    /// <summary>
+    /// Invalidate the cached hash. ASSUME chars are about to change in place.
+    /// </summary>
+    void ClearHashCode() noexcept {
+        this->_HashCode = k_HASHCODE_CLEAR;
+    }
+    /// <summary>
+    /// Both hash codes are already cached and they differ ? Then the strings can't be equal (even ignoring case).
+    /// </summary>
+    bool IsHashCodeDiff(const THIS_t& other) const noexcept {
+        return this->IsHashCodeSet() && other.IsHashCodeSet() && this->_HashCode != other._HashCode;
+    }
+
     COMPARE_t CompareNoCase(const ATOMCHAR_t* pStr) const noexcept {
         return StrT::CmpIN(this->get_PtrConst(), pStr, get_CharCount() + 1);
     }
     bool IsEqualNoCase(const ATOMCHAR_t* pStr) const noexcept {
-        // TODO: Use HashCode for speed compares.
+        // No hash for a raw pointer. see IsEqualNoCase(const THIS_t&)
         return StrT::CmpIN(this->get_PtrConst(), pStr, get_CharCount() + 1) == COMPARE_Equal;
     }
+    bool IsEqualNoCase(const THIS_t& other) const noexcept {
+        if (this == &other) return true;
+        const StrLen_t iLen = get_CharCount();
+        if (iLen != other.get_CharCount()) return false;
+        if (IsHashCodeDiff(other)) return false;
+        return StrT::CmpIN(this->get_PtrConst(), other.get_PtrConst(), iLen) == COMPARE_Equal;
+    }
 
     // support for cAtomManager
     inline const _TYPE_CH* get_Name() const noexcept {
@@ -111,6 +131,8 @@ class GRAYCORE_LINK cStringHeadT final : public cArrayHeadT<_TYPE_CH> {
 /// Manage a reference counted pointer to cArrayHeadT _TYPE_CH. Is to a string array that is dynamically allocated.
 /// Mimic the MFC ATL::CStringT<> functionality.
 /// Unlike STL std::string this is shareable via reference count. No dynamic copied each time.
+/// Short strings (-lte- k_nInlineMax) are stored inline with no heap allocation. like STL SSO.
+/// @note No pointers into itself. so it may be moved/relocated as raw bytes in arrays.
 /// Use this for best string functionality.
 /// </summary>
 /// <typeparam name="_TYPE_CH">char or wchar_t</typeparam>
@@ -120,29 +142,55 @@ class GRAYCORE_LINK cStringT {
 
  protected:
     typedef cStringHeadT<_TYPE_CH> HEAD_t;
-    _TYPE_CH* _pchData;  /// points offset into HEAD_t/cStringHeadT[1] like cRefPtr<>. NOT a direct heap pointer!
+    static const StrLen_t k_nInlineSize = 24 / sizeof(_TYPE_CH);  /// inline storage chars. Last is the inline tag.
+
+ public:
+    static const StrLen_t k_nInlineMax = k_nInlineSize - 2;  /// Max chars (not including '\0') stored inline.
+
+ protected:
+    union {
+        _TYPE_CH* _pchData;                 /// Heap mode. points offset into HEAD_t/cStringHeadT[1] like cRefPtr<>. NOT a direct heap pointer! or &k_Nil
+        _TYPE_CH _aInline[k_nInlineSize];  /// Inline mode. chars and '\0'. [k_nInlineSize-1] = tag = length+1. tag 0 = heap mode.
+    };
 
  public:
     static const _TYPE_CH k_Nil;  /// '\0' Use this instead of nullptr. ala MFC. also like _afxDataNil. AKA cStrConst::k_Empty ?
 
  protected:
     void Init() noexcept {
+        _aInline[k_nInlineSize - 1] = '\0';  // heap mode.
         _pchData = const_cast<_TYPE_CH*>(&k_Nil);
     }
     void SetEmptyValid() noexcept {
         // ASSUME NOT k_Nil. Use k_Nil for empty.
         DEBUG_CHECK(isValidString());
-        get_Head()->DecRefCount();
+        if (!isInline()) get_Head()->DecRefCount();
         Init();
     }
 
     void AssignFirst(const THIS_t& s) noexcept {
-        _pchData = s._pchData;
-        if (IsEmpty()) return;
+        cMem::Copy(_aInline, s._aInline, sizeof(_aInline));  // all modes.
+        if (isInline() || IsEmpty()) return;
         get_Head()->IncRefCount();
         DEBUG_CHECK(isValidString());
     }
 
+    /// <summary>
+    /// Set the length of an inline string. Switch to inline mode. ASSUME chars already placed.
+    /// </summary>
+    void put_InlineLength(StrLen_t iLength) noexcept {
+        DEBUG_CHECK(iLength > 0 && iLength <= k_nInlineMax);
+        _aInline[iLength] = '\0';
+        _aInline[k_nInlineSize - 1] = CastN(_TYPE_CH, iLength + 1);
+    }
+
+    /// <summary>
+    /// Writable pointer to the chars. inline or heap.
+    /// </summary>
+    _TYPE_CH* get_PtrWork() noexcept {
+        return isInline() ? _aInline : _pchData;
+    }
+
     /// <summary>
     /// Dynamic allocate a buffer to hold the string. resize existing or create new.
     /// </summary>
@@ -190,7 +238,7 @@ class GRAYCORE_LINK cStringT {
     /// Move constructor
     /// </summary>
     cStringT(THIS_t&& ref) noexcept {
-        _pchData = ref._pchData;
+        cMem::Copy(_aInline, ref._aInline, sizeof(_aInline));
         ref.Init();
     }
     ~cStringT() {
@@ -199,9 +247,8 @@ class GRAYCORE_LINK cStringT {
 
     explicit cStringT(HEAD_t* pHead) noexcept {
         // Assign internal data object directly. weird usage.
-        if (pHead == nullptr) {
-            Init();
-        } else {
+        Init();
+        if (pHead != nullptr) {
             pHead->IncRefCount();
             _pchData = pHead->get_PtrWork();
         }
@@ -212,10 +259,20 @@ class GRAYCORE_LINK cStringT {
     /// Is this string 0 length? like MFC. _pchData should NEVER be nullptr !
     /// </summary>
     bool IsEmpty() const noexcept {
-        return _pchData == &k_Nil;
+        return !isInline() && _pchData == &k_Nil;
+    }
+    /// <summary>
+    /// Is this a short string stored inline ? no HEAD_t.
+    /// </summary>
+    bool isInline() const noexcept {
+        return _aInline[k_nInlineSize - 1] != '\0';
     }
 
     bool isValidString1() const noexcept {
+        if (isInline()) {
+            const StrLen_t iLen = CastN(StrLen_t, _aInline[k_nInlineSize - 1]) - 1;
+            return iLen > 0 && iLen <= k_nInlineMax && _aInline[iLen] == '\0';
+        }
         const HEAD_t* const pHead = get_Head();
         if (pHead == nullptr) return false;  // should never happen!
         return pHead->isValidString();
@@ -231,30 +288,32 @@ class GRAYCORE_LINK cStringT {
     }
     HASHCODE32_t get_HashCode() const noexcept {
         if (this->IsEmpty()) return 0;
+        if (isInline()) return StrT::GetHashCode32(get_SpanStr());  // short. not cached.
         return this->get_Head()->get_HashCode();
     }
     size_t CountHeapStats(OUT ITERATE_t& iAllocCount) const {
         //! Get data allocations for all children. does not include sizeof(*this)
-        if (this->IsEmpty()) return 0;
+        if (this->IsEmpty() || isInline()) return 0;
         return this->get_Head()->GetHeapStatsThis(iAllocCount);
     }
 
     /// <summary>
     /// Get my HEAD_t internal storage object pointer. like MFC
+    /// ASSUME NOT isInline()
     /// </summary>
     /// <returns>NEVER nullptr</returns>
     const HEAD_t* get_Head() const noexcept {
-        DEBUG_CHECK(!IsEmpty());
+        DEBUG_CHECK(!IsEmpty() && !isInline());
         return HEAD_t::Cvt(_pchData) - 1;  // the block before this pointer.
     }
     HEAD_t* get_Head() noexcept {
-        DEBUG_CHECK(!IsEmpty());
+        DEBUG_CHECK(!IsEmpty() && !isInline());
         return HEAD_t::Cvt(_pchData) - 1;  // the block before this pointer.
     }
     const _TYPE_CH* get_CPtr() const noexcept {
         //! like MFC. GetString
         DEBUG_CHECK(isValidString());
-        return _pchData;
+        return isInline() ? _aInline : _pchData;
     }
 
     /// <summary>
@@ -262,6 +321,7 @@ class GRAYCORE_LINK cStringT {
     /// </summary>
     /// <returns></returns>
     StrLen_t GetLength() const noexcept {
+        if (isInline()) return CastN(StrLen_t, _aInline[k_nInlineSize - 1]) - 1;
         if (this->IsEmpty()) return 0;
         const HEAD_t* pHead = get_Head();
         if (pHead == nullptr) {
@@ -275,6 +335,7 @@ class GRAYCORE_LINK cStringT {
     /// Get span NOT including space for '\0'
     /// </summary>
     cSpan<_TYPE_CH> get_SpanStr() const {
+        if (isInline()) return cSpan<_TYPE_CH>(_aInline, GetLength());
         if (this->IsEmpty()) return {};
         const HEAD_t* pHead = get_Head();
         if (pHead == nullptr) {
@@ -288,6 +349,7 @@ class GRAYCORE_LINK cStringT {
     /// Get span including space for '\0'
     /// </summary>
     cSpan<_TYPE_CH> get_SpanZ() const {
+        if (isInline()) return cSpan<_TYPE_CH>(_aInline, GetLength() + 1);
         if (this->IsEmpty()) return {};
         const HEAD_t* pHead = get_Head();
         if (pHead == nullptr) {
@@ -304,14 +366,14 @@ class GRAYCORE_LINK cStringT {
     /// <returns></returns>
     _TYPE_CH GetAt(StrLen_t nIndex) const {  // 0 based
         ASSERT(nIndex <= GetLength());       // allow to get the '\0' char
-        return _pchData[nIndex];
+        return get_CPtr()[nIndex];
     }
 
     /// <summary>
     /// AKA SetEmpty
     /// </summary>
     void Empty() noexcept {
-        if (_pchData == nullptr) return;  // certain off instances where it could be nullptr. arrays
+        if (!isInline() && _pchData == nullptr) return;  // certain off instances where it could be nullptr. arrays
         if (IsEmpty()) return;
         SetEmptyValid();
     }
@@ -325,7 +387,7 @@ class GRAYCORE_LINK cStringT {
     const _TYPE_CH& ReferenceAt(StrLen_t nIndex) const {  // 0 based
         // AKA ElementAt()
         ASSERT(nIndex <= GetLength());
-        return _pchData[nIndex];
+        return get_CPtr()[nIndex];
     }
 
     /// <summary>
@@ -336,7 +398,7 @@ class GRAYCORE_LINK cStringT {
     void SetAt(StrLen_t nIndex, _TYPE_CH ch) {
         ASSERT(IS_INDEX_GOOD(nIndex, GetLength()));
         CloneBeforeWrite();
-        _pchData[nIndex] = ch;
+        get_PtrWork()[nIndex] = ch;
         ASSERT(isValidString());
     }
 
@@ -361,9 +423,10 @@ class GRAYCORE_LINK cStringT {
     void ReleaseBuffer(StrLen_t nNewLength = k_StrLen_UNK);
 
     /// <summary>
-    /// expose internal ref count. ASSUME NOT _Nil ?
+    /// expose internal ref count. ASSUME NOT _Nil ? inline is always 1.
     /// </summary>
     REFCOUNT_t get_RefCount() const {
+        if (isInline()) return 1;
         return this->get_Head()->get_RefCount();
     }
 
@@ -378,8 +441,11 @@ class GRAYCORE_LINK cStringT {
     /// Move assignment
     /// </summary>
     const THIS_t& operator=(THIS_t&& ref) {
-        _pchData = ref._pchData;
-        ref.Init();
+        if (this != &ref) {
+            Empty();
+            cMem::Copy(_aInline, ref._aInline, sizeof(_aInline));
+            ref.Init();
+        }
         return *this;
     }
 
@@ -421,17 +487,43 @@ class GRAYCORE_LINK cStringT {
         return StrT::CmpI(get_CPtr(), pszStr);
     }
     bool IsEqualNoCase(const _TYPE_CH* pszStr) const noexcept {
-        // TODO: Use HashCode for speed compares.
+        // No hash for a raw pointer. see IsEqualNoCase(const THIS_t&)
         return StrT::CmpI(get_CPtr(), pszStr) == 0;
     }
 
+    /// <summary>
+    /// Fast equality. Same head = equal. Lengths differ or cached hash codes differ = not equal. Else compare chars.
+    /// </summary>
+    bool IsEqual(const THIS_t& str) const noexcept {
+        if (!isInline() && !str.isInline()) {
+            if (_pchData == str._pchData) return true;  // same head. or both empty.
+            if (IsEmpty() || str.IsEmpty()) return false;
+        }
+        const StrLen_t iLen = GetLength();
+        if (iLen != str.GetLength()) return false;
+        if (!isInline() && !str.isInline() && get_Head()->IsHashCodeDiff(*str.get_Head())) return false;
+        return cMem::IsEqual(get_CPtr(), str.get_CPtr(), iLen * sizeof(_TYPE_CH));
+    }
+    /// <summary>
+    /// Fast equality ignoring case. Uses the cached (case ignored) hash codes.
+    /// </summary>
+    bool IsEqualNoCase(const THIS_t& str) const noexcept {
+        if (!isInline() && !str.isInline()) {
+            if (_pchData == str._pchData) return true;
+            if (IsEmpty() || str.IsEmpty()) return false;
+        }
+        const StrLen_t iLen = GetLength();
+        if (iLen != str.GetLength()) return false;
+        if (!isInline() && !str.isInline() && get_Head()->IsHashCodeDiff(*str.get_Head())) return false;
+        return StrT::CmpIN(get_CPtr(), str.get_CPtr(), iLen) == COMPARE_Equal;
+    }
+
     bool isPrintableString() const noexcept {
         if (IsEmpty()) return true;
-        const HEAD_t* pHead = this->get_Head();
-        const StrLen_t iLen = pHead->get_CharCount();
-        ASSERT(pHead->IsValidInsideN(iLen * sizeof(_TYPE_CH)));
-        ASSERT(pHead->get_RefCount() > 0);
-        return StrT::IsPrintable(_pchData, iLen) && (_pchData[iLen] == '\0');
+        ASSERT(isValidString());
+        const StrLen_t iLen = GetLength();
+        const _TYPE_CH* pData = get_CPtr();
+        return StrT::IsPrintable(pData, iLen) && (pData[iLen] == '\0');
     }
     bool isValidCheck() const noexcept {
         return isValidString();
@@ -488,6 +580,12 @@ class GRAYCORE_LINK cStringT {
     friend bool operator!=(const THIS_t& str1, const _TYPE_CH* str2) noexcept {
         return str1.Compare(str2) != COMPARE_Equal;
     }
+    friend bool operator==(const THIS_t& str1, const THIS_t& str2) noexcept {
+        return str1.IsEqual(str2);
+    }
+    friend bool operator!=(const THIS_t& str1, const THIS_t& str2) noexcept {
+        return !str1.IsEqual(str2);
+    }
 
     // insert character at zero-based index; concatenates
     // if index is past end of string
@@ -512,7 +610,7 @@ class GRAYCORE_LINK cStringT {
     }
 
     void Assign(const THIS_t& str) {
-        if (_pchData == str.get_CPtr()) return;  // already same.
+        if (get_CPtr() == str.get_CPtr()) return;  // already same.
         Empty();
         AssignFirst(str);
     }
@@ -540,6 +638,7 @@ class GRAYCORE_LINK cStringT {
     /// Make this string permanent. never removed from memory.
     /// </summary>
     void SetStringStatic() {
+        if (isInline()) return;           // no heap to keep.
         this->get_Head()->IncRefCount();  // never release this ref. k_REFCOUNT_STATIC ?
     }
 
@@ -617,10 +716,61 @@ class GRAYCORE_LINK cStringT {
 
 //***********************************************************************************************************
 
+/// <summary>
+/// Immutable string key with its (case ignored) hash code computed once. Even for inline strings that have no head to cache it.
+/// cHashTableName takes it as a key and picks the bucket from the cached hash. get_HashCode() for other hash keyed tables.
+/// cArraySortString is alpha sorted. A hash can't order it, so it just uses the const _TYPE_CH* conversion.
+/// </summary>
+/// <typeparam name="_TYPE_CH">char or wchar_t</typeparam>
+template <typename _TYPE_CH = char>
+class cStringHashedT : protected cStringT<_TYPE_CH> {
+    typedef cStringT<_TYPE_CH> SUPER_t;
+    typedef cStringHashedT<_TYPE_CH> THIS_t;
+    HASHCODE32_t _nHashCode;  /// SUPER_t::get_HashCode() computed once.
+
+ public:
+    cStringHashedT() noexcept : _nHashCode(k_HASHCODE_CLEAR) {}
+    cStringHashedT(const SUPER_t& str) noexcept : SUPER_t(str), _nHashCode(str.get_HashCode()) {}
+    cStringHashedT(const _TYPE_CH* pszStr) : SUPER_t(pszStr), _nHashCode(SUPER_t::get_HashCode()) {}
+    cStringHashedT(const cSpan<_TYPE_CH>& src) : SUPER_t(src), _nHashCode(SUPER_t::get_HashCode()) {}
+
+    using SUPER_t::get_CPtr;
+    using SUPER_t::get_SpanStr;
+    using SUPER_t::GetLength;
+    using SUPER_t::IsEmpty;
+    using SUPER_t::operator const _TYPE_CH*;
+
+    HASHCODE32_t get_HashCode() const noexcept {
+        return _nHashCode;
+    }
+    const SUPER_t& get_Str() const noexcept {
+        return *this;
+    }
+
+    bool IsEqual(const THIS_t& str) const noexcept {
+        if (_nHashCode != str._nHashCode) return false;
+        return SUPER_t::IsEqual(str);
+    }
+    bool IsEqualNoCase(const THIS_t& str) const noexcept {
+        if (_nHashCode != str._nHashCode) return false;
+        return SUPER_t::IsEqualNoCase(str);
+    }
+    bool IsEqualNoCase(const _TYPE_CH* pszStr) const noexcept {
+        return SUPER_t::IsEqualNoCase(pszStr);
+    }
+    // No operator==. It would compete with the const _TYPE_CH* conversion and the implicit constructors. Use IsEqual().
+};
+
+//***********************************************************************************************************
+
 typedef cStringT<wchar_t> cStringW;
 typedef cStringT<char> cStringA;
 typedef cStringT<GChar_t> cString;
 
+typedef cStringHashedT<wchar_t> cStringHashedW;
+typedef cStringHashedT<char> cStringHashedA;
+typedef cStringHashedT<GChar_t> cStringHashed;
+
 #if !defined(_MFC_VER) && !defined(__CLR_VER)
 typedef cString CString;
 #endif
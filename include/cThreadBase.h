@@ -14,6 +14,10 @@
 #endif
 #ifdef __linux__
 #include <pthread.h>
+#include <sched.h>  // sched_yield()
+#endif
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>  // _mm_pause()
 #endif
 
 namespace Gray {
@@ -127,6 +131,30 @@ class GRAYCORE_LINK cThreadId {
         ::Sleep(static_cast<DWORD>(uMs));
 #else
         ::usleep((uMs)*1000);       // Sleep current thread.
+#endif
+    }
+
+    /// <summary>
+    /// Hint to the CPU that we are in a spin wait loop. Does NOT give up the time slice.
+    /// </summary>
+    static inline void PauseCurrent() noexcept {
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+        ::_mm_pause();
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+        __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+
+    /// <summary>
+    /// Give the rest of my time slice to some other ready thread. Returns right away if there is none.
+    /// </summary>
+    static inline void YieldCurrent() noexcept {
+#ifdef _WIN32
+        ::SwitchToThread();
+#else
+        ::sched_yield();
 #endif
     }
 };
@@ -26,8 +26,14 @@ namespace Gray {
 /// use with cLockerT
 /// </summary>
 class GRAYCORE_LINK cThreadLockable : public cLockableBase, protected cNonCopyable {
+ public:
+    static const int k_nSpinPause = 64;  /// Spin this many times with PauseCurrent() on collision.
+    static const int k_nSpinYield = 8;   /// Then YieldCurrent() this many times before we park the thread.
+
  protected:
     THREADID_t __DECL_ALIGN(_SIZEOF_THREADID) _ThreadLockOwner;  /// The thread that has the lock. cThreadId:k_NULL is not locked (or locker thread is not relevant).
+    INTER32_t VOLATILE _nWaiters = 0;  /// Threads parked (or about to park) waiting for _ThreadLockOwner to clear.
+    INTER32_t VOLATILE _nWakeSeq = 0;  /// Bumped for each wake. Parked threads sleep until this changes. futex word.
 
  protected:
     inline void ClearThreadLockOwner() {
@@ -35,13 +41,39 @@ class GRAYCORE_LINK cThreadLockable : public cLockableBase, protected cNonCopyab
         InterlockedN::Exchange(&_ThreadLockOwner, cThreadId::k_NULL);
     }
 
+    /// <summary>
+    /// Take ownership if the lock is free or owned by nTid. Never waits.
+    /// </summary>
+    inline bool LockThreadTry(const THREADID_t nTid) noexcept {
+        const THREADID_t nTidOwnerPrev = InterlockedN::CompareExchange(&_ThreadLockOwner, nTid, cThreadId::k_NULL);
+        if (nTidOwnerPrev != cThreadId::k_NULL && !cThreadId::IsEqualId(nTidOwnerPrev, nTid)) return false;  // Some other thread owns the lock.
+        IncLockCount();  // i got it. (or already had it)
+        return true;
+    }
+
+    /// <summary>
+    /// Park the current thread until WakeThread() or nWaitMS. Spurious wakes are allowed.
+    /// </summary>
+    inline void ParkThread(INTER32_t nWakeSeq, TIMESYSD_t nWaitMS) noexcept {
+        ParkAddr(&_nWakeSeq, nWakeSeq, nWaitMS);
+    }
+    /// <summary>
+    /// Wake one parked thread.
+    /// </summary>
+    inline void WakeThread() noexcept {
+        WakeAddr(&_nWakeSeq);
+    }
+
     /// ASSUME i own the lock and can do this.
     inline void UnlockThread() {
-        if (DecLockCount() == 0) ClearThreadLockOwner();
+        if (DecLockCount() != 0) return;
+        ClearThreadLockOwner();            // Interlocked so the _nWaiters read can't move before this.
+        if (_nWaiters != 0) WakeThread();  // Someone is parked. wake one.
     }
 
     /// <summary>
     /// Take ownership if the lock is free or owned by the calling thread
+    /// Adaptive: spin with pause, then yield, then park the thread (futex) until Unlock wakes one waiter.
     /// </summary>
     /// <param name="nWaitMS"></param>
     /// <returns></returns>
@@ -59,6 +91,15 @@ class GRAYCORE_LINK cThreadLockable : public cLockableBase, protected cNonCopyab
     cThreadLockable() noexcept : _ThreadLockOwner(cThreadId::k_NULL) {}
 
  public:
+    /// <summary>
+    /// Park the current thread until *pWakeSeq != nWakeSeq (and WakeAddr) or nWaitMS. Spurious wakes are allowed.
+    /// </summary>
+    static void GRAYCALL ParkAddr(INTER32_t VOLATILE* pWakeSeq, INTER32_t nWakeSeq, TIMESYSD_t nWaitMS) noexcept;
+    /// <summary>
+    /// Bump *pWakeSeq and wake one thread parked on it.
+    /// </summary>
+    static void GRAYCALL WakeAddr(INTER32_t VOLATILE* pWakeSeq) noexcept;
+
     /// <summary>
     /// What thread owns this lock? cThreadId::k_NULL = not locked.
     /// </summary>
@@ -101,13 +142,15 @@ class GRAYCORE_LINK cThreadLockable : public cLockableBase, protected cNonCopyab
     /// <returns></returns>
     bool ClearThreadLockOwner(THREADID_t nThreadId) {
         const THREADID_t nTidOwnerPrev = InterlockedN::CompareExchange(&_ThreadLockOwner, cThreadId::k_NULL, nThreadId);
-        return cThreadId::IsEqualId(nTidOwnerPrev, nThreadId);
+        if (!cThreadId::IsEqualId(nTidOwnerPrev, nThreadId)) return false;
+        if (_nWaiters != 0) WakeThread();
+        return true;
     }
 };
 
 /// <summary>
 /// Implement simple thread lockable mechanism. lock this for multi threaded access.
-/// These are fairly cheap and fast (if no collide). Slow on actual collision. (but collide assumed to be infrequent)
+/// These are fairly cheap and fast (if no collide). Collision spins briefly then parks the thread. (but collide assumed to be infrequent)
 /// @note reentrant, multi locks on a single thread are allowed and counted.
 /// </summary>
 struct GRAYCORE_LINK cThreadLockableFast : public cThreadLockable {
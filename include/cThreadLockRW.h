@@ -13,72 +13,123 @@
 
 namespace Gray {
 /// <summary>
-/// Read/Write thread locking mechanism.
-/// Only one thread may write lock something.
-/// @note multiple read locks may be released out of  order, i.e first read locker releases with other readers => unknown last read thread.
+/// Read/Write thread locking mechanism. Writer preferred.
+/// Only one thread may write lock something. Writers queue on the base cThreadLockableFast.
+/// Readers just bump a counter in their own cache line shard. They never touch a shared lock unless a writer is waiting.
+/// A waiting writer stops new readers (except threads already holding a read, to avoid deadlock) then waits for the shards to drain.
+/// @note multiple read locks may be released out of order, i.e first read locker releases with other readers => unknown last read thread.
+/// @note a thread holding a read lock must not Lock() for write. Use cThreadGuardRead::Upgrade().
 /// similar to : Linux thread locking pthread_rwlock_wrlock() or std::shared_mutex
 /// </summary>
 class GRAYCORE_LINK cThreadLockRW : public cThreadLockableFast {
     friend struct cThreadGuardRead;
     typedef cThreadLockableFast SUPER_t;
-    static const THREADID_t kReaderThreadId = 1;  // shared unique thread id for all readers.
-    cThreadLockableFast _ReaderLock;                 // Since this is shared with multiple threads it must be locked from itself.
+
+ public:
+    static const int kReaderShards = 8;  /// Spread reader counts to avoid cache line contention.
+    static const int kReaderDowngrade = -1;  /// LockRead() shard id for a read by the thread that holds the write lock.
+
+ private:
+    static const INTER32_t kWriterNone = 0;   /// No writer. Readers go.
+    static const INTER32_t kWriterWait = 1;   /// A writer owns the base lock and is waiting for readers to drain.
+    static const INTER32_t kWriterOwns = 2;   /// A writer has exclusive access.
+
+    /// <summary>
+    /// Count of readers. Padded to its own cache line.
+    /// </summary>
+    struct cReaderShard {
+        INTER32_t VOLATILE _nCount;
+        BYTE _Pad[64 - sizeof(INTER32_t)];
+    };
+
+    cReaderShard _aReaders[kReaderShards];  /// Active readers.
+    INTER32_t VOLATILE _nWriterState = kWriterNone;  /// kWriterNone, kWriterWait, kWriterOwns.
+    INTER32_t VOLATILE _nDrainWaiting = 0;  /// A writer is parked on _nDrainSeq waiting for readers to leave.
+    INTER32_t VOLATILE _nDrainSeq = 0;      /// futex word for the parked writer.
+
+ private:
+    static int GRAYCALL GetReaderShard() noexcept;
+    bool WaitReaders(INTER32_t nReadersKeep, TIMESYSD_t nWaitMS) noexcept;
+    bool LockWrite(TIMESYSD_t nWaitMS) noexcept;
+    void UnlockReader(int iShard) noexcept;
+
     /// <summary>
     /// lock this for Read
     /// </summary>
-    inline void LockRead() noexcept {
-        if (this->isThreadLockedByCurrent()) {
-            // special case where i can allow this. downgrade.
-            SUPER_t::IncLockCount();
-            return;
-        }
-        auto guard(_ReaderLock.Lock());
-        LockThread(kReaderThreadId, cTimeSys::k_INF);
-        ASSERT(IsThreadLockOwner(kReaderThreadId));
-    }
+    /// <returns>the shard id to give back to UnlockRead()</returns>
+    int LockRead() noexcept;
 
     /// <summary>
     /// unlock this for Read
     /// </summary>
-    inline void UnlockRead() noexcept {
-        if (this->isThreadLockedByCurrent()) {
-            // special case where i can allow this. downgrade.
-            SUPER_t::Unlock();
-            return;
+    void UnlockRead(int iShard) noexcept;
+
+    /// <summary>
+    /// Trade my read lock (in iShard) for the write lock.
+    /// </summary>
+    bool UpgradeRead(int iShard) noexcept;
+
+ public:
+    cThreadLockRW() noexcept {
+        for (int i = 0; i < kReaderShards; i++) {
+            _aReaders[i]._nCount = 0;
         }
-        // we may not be the same real thread that locked this originally!
-        auto guard(_ReaderLock.Lock());
-        ASSERT(IsThreadLockOwner(kReaderThreadId));
-        UnlockThread();
     }
 
- public:
     int get_ReaderCount() const noexcept {
-        if (!IsThreadLockOwner(kReaderThreadId)) return 0;
-        return this->get_LockCount();
+        INTER32_t nCount = 0;
+        for (int i = 0; i < kReaderShards; i++) {
+            nCount += _aReaders[i]._nCount;
+        }
+        return nCount;
+    }
+
+    /// <summary>
+    /// Lock for Write. Wait for the current readers to leave. New readers wait for me.
+    /// Hides cThreadLockableFast::Lock()
+    /// </summary>
+    [[nodiscard]] cLockerT<cThreadLockableFast> Lock() noexcept {
+        LockWrite(cTimeSys::k_INF);
+        return cLockerT<cThreadLockableFast>(this, true);
+    }
+    [[nodiscard]] cLockerT<cThreadLockableFast> LockTry(TIMESYSD_t nWaitMS = 0) noexcept {
+        if (!LockWrite(nWaitMS)) return cLockerT<cThreadLockableFast>(nullptr, false);
+        return cLockerT<cThreadLockableFast>(this, true);
     }
+
+    /// <summary>
+    /// Release a Write lock. Let the readers go if this is the last.
+    /// </summary>
+    void Unlock() noexcept override;
 };
 
 /// <summary>
 /// I only want to read from this. Prevent writer from breaking me. Allow other concurrent readers.
-/// TODO: NOT upgradeable on the same thread to Write
+/// Upgradeable on the same thread to Write.
 /// </summary>
 struct cThreadGuardRead : public cPtrFacade<cThreadLockRW> {
     typedef cPtrFacade<cThreadLockRW> SUPER_t;
-    cThreadGuardRead(cThreadLockRW& rLock) : SUPER_t(&rLock) {
-        rLock.LockRead();
-    }
+    int _iShard;  /// from LockRead(). cThreadLockRW::kReaderDowngrade = i hold the write lock.
+
+    cThreadGuardRead(cThreadLockRW& rLock) : SUPER_t(&rLock), _iShard(rLock.LockRead()) {}
     ~cThreadGuardRead() {
         if (SUPER_t::isValidPtr()) {
-            SUPER_t::get_Ptr()->UnlockRead();
+            SUPER_t::get_Ptr()->UnlockRead(_iShard);
         }
     }
-    cLockerT<cThreadLockableFast> Upgrade() {
-        // TODO
-        if (SUPER_t::isValidPtr()) {
-            SUPER_t::get_Ptr()->UnlockRead();  // release my read first.
-        }
-        return SUPER_t::get_Ptr()->Lock();  // now get full access lock.
+
+    /// <summary>
+    /// Get the write lock on the same thread. I keep exclusive access till this guard ends (even if the write guard ends first).
+    /// If another writer got there first my read is released before i wait. so re-check what i read.
+    /// @note this must be the only read this thread holds on the lock.
+    /// </summary>
+    /// <param name="pbAtomic">set true if no other writer could have changed anything since my read started.</param>
+    cLockerT<cThreadLockableFast> Upgrade(bool* pbAtomic = nullptr) {
+        cThreadLockRW* pLock = SUPER_t::get_Ptr();
+        const bool bAtomic = pLock->UpgradeRead(_iShard);
+        _iShard = cThreadLockRW::kReaderDowngrade;  // my read is now held as a write.
+        if (pbAtomic != nullptr) *pbAtomic = bAtomic;
+        return cLockerT<cThreadLockableFast>(pLock, true);
     }
     /// <summary>
     /// return the cThreadLockRW as a const* ONLY!!
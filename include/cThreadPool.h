@@ -0,0 +1,205 @@
+//! @file cThreadPool.h
+//! Pool of worker threads that run small tasks. Work stealing.
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+
+#ifndef _INC_cThreadPool_H
+#define _INC_cThreadPool_H
+#ifndef NO_PRAGMA_ONCE
+#pragma once
+#endif
+
+#include "cArrayRef.h"
+#include "cInterlockedVal.h"
+#include "cNonCopyable.h"
+#include "cQueueLockFree.h"
+#include "cRefPtr.h"
+#include "cThreadBase.h"
+#include <type_traits>  // std::decay
+#include <utility>      // std::forward
+
+namespace Gray {
+class cThreadPool;
+class cThreadTaskGroup;
+
+/// <summary>
+/// A unit of work for cThreadPool. Reference counted. The pool holds a reference till RunTask() returns.
+/// RunTask() should not throw.
+/// </summary>
+class GRAYCORE_LINK cThreadTask : public cRefBase {
+    friend class cThreadPool;
+    friend class cThreadTaskGroup;
+    cThreadTaskGroup* _pGroup = nullptr;  /// signal this group when done. nullptr = none.
+
+ public:
+    virtual void RunTask() = 0;
+};
+
+/// <summary>
+/// cThreadTask that calls a function object. e.g. lambda.
+/// </summary>
+template <class FUNC>
+class cThreadTaskFunc final : public cThreadTask {
+    FUNC _Func;
+
+ public:
+    explicit cThreadTaskFunc(const FUNC& func) : _Func(func) {}
+    explicit cThreadTaskFunc(FUNC&& func) : _Func(std::move(func)) {}
+    void RunTask() override {
+        _Func();
+    }
+};
+
+/// <summary>
+/// A group of child tasks that a parent waits for. Stack based. Groups may nest. (a task may make its own group)
+/// Wait() helps run tasks while it waits. So a worker waiting on its children never blocks the pool.
+/// </summary>
+class GRAYCORE_LINK cThreadTaskGroup : protected cNonCopyable {
+    friend class cThreadPool;
+
+    cThreadPool& _rPool;
+    INTER32_t VOLATILE _nQtyPending = 0;  /// tasks submitted and not yet complete.
+    INTER32_t VOLATILE _nQtyWaking = 0;   /// completions still touching this. Wait() must not return till 0.
+    INTER32_t VOLATILE _nWakeSeq = 0;     /// park Wait() on this. cThreadLockable::ParkAddr()
+
+ private:
+    void CompleteTask() noexcept;
+
+ public:
+    explicit cThreadTaskGroup(cThreadPool& rPool) noexcept : _rPool(rPool) {}
+    ~cThreadTaskGroup() {
+        Wait();
+    }
+
+    bool isDone() const noexcept {
+        return _nQtyPending == 0 && _nQtyWaking == 0;
+    }
+
+    /// <summary>
+    /// Submit a child task for this group.
+    /// </summary>
+    void Run(cThreadTask* pTask);
+    template <class FUNC>
+    void RunFunc(FUNC&& func) {
+        Run(new cThreadTaskFunc<typename std::decay<FUNC>::type>(std::forward<FUNC>(func)));
+    }
+
+    /// <summary>
+    /// Run or wait for tasks till all in the group are complete.
+    /// </summary>
+    void Wait();
+};
+
+/// <summary>
+/// A pool worker thread. Owns a Chase-Lev work stealing deque.
+/// The owner pushes and pops at the bottom (LIFO). Other threads steal from the top (FIFO).
+/// Fixed size. The owner runs a task directly if its deque is full.
+/// </summary>
+class GRAYCORE_LINK cThreadPoolWorker final : public cThreadRef {
+    friend class cThreadPool;
+
+    cThreadPool& _rPool;
+    const ITERATE_t _iWorker;  /// my index in the pool.
+    const INTER32_t _nMask;    /// deque size - 1. power of 2.
+    cThreadTask** _ppTasks;    /// holds a reference on each task.
+    UINT32 _nRandom;           /// pick steal victims.
+    BYTE _Pad0[64];
+    INTER32_t VOLATILE _nTop = 0;  /// next to steal. shared.
+    BYTE _Pad1[64 - sizeof(INTER32_t)];
+    INTER32_t VOLATILE _nBottom = 0;  /// next to push. owner.
+    BYTE _Pad2[64 - sizeof(INTER32_t)];
+
+ private:
+    bool PushTask(cThreadTask* pTask) noexcept;
+    cThreadTask* PopTask() noexcept;
+    cThreadTask* StealTask() noexcept;
+    static inline INTER32_t GetDiff(INTER32_t nBottom, INTER32_t nTop) noexcept {
+        return CastN(INTER32_t, CastN(UINT32, nBottom) - CastN(UINT32, nTop));  // allow wrap.
+    }
+    bool isEmptyApprox() const noexcept {
+        return GetDiff(_nBottom, _nTop) <= 0;
+    }
+
+ protected:
+    THREAD_EXITCODE_t Run() override;
+
+ public:
+    cThreadPoolWorker(cThreadPool& rPool, ITERATE_t iWorker, ITERATE_t nQtyTasks);
+    ~cThreadPoolWorker() override;
+};
+
+/// <summary>
+/// Pool of worker threads that run cThreadTask. Work stealing so busy workers share load with idle ones.
+/// Tasks submitted from a worker go to its own deque. Tasks from other threads go to a shared lock free queue.
+/// Idle workers spin a bit then park. (futex)
+/// </summary>
+class GRAYCORE_LINK cThreadPool : protected cNonCopyable {
+    friend class cThreadPoolWorker;
+    friend class cThreadTaskGroup;
+
+ public:
+    static const ITERATE_t k_nQtyTasksDef = 4096;  /// default deque size per worker and shared queue size.
+
+ private:
+    cArrayRef<cThreadPoolWorker> _aWorkers;
+    cQueueLockFree<cThreadTask*> _Inject;  /// tasks submitted from threads not in this pool.
+    INTER32_t VOLATILE _nQtyIdle = 0;      /// workers parked (or about to park).
+    INTER32_t VOLATILE _nWakeSeq = 0;      /// park idle workers on this. cThreadLockable::ParkAddr()
+    bool _bAffinity = false;               /// pin worker i to CPU i.
+
+ private:
+    cThreadPoolWorker* get_WorkerCurrent() const noexcept;
+    cThreadTask* FindTask(cThreadPoolWorker* pWorker) noexcept;
+    void RunTaskX(cThreadTask* pTask) noexcept;
+    void SubmitX(cThreadTask* pTask);
+
+ public:
+    explicit cThreadPool(ITERATE_t nQtyTasks = k_nQtyTasksDef) : _Inject(nQtyTasks) {}
+    ~cThreadPool();
+
+    ITERATE_t get_WorkerCount() const noexcept {
+        return _aWorkers.GetSize();
+    }
+
+    /// <summary>
+    /// Create the worker threads.
+    /// </summary>
+    /// <param name="nWorkers">0 = cSystemInfo::get_NumberOfProcessors()</param>
+    /// <param name="bAffinity">pin each worker to its own CPU.</param>
+    HRESULT StartWorkers(ITERATE_t nWorkers = 0, bool bAffinity = false);
+    /// <summary>
+    /// Stop and wait for the worker threads. Run any tasks left.
+    /// </summary>
+    void StopWorkers();
+
+    /// <summary>
+    /// Submit a task not in any group. fire and forget.
+    /// </summary>
+    void Submit(cThreadTask* pTask);
+    template <class FUNC>
+    void SubmitFunc(FUNC&& func) {
+        Submit(new cThreadTaskFunc<typename std::decay<FUNC>::type>(std::forward<FUNC>(func)));
+    }
+
+    /// <summary>
+    /// Run func(i) for each i in [iStart, iEnd) split into chunks over the workers. Waits for all.
+    /// </summary>
+    /// <param name="nGrain">min items per chunk. 0 = auto.</param>
+    template <class FUNC>
+    void ParallelFor(ITERATE_t iStart, ITERATE_t iEnd, const FUNC& func, ITERATE_t nGrain = 0) {
+        const ITERATE_t nQty = iEnd - iStart;
+        if (nQty <= 0) return;
+        const ITERATE_t nChunksMax = cValT::Max<ITERATE_t>(get_WorkerCount(), 1) * 4;  // some slack for uneven chunks.
+        ITERATE_t nChunk = cValT::Max<ITERATE_t>((nQty + nChunksMax - 1) / nChunksMax, nGrain);
+        if (nChunk <= 0) nChunk = 1;
+        cThreadTaskGroup group(*this);
+        for (ITERATE_t i = iStart; i < iEnd; i += nChunk) {
+            const ITERATE_t iChunkEnd = cValT::Min(i + nChunk, iEnd);
+            group.RunFunc([&func, i, iChunkEnd]() {
+                for (ITERATE_t j = i; j < iChunkEnd; j++) func(j);
+            });
+        }
+        group.Wait();
+    }
+};
+}  // namespace Gray
+#endif
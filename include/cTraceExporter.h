@@ -0,0 +1,138 @@
+//! @file cTraceExporter.h
+//! Mark scoped timing regions and stream them out as Chrome Trace Event JSON. chrome://tracing or Perfetto.
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+
+#ifndef _INC_cTraceExporter_H
+#define _INC_cTraceExporter_H
+#ifndef NO_PRAGMA_ONCE
+#pragma once
+#endif
+
+#include "ITextWriter.h"
+#include "cArray.h"
+#include "cFile.h"
+#include "cRefPtr.h"
+#include "cSingleton.h"
+#include "cThreadLock.h"
+#include "cTimeSys.h"
+
+namespace Gray {
+struct cTraceThread;
+struct cTraceThreadHolder;
+class cTraceExportThread;
+
+/// <summary>
+/// A single completed timing region. static name. cTimePerf units.
+/// </summary>
+struct cTraceEvent {
+    const char* _pszName;     /// static text.
+    TIMEPERF_t _nTimeStart;  /// cTimePerf
+    TIMEPERF_t _nTimeEnd;    /// cTimePerf
+};
+
+/// <summary>
+/// Mark the begin/end of a timing region. Like cCodeProfileFunc but records each call for a timeline.
+/// This is ALWAYS stack based so its thread safe.
+/// Adds a cTraceEvent to the per thread ring on exit. No locks, no heap, no I/O.
+/// </summary>
+class GRAYCORE_LINK cTraceScope {
+    friend class cTraceExporter;
+
+    const char* const _pszName;  /// static text.
+    TIMEPERF_t _nTimeStart;      /// 0 = not recording this scope.
+
+    static bool sm_bActive;  /// are we actively recording? Thread Safe read.
+
+ private:
+    static TIMEPERF_t GRAYCALL GetTimeStart() noexcept;
+    void Record() noexcept;
+
+ public:
+    explicit cTraceScope(const char* pszName) noexcept : _pszName(pszName), _nTimeStart(sm_bActive ? GetTimeStart() : 0) {}
+    ~cTraceScope() {
+        if (_nTimeStart != 0) {  // inline check for maximum speed.
+            Record();
+        }
+    }
+
+    /// <summary>
+    /// Name the current thread for the trace. cThreadRef does this for itself.
+    /// </summary>
+    /// <param name="pszName">static text.</param>
+    static void GRAYCALL SetThreadName(const char* pszName) noexcept;
+};
+
+/// <summary>
+/// Owns all the per thread event rings. Drains them to Chrome Trace Event JSON. (JSON Array Format)
+/// Also writes cHeap::GetStats() counters each time it drains.
+/// </summary>
+class GRAYCORE_LINK cTraceExporter final : public cSingleton<cTraceExporter> {
+    friend class cTraceScope;
+    friend class cTraceExportThread;
+    friend struct cTraceThreadHolder;
+
+ public:
+    DECLARE_cSingleton(cTraceExporter);
+    static const ITERATE_t k_nQtyDef = 8192;  /// default ring size per thread. events.
+
+ private:
+    mutable cThreadLockableX _Lock;           /// protect _aThreads and _File. NOT used to record events.
+    cArrayPtr<cTraceThread> _aThreads;        /// all thread rings. recycled after the thread exits. never freed.
+    ITERATE_t _nTidLast = 0;                  /// last trace tid given to a thread.
+    UINT _nQtyDroppedFree = 0;                /// dropped events counted by threads that have exited.
+    cTimePerf _tStart;                        /// ts = 0.
+    cFile _File;                              /// StartFile()
+    UINT64 _nQtyWritten = 0;                  /// events written since WriteHeader(). for JSON separators.
+    cRefPtr<cTraceExportThread> _pThread;     /// periodic drain to _File.
+
+ private:
+    cTraceThread* GetThreadCurrent() noexcept;
+    void ReleaseThread(cTraceThread* pThread) noexcept;
+    double GetTimeStamp(TIMEPERF_t nTime) const noexcept;
+    HRESULT WriteEvent(ITextWriter& o, const char* pszFormat, ...);
+
+ protected:
+    cTraceExporter();
+    ~cTraceExporter() override;
+
+ public:
+    ITERATE_t _nQtyEvents = k_nQtyDef;  /// ring size for new threads. rounded up to a power of 2.
+
+    bool get_Active() const noexcept {
+        return cTraceScope::sm_bActive;
+    }
+    bool put_Active(bool bActive);
+
+    /// <summary>
+    /// Start a JSON array. Reset the time base.
+    /// </summary>
+    HRESULT WriteHeader(ITextWriter& o);
+    /// <summary>
+    /// Drain all thread rings and write the events, thread names and heap counters.
+    /// </summary>
+    HRESULT WriteEvents(ITextWriter& o);
+    /// <summary>
+    /// Close the JSON array. Optional for Chrome trace viewers. so a crash still leaves a usable file.
+    /// </summary>
+    HRESULT WriteFooter(ITextWriter& o);
+
+    /// <summary>
+    /// Open a trace file, set active and drain to it every nInterval on a background thread.
+    /// </summary>
+    HRESULT StartFile(const FILECHAR_t* pszFile, TIMESYSD_t nInterval = 1000);
+    /// <summary>
+    /// Stop the background thread, drain the last events and close the file.
+    /// </summary>
+    HRESULT StopFile();
+};
+
+// cTraceScope usage requires only single declaration inside the scope to time.
+#ifdef USE_TRACESCOPE
+#define TRACESCOPE(pszName) ::Gray::cTraceScope _tagTRACE_SCOPE(pszName)
+#define TRACESCOPEFUNC() ::Gray::cTraceScope _tagTRACE_SCOPE(__FUNCTION__)
+#else
+#define TRACESCOPE(pszName) __noop  // compile out tracing. Do nothing.
+#define TRACESCOPEFUNC() __noop
+#endif
+}  // namespace Gray
+#endif
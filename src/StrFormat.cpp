@@ -167,9 +167,10 @@ void StrFormat<TYPE>::RenderUInt(StrBuilder<TYPE>& out, const TYPE* pszPrefix, R
     StrLen_t nPrecision = _nPrecision;  // We can increase this to include pad 0 and sign.
     if (nPrecision > nDigits) nPrecision = (short)nDigits;
 
+    const StrLen_t nPrefix = (pszPrefix != nullptr) ? StrT::Len(pszPrefix) : 0;
     if (_isLeadZero) {
-        // 0 pad as part of szTmp. Replaces ' ' padding.
-        StrLen_t nPad = (_nWidthMin >= nDigits) ? (_nWidthMin - nDigits) : uVal ? 1 : 0;
+        // 0 pad as part of szTmp. Replaces ' ' padding. The sign/prefix counts toward the width.
+        StrLen_t nPad = (_nWidthMin >= nDigits + nPrefix) ? (_nWidthMin - nDigits - nPrefix) : 0;
         if (nPad + nDigits >= STRMAX(szTmp)) nPad = STRMAX(szTmp) - nDigits;
         pDigits -= nPad;
         cValSpan::FillQty<TYPE>(pDigits, nPad, '0');
@@ -179,7 +180,6 @@ void StrFormat<TYPE>::RenderUInt(StrBuilder<TYPE>& out, const TYPE* pszPrefix, R
 
     if (pszPrefix != nullptr) {
         // Sign prefix is part of szTmp. Can't be padded out. or "0x"
-        const StrLen_t nPrefix = StrT::Len(pszPrefix);
         ASSERT(nPrefix <= 2);  // we left some prefix space for this.
         pDigits -= nPrefix;
         cMem::Copy(pDigits, pszPrefix, nPrefix * sizeof(TYPE));
@@ -203,15 +203,68 @@ void StrFormat<TYPE>::RenderFloat(StrBuilder<TYPE>& out, double dVal, char chE)
         nLen = StrT::DtoA<TYPE>(dVal, TOSPAN(szTmp), _nPrecision, chE);  // default = 6.
     }
 
+    if (_isLeadZero && !_isAlignLeft && _nWidthMin > nLen && _nWidthMin < STRMAX(szTmp)) {
+        // 0 pad after the sign. Replaces ' ' padding.
+        const StrLen_t nSign = (szTmp[0] == '-' || szTmp[0] == '+') ? 1 : 0;
+        const StrLen_t nPad = _nWidthMin - nLen;
+        cMem::CopyOverlap(szTmp + nSign + nPad, szTmp + nSign, (nLen - nSign) * sizeof(TYPE));
+        cValSpan::FillQty<TYPE>(szTmp + nSign, nPad, '0');
+        nLen += nPad;
+    }
+
     RenderString(out, szTmp, nLen, (short)nLen);
 }
 
 template <typename TYPE>
-void StrFormat<TYPE>::RenderParam(StrBuilder<TYPE>& out, va_list* pvlist) const {
+typename StrFormat<TYPE>::ARG_t StrFormat<TYPE>::GetArgV(va_list* pvlist) const {
+    ARG_t arg;
+    arg._uVal = 0;
+    switch (_chSpec) {
+        case 'c':  // char.
+            arg._nVal = va_arg(*pvlist, int);
+            break;
+        case 's': {
+            const TYPE* pszParam = va_arg(*pvlist, const TYPE*);
+            if (pszParam == nullptr) {  // null/bad pointer?
+                pszParam = CSTRCONST("(null)");
+            } else if (cMem::IsCorruptApp(pszParam, 16, false)) {
+                pszParam = CSTRCONST("(ERR)");
+            }
+            arg._pszVal = pszParam;
+            break;
+        }
+        case 'd':
+        case 'i':
+            if (_eLongType > 1) {
+                arg._nVal = va_arg(*pvlist, INT64);
+            } else {
+                arg._nVal = va_arg(*pvlist, INT32);
+            }
+            break;
+        case 'E':
+        case 'e':
+        case 'F':
+        case 'f':
+        case 'G':
+        case 'g':
+            arg._dVal = va_arg(*pvlist, double);
+            break;
+        default:  // unsigned. 'u','x','X','o','p'
+            if (get_LongType() > 1) {
+                arg._uVal = va_arg(*pvlist, UINT64);
+            } else {
+                arg._uVal = va_arg(*pvlist, UINT32);
+            }
+            break;
+    }
+    return arg;
+}
+
+template <typename TYPE>
+void StrFormat<TYPE>::RenderArg(StrBuilder<TYPE>& out, const ARG_t& arg) const {
     RADIX_t nRadixBase = 10;
     char chRadixA = 'a';
     const TYPE* pszPrefix = nullptr;
-    BYTE nLong = _eLongType;
 
     switch (_chSpec) {
         case 'c': {  // char.
@@ -219,33 +272,20 @@ void StrFormat<TYPE>::RenderParam(StrBuilder<TYPE>& out, va_list* pvlist) const
                 // repeat char!
             }
             TYPE szTmp[2];
-            szTmp[0] = (TYPE)va_arg(*pvlist, int);
+            szTmp[0] = (TYPE)arg._nVal;
             szTmp[1] = '\0';
             RenderString(out, szTmp, 1, _nPrecision);
             return;
         }
 
         // case 'S':	// Opposite type? char/wchar_t. To Dangerous.
-        case 's': {
-            const TYPE* pszParam = va_arg(*pvlist, const TYPE*);
-            if (pszParam == nullptr) {  // null/bad pointer?
-                pszParam = CSTRCONST("(null)");
-            } else if (cMem::IsCorruptApp(pszParam, 16, false)) {
-                pszParam = CSTRCONST("(ERR)");
-            }
-            RenderString(out, pszParam, StrT::Len(pszParam), _nPrecision);
+        case 's':
+            RenderString(out, arg._pszVal, StrT::Len(arg._pszVal), _nPrecision);
             return;
-        }
 
         case 'd':
         case 'i': {
-            INT64 nVal;
-            if (nLong > 1) {
-                nVal = va_arg(*pvlist, INT64);
-            } else {
-                nVal = va_arg(*pvlist, INT32);
-            }
-
+            INT64 nVal = arg._nVal;
             if (nVal < 0) {
                 nVal = -nVal;
                 pszPrefix = CSTRCONST("-");
@@ -258,16 +298,9 @@ void StrFormat<TYPE>::RenderParam(StrBuilder<TYPE>& out, va_list* pvlist) const
         }
 
         case 'u':
-        do_num_uns : {
-            UINT64 nVal;
-            if (nLong > 1) {
-                nVal = va_arg(*pvlist, UINT64);
-            } else {
-                nVal = va_arg(*pvlist, UINT32);
-            }
-            RenderUInt(out, pszPrefix, nRadixBase, chRadixA, nVal);
+        do_num_uns:
+            RenderUInt(out, pszPrefix, nRadixBase, chRadixA, arg._uVal);
             return;
-        }
 
         case 'X':  // Upper case
             chRadixA = 'A';
@@ -277,15 +310,7 @@ void StrFormat<TYPE>::RenderParam(StrBuilder<TYPE>& out, va_list* pvlist) const
             }
             goto do_num_uns;
 
-        case 'p':  // A pointer. M$ specific ? // Set Size for the pointer.
-                   
-#ifdef USE_64BIT
-            nLong = 2;
-#else
-            nLong = 1;
-#endif
-            [[fallthrough]];
-
+        case 'p':  // A pointer. M$ specific ? get_LongType() is the size of the pointer.
         case 'x':  // int hex.
             nRadixBase = 16;
             if (_isAddPrefix) {
@@ -315,7 +340,7 @@ void StrFormat<TYPE>::RenderParam(StrBuilder<TYPE>& out, va_list* pvlist) const
         case 'f':  // Float precision = decimal places. default _nPrecision = 6
             chRadixA = '\0';
         do_num_float:
-            RenderFloat(out, va_arg(*pvlist, double), chRadixA);
+            RenderFloat(out, arg._dVal, chRadixA);
             return;
 
         case 'G':  // Upper case. Use the shortest representation: %E or %F
@@ -403,6 +428,166 @@ void GRAYCALL StrFormat<TYPE>::V(StrBuilder<TYPE>& out, const TYPE* pszFormat, v
     }
 }
 
+//********************************************
+
+/// <summary>
+/// Is this param spec something StrFormat::ParseParam() can handle? e.g. not "%hd", "%Lf", "% d"
+/// </summary>
+template <typename TYPE>
+static bool IsFormatParamSimple(const TYPE* pszParam) noexcept {
+    if (pszParam[0] == '%') return true;  // %%
+    for (StrLen_t i = 0;; i++) {
+        const TYPE ch = pszParam[i];
+        if (ch <= ' ' || ch >= 128) return false;
+#ifndef _WIN32
+        if (ch == 'p') return false;  // StrFormat renders %p as M$ does. the eager path on this system may not.
+#endif
+        if (StrFormatParams::FindSpec((char)ch) != '\0') return true;
+        if (StrChar::IsDigitA(ch)) continue;
+        switch (ch) {
+            case 'l':
+#ifndef _WIN32
+                // A single 'l' is 64 bit long on LP64 and %ls/%lc are wchar_t. StrFormat assumes 32 bit. Only "ll" is safe.
+                if (pszParam[i + 1] != 'l' && (i == 0 || pszParam[i - 1] != 'l')) return false;
+#endif
+                continue;
+            case '.':
+            case 'z':
+            case '-':
+            case '+':
+            case '*':
+            case '#':
+                continue;
+        }
+        return false;
+    }
+}
+
+/// <summary>
+/// Does this param get 8 bytes in the StrFormatArgs pack? else 4.
+/// </summary>
+template <typename TYPE>
+static bool IsArg64(const StrFormat<TYPE>& paramx) noexcept {
+    switch (paramx._chSpec) {
+        case 'E':
+        case 'e':
+        case 'F':
+        case 'f':
+        case 'G':
+        case 'g':
+            return true;  // double.
+    }
+    return paramx.get_LongType() > 1;
+}
+
+template <typename TYPE>
+bool StrFormatArgs<TYPE>::Capture(const TYPE* pszFormat, va_list vlist) {
+    Clear();
+    if (pszFormat == nullptr) return false;
+
+    size_t nSize = 0;
+    for (StrLen_t iLenForm = 0;;) {
+        const TYPE ch = pszFormat[iLenForm++];
+        if (ch == '\0') break;
+        if (ch != '%') continue;
+        if (!IsFormatParamSimple(pszFormat + iLenForm)) return false;  // let the caller format it now.
+
+        StrFormat<TYPE> paramx;
+        iLenForm += paramx.ParseParam(pszFormat + iLenForm);
+        if (paramx._chSpec == '\0') continue;  // %%
+
+        if (paramx._isWidthArg) {
+            const INT32 iWidth = va_arg(vlist, int);
+            if (nSize + sizeof(iWidth) > k_nSizeArgsMax) return false;
+            cMem::Copy(_Args + nSize, &iWidth, sizeof(iWidth));
+            nSize += sizeof(iWidth);
+        }
+
+        const typename StrFormat<TYPE>::ARG_t arg = paramx.GetArgV(
+#ifdef __GNUC__
+            (va_list*)vlist
+#else
+            &vlist
+#endif
+        );
+
+        if (paramx._chSpec == 's') {
+            // Copy the string in. with its length.
+            const StrLen_t nLen = StrT::Len(arg._pszVal);
+            const size_t nSizeStr = sizeof(StrLen_t) + (nLen + 1) * sizeof(TYPE);
+            if (nSize + nSizeStr > k_nSizeArgsMax) return false;
+            cMem::Copy(_Args + nSize, &nLen, sizeof(nLen));
+            cMem::Copy(_Args + nSize + sizeof(nLen), arg._pszVal, (nLen + 1) * sizeof(TYPE));
+            nSize += nSizeStr;
+        } else if (IsArg64(paramx)) {
+            if (nSize + sizeof(arg) > k_nSizeArgsMax) return false;
+            cMem::Copy(_Args + nSize, &arg, sizeof(arg));  // 64 bit or double.
+            nSize += sizeof(arg);
+        } else {
+            const UINT32 nVal = CastN(UINT32, arg._uVal);  // 32 bit. sign is restored by Render().
+            if (nSize + sizeof(nVal) > k_nSizeArgsMax) return false;
+            cMem::Copy(_Args + nSize, &nVal, sizeof(nVal));
+            nSize += sizeof(nVal);
+        }
+    }
+
+    _pszFormat = pszFormat;
+    _nSizeArgs = CastN(WORD, nSize);
+    return true;
+}
+
+template <typename TYPE>
+void StrFormatArgs<TYPE>::Render(StrBuilder<TYPE>& out) const {
+    if (_pszFormat == nullptr) return;
+    size_t nSize = 0;
+    for (StrLen_t iLenForm = 0;;) {
+        if (out.isOverflow()) break;  // no room for anything more.
+        const TYPE ch = _pszFormat[iLenForm++];
+        if (ch == '\0') break;
+
+        if (ch == '%') {
+            StrFormat<TYPE> paramx;
+            iLenForm += paramx.ParseParam(_pszFormat + iLenForm);
+            if (paramx._chSpec != '\0') {
+                if (paramx._isWidthArg) {
+                    INT32 iVal;
+                    cMem::Copy(&iVal, _Args + nSize, sizeof(iVal));
+                    nSize += sizeof(iVal);
+                    if (iVal < 0) {
+                        iVal = -iVal;
+                        paramx._isAlignLeft = true;
+                    }
+                    paramx._nWidthMin = (BYTE)iVal;
+                }
+
+                typename StrFormat<TYPE>::ARG_t arg;
+                if (paramx._chSpec == 's') {
+                    StrLen_t nLen;
+                    cMem::Copy(&nLen, _Args + nSize, sizeof(nLen));
+                    arg._pszVal = PtrCast<TYPE>(const_cast<BYTE*>(_Args + nSize + sizeof(nLen)));  // '\0' terminated. maybe not aligned.
+                    nSize += sizeof(nLen) + (nLen + 1) * sizeof(TYPE);
+                } else if (IsArg64(paramx)) {
+                    cMem::Copy(&arg, _Args + nSize, sizeof(arg));
+                    nSize += sizeof(arg);
+                } else {
+                    UINT32 nVal;
+                    cMem::Copy(&nVal, _Args + nSize, sizeof(nVal));
+                    nSize += sizeof(nVal);
+                    if (paramx._chSpec == 'd' || paramx._chSpec == 'i' || paramx._chSpec == 'c') {
+                        arg._nVal = CastN(INT32, nVal);  // sign extend.
+                    } else {
+                        arg._uVal = nVal;
+                    }
+                }
+                paramx.RenderArg(out, arg);
+                continue;
+            }
+        }
+
+        out.AddChar(ch);
+    }
+}
+
 bool GRAYCALL StrTemplate::HasTemplateBlock(const IniChar_t* pszInp) {
     ASSERT_NN(pszInp);
     return StrT::FindStr(pszInp, "<?") != nullptr && StrT::FindStr(pszInp, "?>") != nullptr;
@@ -488,4 +673,7 @@ template class GRAYCORE_LINK StrBuilder<wchar_t>;  // Force Instantiation for DL
 
 template struct GRAYCORE_LINK StrFormat<char>;     // Force Instantiation for DLL.
 template struct GRAYCORE_LINK StrFormat<wchar_t>;  // Force implementation/instantiate for DLL/SO.
+
+template class GRAYCORE_LINK StrFormatArgs<char>;     // Force Instantiation for DLL.
+template class GRAYCORE_LINK StrFormatArgs<wchar_t>;  // Force implementation/instantiate for DLL/SO.
 }  // namespace Gray
@@ -4,6 +4,7 @@
 #include "pch.h"
 // clang-format on
 #include "StrT.h"
+#include "StrTSimd.inl"
 #include "StrU.h"
 #include "cBits.h"
 #include "cLogMgr.h"
@@ -53,15 +54,15 @@ StrLen_t GRAYCALL StrU::UTF8toUNICODEChar(OUT wchar_t& wChar, const char* pInp,
         wChar = CastN(wchar_t, *pInp);
         return 1;
     }
-    if (iSizeChar <= 0 || iSizeChar > iSizeInpBytes) return 0;  // not big enough bytes to provide it. (broken char) // FAILED
+    if (iSizeChar <= 0) return k_StrLen_UNK;  // invalid lead byte.
 
     unsigned char ch = CastN(unsigned char, *pInp);
     wchar_t wCharTmp = ch & cBits::MaskLT<unsigned char>(UTF8StartBits(iSizeChar));
     StrLen_t iInp = 1;
     for (; iInp < iSizeChar; iInp++) {
+        if (iInp >= iSizeInpBytes) return 0;  // not big enough bytes to provide it. (split char) need more.
         ch = CastN(unsigned char, pInp[iInp]);
-        // if (( ch & 0xc0 ) != 0x08 )	// bad coding.
-        //	return k_StrLen_UNK;
+        if ((ch & 0xc0) != 0x80) return k_StrLen_UNK;  // bad coding.
         wCharTmp <<= 6;
         wCharTmp |= ch & 0x3f;
     }
@@ -92,6 +93,110 @@ StrLen_t GRAYCALL StrU::UNICODEtoUTF8Char(char* pOut, StrLen_t iSizeOutMaxBytes,
     return iSizeChar;
 }
 
+//*********************************************
+// ASCII runs need no UTF8 decoding. Do them in blocks.
+
+/// <summary>
+/// How many chars at the start of pInp are 7 bit ASCII ? (not '\0')
+/// </summary>
+static StrLen_t GetAsciiRunA(const char* pInp, StrLen_t iSizeInpBytes) noexcept {
+    StrLen_t i = 0;
+#ifdef USE_SIMD_SSE2
+    const __m128i vZero = _mm_setzero_si128();
+    for (; i + 16 <= iSizeInpBytes; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pInp + i));
+        const UINT32 nStop = CastN(UINT32, _mm_movemask_epi8(v) | _mm_movemask_epi8(_mm_cmpeq_epi8(v, vZero)));  // high bit or '\0'.
+        if (nStop != 0) return i + CastN(StrLen_t, StrTSimd::GetLowBit(nStop));
+    }
+#endif
+    for (; i < iSizeInpBytes; i++) {
+        const char ch = pInp[i];
+        if (ch == '\0' || (ch & 0x80) != 0) break;
+    }
+    return i;
+}
+
+/// <summary>
+/// How many chars at the start of pwInp are 7 bit ASCII ? (not '\0')
+/// </summary>
+static StrLen_t GetAsciiRunW(const wchar_t* pwInp, StrLen_t iSizeInpChars) noexcept {
+    StrLen_t i = 0;
+#ifdef USE_SIMD_SSE2
+    constexpr StrLen_t kBlockChars = 16 / sizeof(wchar_t);
+    const __m128i vZero = _mm_setzero_si128();
+    const __m128i vHigh = (sizeof(wchar_t) == 2) ? _mm_set1_epi16(CastN(short, ~0x7f)) : _mm_set1_epi32(~0x7f);
+    for (; i + kBlockChars <= iSizeInpChars; i += kBlockChars) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pwInp + i));
+        __m128i vAscii, vNul;
+        if constexpr (sizeof(wchar_t) == 2) {
+            vAscii = _mm_cmpeq_epi16(_mm_and_si128(v, vHigh), vZero);
+            vNul = _mm_cmpeq_epi16(v, vZero);
+        } else {
+            vAscii = _mm_cmpeq_epi32(_mm_and_si128(v, vHigh), vZero);
+            vNul = _mm_cmpeq_epi32(v, vZero);
+        }
+        const UINT32 nStop = CastN(UINT32, _mm_movemask_epi8(_mm_andnot_si128(vNul, vAscii))) ^ 0xFFFF;
+        if (nStop != 0) return i + CastN(StrLen_t, StrTSimd::GetLowBit(nStop) / sizeof(wchar_t));
+    }
+#endif
+    for (; i < iSizeInpChars; i++) {
+        const wchar_t wChar = pwInp[i];
+        if (wChar == '\0' || (wChar & ~0x7f) != 0) break;
+    }
+    return i;
+}
+
+/// <summary>
+/// Widen a run of ASCII from GetAsciiRunA()
+/// </summary>
+static void CopyAsciiA2W(wchar_t* pwOut, const char* pInp, StrLen_t iLen) noexcept {
+    StrLen_t i = 0;
+#ifdef USE_SIMD_SSE2
+    const __m128i vZero = _mm_setzero_si128();
+    for (; i + 16 <= iLen; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pInp + i));
+        const __m128i vLo = _mm_unpacklo_epi8(v, vZero);
+        const __m128i vHi = _mm_unpackhi_epi8(v, vZero);
+        __m128i* pvOut = reinterpret_cast<__m128i*>(pwOut + i);
+        if constexpr (sizeof(wchar_t) == 2) {
+            _mm_storeu_si128(pvOut, vLo);
+            _mm_storeu_si128(pvOut + 1, vHi);
+        } else {
+            _mm_storeu_si128(pvOut, _mm_unpacklo_epi16(vLo, vZero));
+            _mm_storeu_si128(pvOut + 1, _mm_unpackhi_epi16(vLo, vZero));
+            _mm_storeu_si128(pvOut + 2, _mm_unpacklo_epi16(vHi, vZero));
+            _mm_storeu_si128(pvOut + 3, _mm_unpackhi_epi16(vHi, vZero));
+        }
+    }
+#endif
+    for (; i < iLen; i++) {
+        pwOut[i] = CastN(wchar_t, pInp[i]);
+    }
+}
+
+/// <summary>
+/// Narrow a run of ASCII from GetAsciiRunW()
+/// </summary>
+static void CopyAsciiW2A(char* pOut, const wchar_t* pwInp, StrLen_t iLen) noexcept {
+    StrLen_t i = 0;
+#ifdef USE_SIMD_SSE2
+    constexpr StrLen_t kBlockChars = 16 / sizeof(wchar_t);
+    for (; i + kBlockChars <= iLen; i += kBlockChars) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pwInp + i));
+        if constexpr (sizeof(wchar_t) == 2) {
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(pOut + i), _mm_packus_epi16(v, v));
+        } else {
+            v = _mm_packs_epi32(v, v);
+            const INT32 n = _mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+            cMem::Copy(pOut + i, &n, sizeof(n));
+        }
+    }
+#endif
+    for (; i < iLen; i++) {
+        pOut[i] = CastN(char, pwInp[i]);
+    }
+}
+
 //*********************************************
 
 StrLen_t GRAYCALL StrU::UTF8toUNICODELen(const cSpan<char>& src) noexcept {  // static
@@ -101,10 +206,17 @@ StrLen_t GRAYCALL StrU::UTF8toUNICODELen(const cSpan<char>& src) noexcept {  //
     const char* pInp = src.get_PtrConst();
     StrLen_t iSizeInpBytes = src.GetSize();
     for (; iSizeInpBytes > 0;) {
+        const StrLen_t nAscii = GetAsciiRunA(pInp, iSizeInpBytes);
+        iOut += nAscii;
+        pInp += nAscii;
+        iSizeInpBytes -= nAscii;
+        if (iSizeInpBytes <= 0) break;
         const char ch = pInp[0];
         if (ch == '\0') break;
-        const StrLen_t iSizeChar = UTF8SizeChar1(ch);
-        if (iSizeChar <= 0 || iSizeChar > iSizeInpBytes) return k_ITERATE_BAD;  // broken char.
+        wchar_t wChar;
+        StrLen_t iSizeChar = UTF8toUNICODEChar(wChar, pInp, iSizeInpBytes);
+        if (iSizeChar == 0) break;          // split char at the end. UTF8toUNICODE() drops it.
+        if (iSizeChar < 0) iSizeChar = 1;   // invalid byte. UTF8toUNICODE() passes it as is.
         iOut++;
         pInp += iSizeChar;
         iSizeInpBytes -= iSizeChar;
@@ -119,6 +231,10 @@ StrLen_t GRAYCALL StrU::UNICODEtoUTF8Size(const cSpan<wchar_t>& src) noexcept {
     const wchar_t* pwInp = src.get_PtrConst();
     const StrLen_t iSizeInpChars = src.GetSize();
     for (StrLen_t iInp = 0; iInp < iSizeInpChars; iInp++) {
+        const StrLen_t nAscii = GetAsciiRunW(pwInp + iInp, iSizeInpChars - iInp);
+        iOut += nAscii;
+        iInp += nAscii;
+        if (iInp >= iSizeInpChars) break;
         const wchar_t wChar = pwInp[iInp];
         if (wChar == '\0') break;
         const StrLen_t iSizeChar = UTF8SizeChar(wChar);
@@ -129,6 +245,12 @@ StrLen_t GRAYCALL StrU::UNICODEtoUTF8Size(const cSpan<wchar_t>& src) noexcept {
 }
 
 StrLen_t GRAYCALL StrU::UTF8toUNICODE(cSpanX<wchar_t> ret, const cSpan<char>& src) noexcept {  // static
+    StrLen_t iSizeInpUsed;
+    return UTF8toUNICODEPart(ret, src, iSizeInpUsed);
+}
+
+StrLen_t GRAYCALL StrU::UTF8toUNICODEPart(cSpanX<wchar_t> ret, const cSpan<char>& src, OUT StrLen_t& iSizeInpUsed) noexcept {  // static
+    iSizeInpUsed = 0;
     if (ret.isEmpty()) {
         DEBUG_CHECK(!ret.isEmpty());
         return k_ITERATE_BAD;
@@ -142,19 +264,29 @@ StrLen_t GRAYCALL StrU::UTF8toUNICODE(cSpanX<wchar_t> ret, const cSpan<char>& sr
         return 0;
     }
     const StrLen_t iSizeOutMaxChars = ret.GetSize() - 1;
+    const char* pInp = src.get_PtrConst();
+    const StrLen_t iSizeInpBytes = src.GetSize();
     StrLen_t iOut = 0;
+    StrLen_t iInp = 0;
 
     // Win95 or __linux__
-    for (StrLen_t iInp = 0; iInp < src.GetSize();) {
-        const unsigned char ch = src[iInp];
-        if (ch == '\0') break;
+    while (iInp < iSizeInpBytes) {
         if (iOut >= iSizeOutMaxChars) break;
+        const StrLen_t nAscii = GetAsciiRunA(pInp + iInp, cValT::Min(iSizeInpBytes - iInp, iSizeOutMaxChars - iOut));
+        if (nAscii > 0) {  // needs NO special UTF8 decoding.
+            CopyAsciiA2W(pwOut + iOut, pInp + iInp, nAscii);
+            iInp += nAscii;
+            iOut += nAscii;
+            continue;
+        }
+        const unsigned char ch = pInp[iInp];
+        if (ch == '\0') break;
         if (ch >= 0x80) {  // special UTF8 encoded char.
             wchar_t wChar;
-            const StrLen_t lenChar = UTF8toUNICODEChar(wChar, src.get_PtrConst() + iInp, src.GetSize() - iInp);
+            const StrLen_t lenChar = UTF8toUNICODEChar(wChar, pInp + iInp, iSizeInpBytes - iInp);
             if (lenChar <= 0) {
-                if (lenChar == 0) break;
-                pwOut[iOut] = ch;
+                if (lenChar == 0) break;  // split char at the end of src. need more. leave it for the next call.
+                pwOut[iOut] = ch;         // invalid. pass the byte as is and move on.
                 iInp++;
             } else {
                 pwOut[iOut] = wChar;
@@ -168,6 +300,7 @@ StrLen_t GRAYCALL StrU::UTF8toUNICODE(cSpanX<wchar_t> ret, const cSpan<char>& sr
     }
 
     StrT::SetIfSafe(pwOut + iOut);  // make sure it's '\0' terminated
+    iSizeInpUsed = iInp;
     return iOut;
 }
 
@@ -189,9 +322,19 @@ StrLen_t GRAYCALL StrU::UNICODEtoUTF8(cSpanX<char> ret, const cSpan<wchar_t>& sr
     StrLen_t iOut = 0;
 
     // Win95 or __linux__ = just assume its really ASCII
-    for (const wchar_t wChar : src) {
-        if (wChar == '\0') break;
+    const wchar_t* pwInp = src.get_PtrConst();
+    const StrLen_t iSizeInpChars = src.GetSize();
+    for (StrLen_t iInp = 0; iInp < iSizeInpChars; iInp++) {
         if (iOut >= iSizeOutMaxBytes) break;
+        const StrLen_t nAscii = GetAsciiRunW(pwInp + iInp, cValT::Min(iSizeInpChars - iInp, iSizeOutMaxBytes - iOut));
+        if (nAscii > 0) {  // needs NO special UTF8 encoding.
+            CopyAsciiW2A(pOut + iOut, pwInp + iInp, nAscii);
+            iOut += nAscii;
+            iInp += nAscii - 1;
+            continue;
+        }
+        const wchar_t wChar = pwInp[iInp];
+        if (wChar == '\0') break;
         if (wChar >= 0x80) {  // needs special UTF8 encoding.
             const StrLen_t iOutTmp = UNICODEtoUTF8Char(pOut + iOut, iSizeOutMaxBytes - iOut, wChar);
             if (iOutTmp <= 0) {
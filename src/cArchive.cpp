@@ -16,6 +16,17 @@ HRESULT cArchive::Serialize(cMemSpan ret) {
     return hRes;
 }
 
+HRESULT cArchive::SerializeV(const cSpan<cMemSpan>& aParts) {
+    size_t nSizeTotal = 0;
+    for (const cMemSpan& part : aParts) {
+        nSizeTotal += part.get_SizeBytes();
+    }
+    const HRESULT hRes = IsStoring() ? ref_Out().WriteV(aParts) : ref_Inp().ReadV(aParts);
+    if (FAILED(hRes)) return hRes;
+    if (CastN(size_t, hRes) != nSizeTotal) return IsStoring() ? HRESULT_WIN32_C(ERROR_WRITE_FAULT) : HRESULT_WIN32_C(ERROR_IO_INCOMPLETE);
+    return hRes;
+}
+
 HRESULT cArchive::SerializeSize(size_t& nSize) {
     if (IsStoring()) {
         return ref_Out().WriteSize(nSize);
@@ -7,41 +7,182 @@
 #include "cAtomManager.h"
 #include "cCodeProfiler.h"
 #include "cFile.h"
+#include "cHeapArena.h"
 #include "cThreadLock.h"
 
 namespace Gray {
 cSingleton_IMPL(cAtomManager);
 
-cAtomManager::cAtomManager() : cSingleton<cAtomManager>(this) {}
+cAtomIndex::DATA_t* const cAtomIndex::k_pDeleted = CastNumToPtrT<cAtomIndex::DATA_t>(1);
+
+cAtomIndex* cAtomIndex::Create(ITERATE_t nQty) {  // static
+    ASSERT(cBits::IsMask1(nQty));
+    const size_t nSize = sizeof(cAtomIndex) + (nQty - 1) * sizeof(cInterlockedPtr<DATA_t>);
+    cAtomIndex* pIndex = PtrCast<cAtomIndex>(cHeap::AllocPtr(nSize));
+    pIndex->_nMask = nQty - 1;
+    pIndex->_nUsed = 0;
+    for (ITERATE_t i = 0; i < nQty; i++) {
+        ::new ((void*)&pIndex->_aSlots[i]) cInterlockedPtr<DATA_t>(nullptr);
+    }
+    return pIndex;
+}
+void cAtomIndex::Free(cAtomIndex* pIndex) {  // static
+    cHeap::FreePtr(pIndex);  // slots have no destructor.
+}
+
+ITERATE_t cAtomIndex::FindISlot(ATOMCODE_t idAtom, const ATOMCHAR_t* pszName) const noexcept {
+    for (ITERATE_t i = idAtom & _nMask;; i = (i + 1) & _nMask) {
+        const DATA_t* pData = GetSlot(i);
+        if (pData == nullptr) return k_ITERATE_BAD;
+        if (pData == k_pDeleted) continue;
+        if (pData->get_HashCode() != idAtom) continue;
+        if (pszName == nullptr || pData->IsEqualNoCase(pszName)) return i;
+    }
+}
+ITERATE_t cAtomIndex::FindISlotPtr(const DATA_t* pData) const noexcept {
+    for (ITERATE_t i = pData->get_HashCode() & _nMask;; i = (i + 1) & _nMask) {
+        const DATA_t* pData2 = GetSlot(i);
+        if (pData2 == nullptr) return k_ITERATE_BAD;
+        if (pData2 == pData) return i;
+    }
+}
+void cAtomIndex::Insert(DATA_t* pData) noexcept {
+    // ASSUME room.
+    for (ITERATE_t i = pData->get_HashCode() & _nMask;; i = (i + 1) & _nMask) {
+        const DATA_t* pData2 = GetSlot(i);
+        if (pData2 == nullptr) {
+            _nUsed++;
+        } else if (pData2 != k_pDeleted) {
+            continue;
+        }
+        _aSlots[i] = pData;  // Interlocked publish.
+        return;
+    }
+}
+
+//*********************************
+
+cAtomManager::cReadGuard::cReadGuard(const cAtomManager& rMgr) noexcept {
+    // Thread ids are often aligned pointers. mix the bits to pick a shard.
+    const UINT64 nHash = CastN(UINT64, cThreadId::GetCurrentId()) * 11400714819323198485ULL;
+    cReaderShard& rShard = rMgr._aReaders[CastN(ITERATE_t, nHash >> 60) % kReaderShards];
+    for (;;) {
+        const int iEpoch = rMgr._nEpoch.get_Value() & 1;
+        _pCount = &rShard._nCount[iEpoch];
+        _pCount->IncV();
+        if ((rMgr._nEpoch.get_Value() & 1) == iEpoch) break;  // Reclaim() didn't flip under me.
+        _pCount->DecV();
+    }
+}
+
+cAtomManager::cAtomManager() : cSingleton<cAtomManager>(this), _pIndex(nullptr) {}
+
+cAtomManager::~cAtomManager() {
+    for (int i = 0; i < 2; i++) {
+        _aRetired[i].RemoveAll();
+        for (cAtomIndex* pIndex : _aRetiredIndex[i]) cAtomIndex::Free(pIndex);
+        _aRetiredIndex[i].RemoveAll();
+    }
+    cAtomIndex::Free(_pIndex);
+}
+
+void cAtomManager::Reclaim() {
+    // ASSUME _Lock. Two epochs. Readers in the old epoch may still see stuff retired in the old epoch.
+    const int iEpoch = _nEpoch.get_Value() & 1;
+    const int iEpochOld = iEpoch ^ 1;
+    if (!_aRetired[iEpochOld].isEmpty() || !_aRetiredIndex[iEpochOld].isEmpty()) {
+        for (const cReaderShard& rShard : _aReaders) {
+            if (rShard._nCount[iEpochOld].get_Value() != 0) return;  // try again later.
+        }
+        _aRetired[iEpochOld].RemoveAll();  // release my ref. may delete.
+        for (cAtomIndex* pIndex : _aRetiredIndex[iEpochOld]) cAtomIndex::Free(pIndex);
+        _aRetiredIndex[iEpochOld].RemoveAll();
+    }
+    if (!_aRetired[iEpoch].isEmpty() || !_aRetiredIndex[iEpoch].isEmpty()) {
+        _nEpoch.IncV();  // new readers go to the other counters. current stuff becomes old.
+    }
+}
+
+void cAtomManager::AddIndex(DATA_t* pData) {
+    // ASSUME _Lock.
+    cAtomIndex* pIndex = _pIndex;
+    if (pIndex == nullptr || (pIndex->_nUsed + 1) * 2 > pIndex->_nMask + 1) {
+        // Build a new bigger index and publish it. no in place resize for lock free readers.
+        const ITERATE_t nCount = _aNames.get_TotalCount() + 1;
+        ITERATE_t nQty = 64;
+        while (nQty < nCount * 4) nQty *= 2;
+        cAtomIndex* pIndexNew = cAtomIndex::Create(nQty);
+        FOREACH_HASH_TABLE(_aNames, i) {
+            DATA_t* pData2 = _aNames.GetAtHash(i);
+            if (pData2 != pData) pIndexNew->Insert(pData2);
+        }
+        _pIndex = pIndexNew;
+        if (pIndex != nullptr) _aRetiredIndex[_nEpoch.get_Value() & 1].Add(pIndex);
+        pIndex = pIndexNew;
+    }
+    pIndex->Insert(pData);
+}
+
+cAtomRef cAtomManager::FindAtomIndex(ATOMCODE_t idAtom, const ATOMCHAR_t* pszName, OUT bool& bFound) const noexcept {
+    bFound = false;
+    const cReadGuard guard(*this);
+    const cAtomIndex* pIndex = _pIndex;
+    if (pIndex == nullptr) return cAtomRef();
+    const ITERATE_t i = pIndex->FindISlot(idAtom, pszName);
+    if (i < 0) return cAtomRef();
+    bFound = true;
+    DATA_t* pData = pIndex->GetSlot(i);
+    REF_t pRef(pData);  // take my ref then make sure it wasn't removed. RemoveAtom() checks refs after it marks deleted.
+    if (static_cast<const cAtomIndex*>(_pIndex) != pIndex || pIndex->GetSlot(i) != pData) return cAtomRef();  // try again the slow way.
+    return cAtomRef(pData);
+}
 
 cAtomRef cAtomManager::FindAtomStr(const ATOMCHAR_t* pszText) const {
     if (StrT::IsNullOrEmpty(pszText)) return cAtomRef();
+    const ATOMCODE_t idAtom = StrT::GetHashCode32<ATOMCHAR_t>(StrT::ToSpanStr(pszText));
+    bool bFound;
+    cAtomRef pDef(FindAtomIndex(idAtom, pszText, bFound));
+    if (pDef.isValidPtr() || !bFound) return pDef;
+    // It changed as i looked. use the slow way.
     const auto guard(_Lock.Lock());
-    cAtomRef pDef(_aNames.FindArgForKey(pszText));
-    if (!pDef.isValidPtr()) return cAtomRef();
-    return cAtomRef(pDef);
+    return cAtomRef(_aNames.FindArgForKey(pszText));
 }
 
 cAtomRef cAtomManager::FindAtomHashCode(ATOMCODE_t idAtom) const {
     if (idAtom == k_HASHCODE_CLEAR) return cAtomRef();
+    bool bFound;
+    cAtomRef pDef(FindAtomIndex(idAtom, nullptr, bFound));
+    if (pDef.isValidPtr() || !bFound) return pDef;
     const auto guard(_Lock.Lock());
-    cAtomRef pDef(_aHashes.FindArgForKey(idAtom));
-    if (!pDef.isValidPtr()) return cAtomRef();
-    return cAtomRef(pDef);
+    return cAtomRef(_aHashes.FindArgForKey(idAtom));
 }
 
 bool cAtomManager::RemoveAtom(DATA_t* pDef) {
     // below kRefsBase
     if (pDef == nullptr) return false;
     const auto guard(_Lock.Lock());
+    const cHeapArenaScope scopeHeap(nullptr);  // _aRetired outlives any cHeapArena.
+
+    // Mark deleted for lock free readers first. then check no reader took a ref. (they check the slot after taking a ref)
+    cAtomIndex* pIndex = _pIndex;
+    const ITERATE_t iSlot = (pIndex == nullptr) ? k_ITERATE_BAD : pIndex->FindISlotPtr(pDef);
+    if (iSlot >= 0) pIndex->_aSlots[iSlot] = cAtomIndex::k_pDeleted;
+    if (pDef->get_RefCount() > kRefsBase) {
+        // Someone found it again. keep it.
+        if (iSlot >= 0) pIndex->_aSlots[iSlot] = pDef;
+        return false;
+    }
+
+    _aRetired[_nEpoch.get_Value() & 1].Add(pDef);  // lock free readers might still see it.
     bool bRetRemove = _aHashes.DeleteArg(pDef);
     ASSERT(bRetRemove);
     bRetRemove = _aNames.DeleteArg(pDef);
     ASSERT(bRetRemove);
 #ifdef _DEBUG
     const REFCOUNT_t iRefCount = pDef->get_RefCount();
-    ASSERT(iRefCount == 1);
+    ASSERT(iRefCount >= 2);  // caller + _aRetired. A lock free reader may still hold one too.
 #endif
+    Reclaim();
     return bRetRemove;
 }
 
@@ -58,12 +199,21 @@ cAtomRef cAtomManager::CreateAtom(const cHashIterator& index, COMPARE_t iCompare
         DEBUG_MSG(("Root"));
     }
 #endif
+    AddIndex(pData);
+    Reclaim();
     return cAtomRef(pData);
 }
 
 cAtomRef cAtomManager::FindorCreateAtom(const cSpan<ATOMCHAR_t>& src) noexcept {
     if (StrT::IsNullOrEmpty<ATOMCHAR_t>(src)) return cAtomRef();
+    {
+        // Lock free. Most atoms already exist. src may not be '\0' terminated so it can only get a hash match.
+        bool bFound;
+        cAtomRef pDef(FindAtomIndex(StrT::GetHashCode32<ATOMCHAR_t>(src), nullptr, bFound));
+        if (pDef.isValidPtr() && StrT::CmpIN(pDef->get_CPtr(), src.get_PtrConst(), src.get_MaxLen()) == COMPARE_Equal && pDef->get_CharCount() == src.get_MaxLen()) return pDef;
+    }
     const auto guard(_Lock.Lock());
+    const cHeapArenaScope scopeHeap(nullptr);  // atoms live forever. never in a cHeapArena.
     COMPARE_t iCompareRes;
     const cHashIterator index = _aNames.FindINearKey(src, iCompareRes);
     if (iCompareRes == COMPARE_Equal) return cAtomRef(_aNames.GetAtHash(index));  // already here.
@@ -71,10 +221,17 @@ cAtomRef cAtomManager::FindorCreateAtom(const cSpan<ATOMCHAR_t>& src) noexcept {
 }
 cAtomRef cAtomManager::FindorCreateAtom(const cStringA& sName) noexcept {
     if (sName.IsEmpty()) return cAtomRef();
+    {
+        bool bFound;
+        cAtomRef pDef(FindAtomIndex(sName.get_HashCode(), sName.get_CPtr(), bFound));  // Lock free. Most atoms already exist.
+        if (pDef.isValidPtr()) return pDef;
+    }
     const auto guard(_Lock.Lock());
+    const cHeapArenaScope scopeHeap(nullptr);  // atoms live forever. never in a cHeapArena.
     COMPARE_t iCompareRes;
     const cHashIterator index = _aNames.FindINearKey(sName, iCompareRes);
     if (iCompareRes == COMPARE_Equal) return cAtomRef(_aNames.GetAtHash(index));  // already here.
+    if (sName.isInline() || cHeapArenaHook::FindArena(sName.get_Head()) != nullptr) return CreateAtom(index, iCompareRes, DATA_t::CreateStringSpan(sName.get_SpanStr()));  // no head to share.
     return CreateAtom(index, iCompareRes, const_cast<cStringA&>(sName).get_Head());
 }
 
@@ -3,117 +3,366 @@
 // clang-format off
 #include "pch.h"
 // clang-format on
-#include "cAppState.h"
+#include "StrBuilder.h"
+#include "cBits.h"
 #include "cCodeProfiler.h"
 #include "cDebugAssert.h"
 #include "cFile.h"
-#include "cString.h"
-#include "cThreadLock.h"
+#include "cHeap.h"
+#include "cHeapArena.h"
+#include "cThreadBase.h"
 
 namespace Gray {
 
 bool cCodeProfileFunc::sm_bActive = false;  // static
 
-#pragma pack(push, 2)
+//**************************************************************
+
+cCodeProfilerTable::cCodeProfilerTable(ITERATE_t nQtyMax)
+    : _nQtyMax(cValT::Max<ITERATE_t>(nQtyMax, 2)), _nMaskHash(CastN(ITERATE_t, (2U << cBits::Highest1Bit(CastN(UINT32, _nQtyMax))) - 1)) {
+    _pNodes = PtrCast<cCodeProfilerNode>(cHeap::AllocPtr(_nQtyMax * sizeof(cCodeProfilerNode)));
+    _pHash = PtrCast<ITERATE_t>(cHeap::AllocPtr((_nMaskHash + 1) * sizeof(ITERATE_t)));
+    cMem::Zero(_pHash, (_nMaskHash + 1) * sizeof(ITERATE_t));
+}
+
+cCodeProfilerTable::~cCodeProfilerTable() {
+    cHeap::FreePtr(_pHash);
+    cHeap::FreePtr(_pNodes);
+}
+
+ITERATE_t cCodeProfilerTable::FindNode(ITERATE_t iParent, const cDebugSourceLine* pSrc) noexcept {
+    // Owner thread only. Open addressing. Never more than half full.
+    const UINT_PTR nKey = (CastPtrToNum(pSrc) >> 3) ^ (CastN(UINT_PTR, iParent + 1) * 0x9E3779B1U);
+    for (ITERATE_t iHash = CastN(ITERATE_t, nKey ^ (nKey >> 16)) & _nMaskHash;; iHash = (iHash + 1) & _nMaskHash) {
+        const ITERATE_t iNode = _pHash[iHash] - 1;
+        if (iNode < 0) {
+            // New node.
+            const ITERATE_t nQty = _nQty;
+            if (nQty >= _nQtyMax) {
+                _nQtyDropped++;
+                return -1;
+            }
+            cCodeProfilerNode& rNode = _pNodes[nQty];
+            rNode._pSrc = pSrc;
+            rNode._iParent = iParent;
+            rNode._nCalls = 0;
+            rNode._nTimeIncl = 0;
+            rNode._nTimeExcl = 0;
+            rNode._nTimeMin = cTypeLimit<TIMEPERF_t>::Max();
+            rNode._nTimeMax = 0;
+            _pHash[iHash] = nQty + 1;
+            InterlockedN::Exchange(&_nQty, nQty + 1);  // publish to readers.
+            return nQty;
+        }
+        const cCodeProfilerNode& rNode = _pNodes[iNode];
+        if (rNode._pSrc == pSrc && rNode._iParent == iParent) return iNode;
+    }
+}
+
+void cCodeProfilerTable::AddCall(ITERATE_t i, TIMEPERF_t nTimeIncl, TIMEPERF_t nTimeExcl) noexcept {
+    cCodeProfilerNode& rNode = _pNodes[i];
+    rNode._nCalls++;
+    rNode._nTimeIncl += nTimeIncl;
+    rNode._nTimeExcl += nTimeExcl;
+    if (nTimeIncl < rNode._nTimeMin) rNode._nTimeMin = nTimeIncl;
+    if (nTimeIncl > rNode._nTimeMax) rNode._nTimeMax = nTimeIncl;
+}
+
+void cCodeProfilerTable::AddTable(const cCodeProfilerTable& src) {
+    // Map src node indexes to mine. Parents always come before children.
+    const ITERATE_t nQty = src.get_Count();
+    cArrayVal<ITERATE_t> aMap(nQty);
+    for (ITERATE_t i = 0; i < nQty; i++) {
+        const cCodeProfilerNode& rNodeSrc = src.GetAt(i);
+        const ITERATE_t iParent = (rNodeSrc._iParent < 0) ? -1 : aMap[rNodeSrc._iParent];
+        ITERATE_t iNode = -1;
+        if (rNodeSrc._iParent < 0 || iParent >= 0) {
+            iNode = FindNode(iParent, rNodeSrc._pSrc);
+        }
+        aMap[i] = iNode;
+        if (iNode < 0) {
+            _nQtyDropped += CastN(UINT, rNodeSrc._nCalls);
+            continue;
+        }
+        cCodeProfilerNode& rNode = _pNodes[iNode];
+        rNode._nCalls += rNodeSrc._nCalls;
+        rNode._nTimeIncl += rNodeSrc._nTimeIncl;
+        rNode._nTimeExcl += rNodeSrc._nTimeExcl;
+        if (rNodeSrc._nTimeMin < rNode._nTimeMin) rNode._nTimeMin = rNodeSrc._nTimeMin;
+        if (rNodeSrc._nTimeMax > rNode._nTimeMax) rNode._nTimeMax = rNodeSrc._nTimeMax;
+    }
+    _nQtyDropped += src._nQtyDropped;
+}
+
+void cCodeProfilerTable::ClearStats() noexcept {
+    const ITERATE_t nQty = _nQty;
+    for (ITERATE_t i = 0; i < nQty; i++) {
+        cCodeProfilerNode& rNode = _pNodes[i];
+        rNode._nCalls = 0;
+        rNode._nTimeIncl = 0;
+        rNode._nTimeExcl = 0;
+        rNode._nTimeMin = cTypeLimit<TIMEPERF_t>::Max();
+        rNode._nTimeMax = 0;
+    }
+    _nQtyDropped = 0;
+}
+
 /// <summary>
-/// profile log file item struct
+/// Convert TIMEPERF_t to microseconds for the reports.
 /// </summary>
-struct CATTR_PACKED cCodeProfilerItem {
-    WORD _SizeThis;          /// Number of bytes in this record
-    WORD _uLine;          /// Line number in source file
-    UINT_PTR _nProcessId;  /// Current process ID PROCESSID_t
-    UINT_PTR _nThreadId;   /// Current thread ID THREADID_t
-    UINT64 _nCycles;       /// how many cycles inside this? TIMEPERF_t
-                           // ?? INT64 _TimePerf;		/// What did this start absolutely ? (so sub stuff can be removed.)
-
-    // File name string. 0 term
-    // Func/Function name string. 0 term
-};
-#pragma pack(pop)
+static inline UINT64 ToUSec(TIMEPERF_t nTime) noexcept {
+    return CastN(UINT64, cTimePerf::ToSeconds(nTime) * 1000000.0);
+}
+
+HRESULT cCodeProfilerTable::WriteReport(ITextWriter& o) const {
+    // Merge by function. Inclusive time is not counted again for recursive calls.
+    const ITERATE_t nQty = get_Count();
+    cCodeProfilerTable flat(nQty);
+    for (ITERATE_t i = 0; i < nQty; i++) {
+        const cCodeProfilerNode& rNodeSrc = GetAt(i);
+        const ITERATE_t iNode = flat.FindNode(-1, rNodeSrc._pSrc);
+        if (iNode < 0) continue;
+        bool bRecursive = false;
+        for (ITERATE_t iParent = rNodeSrc._iParent; iParent >= 0; iParent = GetAt(iParent)._iParent) {
+            if (GetAt(iParent)._pSrc == rNodeSrc._pSrc) {
+                bRecursive = true;
+                break;
+            }
+        }
+        cCodeProfilerNode& rNode = flat._pNodes[iNode];
+        rNode._nCalls += rNodeSrc._nCalls;
+        if (!bRecursive) rNode._nTimeIncl += rNodeSrc._nTimeIncl;
+        rNode._nTimeExcl += rNodeSrc._nTimeExcl;
+        if (rNodeSrc._nTimeMin < rNode._nTimeMin) rNode._nTimeMin = rNodeSrc._nTimeMin;
+        if (rNodeSrc._nTimeMax > rNode._nTimeMax) rNode._nTimeMax = rNodeSrc._nTimeMax;
+    }
+
+    // Most exclusive time first.
+    const ITERATE_t nQtyFlat = flat.get_Count();
+    cArrayVal<ITERATE_t> aSort(nQtyFlat);
+    for (ITERATE_t i = 0; i < nQtyFlat; i++) {
+        ITERATE_t j = i;
+        for (; j > 0 && flat.GetAt(aSort[j - 1])._nTimeExcl < flat.GetAt(i)._nTimeExcl; j--) {
+            aSort[j] = aSort[j - 1];
+        }
+        aSort[j] = i;
+    }
+
+    HRESULT hRes = o.Printf("Calls\tInclusive(us)\tExclusive(us)\tMin(us)\tMax(us)\tFunction\tFile" FILE_EOL);
+    if (FAILED(hRes)) return hRes;
+    for (ITERATE_t i = 0; i < nQtyFlat; i++) {
+        const cCodeProfilerNode& rNode = flat.GetAt(aSort[i]);
+        if (rNode._nCalls <= 0) continue;
+        hRes = o.Printf("%llu\t%llu\t%llu\t%llu\t%llu\t%s\t%s:%u" FILE_EOL, CastN(unsigned long long, rNode._nCalls), CastN(unsigned long long, ToUSec(rNode._nTimeIncl)),
+                        CastN(unsigned long long, ToUSec(rNode._nTimeExcl)), CastN(unsigned long long, ToUSec(rNode._nTimeMin)),
+                        CastN(unsigned long long, ToUSec(rNode._nTimeMax)), rNode._pSrc->_pszFunction, rNode._pSrc->_pszFile, rNode._pSrc->_uLine);
+        if (FAILED(hRes)) return hRes;
+    }
+    if (_nQtyDropped > 0) {
+        hRes = o.Printf("Dropped %u calls. Table full." FILE_EOL, _nQtyDropped);
+    }
+    return hRes;
+}
+
+HRESULT cCodeProfilerTable::WriteFolded(ITextWriter& o) const {
+    HRESULT hRes = S_OK;
+    const ITERATE_t nQty = get_Count();
+    for (ITERATE_t i = 0; i < nQty; i++) {
+        const cCodeProfilerNode& rNode = GetAt(i);
+        const UINT64 nTime = ToUSec(rNode._nTimeExcl);
+        if (nTime <= 0) continue;
+        // Build the stack root first. Use the stack array backwards.
+        const char* apszStack[256];
+        ITERATE_t iDepth = CastN(ITERATE_t, _countof(apszStack));
+        for (ITERATE_t iNode = i; iNode >= 0 && iDepth > 0; iNode = GetAt(iNode)._iParent) {
+            apszStack[--iDepth] = GetAt(iNode)._pSrc->_pszFunction;
+        }
+        char szLine[StrT::k_LEN_Default];
+        StrBuilder<char> s(TOSPAN(szLine));
+        for (ITERATE_t j = iDepth; j < CastN(ITERATE_t, _countof(apszStack)); j++) {
+            if (j > iDepth) s.AddChar(';');
+            s.AddStr(apszStack[j]);
+        }
+        s.AddChar(' ');
+        s.AddUInt(nTime);
+        s.AddStr(FILE_EOL);
+        hRes = o.WriteString(s.get_CPtr());
+        if (FAILED(hRes)) return hRes;
+    }
+    return hRes;
+}
+
+//**************************************************************
 
 /// <summary>
-/// Thread locked singleton stream to write out to. Can be shared by multiple threads.
+/// Stats for a single thread. Only the owner thread records calls.
 /// </summary>
-class GRAYCORE_LINK cCodeProfilerControl final : public cSingleton<cCodeProfilerControl> {
-    friend class cCodeProfileFunc;
+struct cCodeProfilerThread {
+    const THREADID_t _nThreadId;
+    cCodeProfileFunc* _pFuncCur = nullptr;  /// innermost profiled call in progress on this thread.
+    cCodeProfilerTable _Table;
 
- protected:
-    cFile _File;
-    mutable cThreadLockableX _Lock;
-    PROCESSID_t _nProcessId;
+    cCodeProfilerThread(THREADID_t nThreadId, ITERATE_t nQtyNodes) : _nThreadId(nThreadId), _Table(nQtyNodes) {}
+};
 
- protected:
-    DECLARE_cSingleton(cCodeProfilerControl);
-    cCodeProfilerControl() : cSingleton<cCodeProfilerControl>(this), _nProcessId(cAppState::get_CurrentProcessId()) {}
+void cCodeProfileFunc::StartTime() noexcept {
+    cCodeProfilerThread* pThread = cCodeProfilerControl::I().GetThreadCurrent();
+    if (pThread == nullptr) return;  // Busy making the table. don't profile myself.
+    _pThread = pThread;
+    _pParent = pThread->_pFuncCur;
+    _iNode = pThread->_Table.FindNode((_pParent == nullptr) ? -1 : _pParent->_iNode, _pSrc);
+    pThread->_pFuncCur = this;
+    _nTimeStart = cTimePerf(true).get_Perf();  // last. don't count my own overhead.
+}
 
-    bool StartTime() {
-        const auto guard(_Lock.Lock());
-        cCodeProfileFunc::sm_bActive = true;
-        if (_File.isValidHandle()) return true;
-        // open it. PCP file.
-        HRESULT hRes = _File.OpenX(_FN("profile.pcp"), OF_CREATE | OF_SHARE_DENY_NONE | OF_WRITE | OF_BINARY);  // append
-        if (FAILED(hRes)) return false;
-        _File.SeekToEnd();  // Start at end of file
-        return true;
+void cCodeProfileFunc::StopTime() noexcept {
+    //! Record time when this object is destroyed.
+    const TIMEPERF_t nTimeIncl = cTimePerf(true).get_Perf() - _nTimeStart;
+    DEBUG_ASSERT(_pThread->_pFuncCur == this, "_pFuncCur");
+    _pThread->_pFuncCur = _pParent;
+    if (_pParent != nullptr) _pParent->_nTimeChild += nTimeIncl;
+    if (_iNode >= 0) {
+        _pThread->_Table.AddCall(_iNode, nTimeIncl, nTimeIncl - _nTimeChild);
     }
+}
 
-    void StopTime() {
-        const auto guard(_Lock.Lock());
-        cCodeProfileFunc::sm_bActive = false;
-        _File.Close();
+//**************************************************************
+
+/// <summary>
+/// Background thread to write periodic reports. cCodeProfilerControl::StartSnapshots()
+/// </summary>
+class cCodeProfilerSnapshot final : public cThreadRef {
+ public:
+    const cStringF _sFileReport;
+    const cStringF _sFileFolded;
+    const TIMESYSD_t _nInterval;
+
+ public:
+    cCodeProfilerSnapshot(const FILECHAR_t* pszFileReport, const FILECHAR_t* pszFileFolded, TIMESYSD_t nInterval)
+        : _sFileReport(pszFileReport), _sFileFolded(pszFileFolded), _nInterval(nInterval) {}
+
+    HRESULT WriteSnapshot() const {
+        return cCodeProfilerControl::I().WriteSnapshot(_sFileReport.IsEmpty() ? nullptr : _sFileReport.get_CPtr(), _sFileFolded.IsEmpty() ? nullptr : _sFileFolded.get_CPtr());
     }
 
-    void WriteTime(const cTimePerf& nTimeEnd, const class cCodeProfileFunc& Func) noexcept {
-        DEBUG_ASSERT(get_Active(), "Active");
-        if (!_File.isValidHandle()) return;
-        const auto guard(_Lock.Lock());
-        if (!_File.isValidHandle()) return;
+    THREAD_EXITCODE_t Run() override {
+        cTimeSys tLast(cTimeSys::GetTimeNow());
+        while (!isThreadStopping()) {
+            cThreadId::SleepCurrent(cValT::Min<TIMESYSD_t>(_nInterval, 100));  // check isThreadStopping() often.
+            if (tLast.get_AgeSys() < _nInterval) continue;
+            tLast.InitTimeNow();
+            WriteSnapshot();
+        }
+        return THREAD_EXITCODE_OK;
+    }
+};
 
-        const StrLen_t iLenFile = StrT::Len(Func._Src._pszFile);
-        const StrLen_t iLenFunc = StrT::Len(Func._Src._pszFunction);
-        const StrLen_t iLenTotal = sizeof(cCodeProfilerItem) + iLenFile + iLenFunc + 2;
+cSingleton_IMPL(cCodeProfilerControl);
 
-        BYTE tmp[sizeof(cCodeProfilerItem) + 1024];  // pack binary blob.
-        DEBUG_ASSERT(iLenTotal < (StrLen_t)sizeof(tmp), "LenTotal");
+cCodeProfilerControl::cCodeProfilerControl() : cSingleton<cCodeProfilerControl>(this) {}
 
-        cCodeProfilerItem* pLogItem = reinterpret_cast<cCodeProfilerItem*>(tmp);
-        pLogItem->_SizeThis = CastN(WORD, iLenTotal);
-        pLogItem->_uLine = Func._Src._uLine;
-        pLogItem->_nProcessId = _nProcessId;
-        pLogItem->_nThreadId = cThreadId::GetCurrentId();
-        pLogItem->_nCycles = nTimeEnd._nTimePerf - Func._nTimeStart._nTimePerf;
-        // pLogItem->_TimePerf = nTime;
+cCodeProfilerControl::~cCodeProfilerControl() {
+    cCodeProfileFunc::sm_bActive = false;
+    StopSnapshots();
+    // Don't delete the thread tables. Scopes in flight on other threads and the thread local caches still point at them.
+    // Static destruction. Deliberately leak them till the process ends.
+}
 
-        cMem::Copy(tmp + sizeof(cCodeProfilerItem), Func._Src._pszFile, iLenFile + 1);                     // include '\0'
-        cMem::Copy(tmp + sizeof(cCodeProfilerItem) + iLenFile + 1, Func._Src._pszFunction, iLenFunc + 1);  // include '\0'
+cCodeProfilerThread* cCodeProfilerControl::GetThreadCurrent() noexcept {
+    // Find the table for this thread. Usually from the thread local cache. No lock.
+    static thread_local cCodeProfilerThread* s_pThread = nullptr;
+    static thread_local bool s_bBusy = false;
+    if (s_pThread != nullptr) return s_pThread;
+    if (s_bBusy) return nullptr;  // profiled functions called while making the table. (e.g. cHeap)
 
-        _File.WriteX(cMemSpan(tmp, iLenTotal));
+    s_bBusy = true;
+    const THREADID_t nThreadId = cThreadId::GetCurrentId();
+    const auto guard(_Lock.Lock());
+    cCodeProfilerThread* pThread = nullptr;
+    for (cCodeProfilerThread* pThreadTest : _aThreads) {
+        // A new thread may reuse the id of a dead thread. It gets the dead thread's table and adds to its counts. Tables are per id not per thread.
+        if (cThreadId::IsEqualId(pThreadTest->_nThreadId, nThreadId)) {
+            pThread = pThreadTest;
+            break;
+        }
     }
+    if (pThread == nullptr) {
+        const cHeapArenaScope scopeHeap(nullptr);  // outlives any cHeapArena.
+        pThread = new cCodeProfilerThread(nThreadId, _nQtyNodes);
+        _aThreads.Add(pThread);
+    }
+    s_pThread = pThread;
+    s_bBusy = false;
+    return pThread;
+}
 
- public:
-    ~cCodeProfilerControl() {
-        StopTime();
+bool cCodeProfilerControl::put_Active(bool bActive) {
+    cCodeProfileFunc::sm_bActive = bActive;
+    return true;
+}
+
+void cCodeProfilerControl::ClearStats() {
+    const auto guard(_Lock.Lock());
+    for (cCodeProfilerThread* pThread : _aThreads) {
+        pThread->_Table.ClearStats();
     }
-    bool get_Active() const {
-        return cCodeProfileFunc::sm_bActive;
+}
+
+void cCodeProfilerControl::GetSnapshot(cCodeProfilerTable& rTable) const {
+    const auto guard(_Lock.Lock());
+    for (const cCodeProfilerThread* pThread : _aThreads) {
+        rTable.AddTable(pThread->_Table);
     }
+}
 
-    bool put_Active(bool bActive) {
-        if (bActive == get_Active()) return true;
-        if (bActive) return StartTime();
-        StopTime();
-        return true;
+HRESULT cCodeProfilerControl::WriteSnapshot(const FILECHAR_t* pszFileReport, const FILECHAR_t* pszFileFolded) const {
+    ITERATE_t nQty = 0;
+    {
+        const auto guard(_Lock.Lock());
+        for (const cCodeProfilerThread* pThread : _aThreads) {
+            nQty += pThread->_Table.get_Count();
+        }
     }
-};
-cSingleton_IMPL(cCodeProfilerControl);
+    cCodeProfilerTable table(nQty + 16);  // may have grown a bit.
+    GetSnapshot(table);
 
-void cCodeProfileFunc::StopTime() noexcept {
-    //! Record time when this object is destroyed.
-    cTimePerf nTimeEnd(true);  // End cycle count
-    DEBUG_ASSERT(sm_bActive, "bActive");
-    DEBUG_ASSERT(_nTimeStart.isTimeValid(), "nTimeStart");
-    // Write to log file
-    cCodeProfilerControl* pController = cCodeProfilerControl::get_Single();
-    pController->WriteTime(nTimeEnd, *this);
+    HRESULT hRes = S_OK;
+    if (!StrT::IsNullOrEmpty(pszFileReport)) {
+        cFile file;
+        hRes = file.OpenX(pszFileReport, OF_CREATE | OF_WRITE | OF_TEXT);
+        if (FAILED(hRes)) return hRes;
+        hRes = table.WriteReport(file);
+        if (FAILED(hRes)) return hRes;
+    }
+    if (!StrT::IsNullOrEmpty(pszFileFolded)) {
+        cFile file;
+        hRes = file.OpenX(pszFileFolded, OF_CREATE | OF_WRITE | OF_TEXT);
+        if (FAILED(hRes)) return hRes;
+        hRes = table.WriteFolded(file);
+    }
+    return hRes;
+}
+
+HRESULT cCodeProfilerControl::StartSnapshots(const FILECHAR_t* pszFileReport, const FILECHAR_t* pszFileFolded, TIMESYSD_t nInterval) {
+    StopSnapshots();
+    cRefPtr<cCodeProfilerSnapshot> pSnapshot(new cCodeProfilerSnapshot(pszFileReport, pszFileFolded, nInterval));
+    const HRESULT hRes = pSnapshot->CreateThread();
+    if (FAILED(hRes)) return hRes;
+    const auto guard(_Lock.Lock());
+    _pSnapshot = pSnapshot;
+    return hRes;
+}
+
+void cCodeProfilerControl::StopSnapshots() {
+    cRefPtr<cCodeProfilerSnapshot> pSnapshot;
+    {
+        const auto guard(_Lock.Lock());
+        pSnapshot = _pSnapshot;
+        _pSnapshot.ReleasePtr();
+    }
+    if (pSnapshot == nullptr) return;
+    pSnapshot->RequestStopThread();
+    pSnapshot->WaitForThreadExit(10 * cTimeSys::k_FREQ);
+    pSnapshot->WriteSnapshot();  // final.
 }
 }  // namespace Gray
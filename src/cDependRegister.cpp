@@ -9,6 +9,7 @@
 #include "FuncPtr.h"
 #include "cArray.h"
 #include "cDependRegister.h"
+#include "cHeapArena.h"
 #include "cLogMgr.h"
 #include "cOSModImpl.h"
 #include "cSingleton.h"
@@ -127,6 +128,7 @@ void cDependRegister::RegisterSingleton() noexcept {
     const auto guard(cSingletonBase::GetLockAll());  // thread sync critical section all singletons.
     // Prevent re-registering of singletons constructed after SingletonManager shutdown (during exit)
     if (cAppState::isInCExit()) return;
+    const cHeapArenaScope scopeHeap(nullptr);  // _aSingletons outlives any cHeapArena.
     auto& dm = cDependMgr::I();
     dm.AddRegister(*this);
 }
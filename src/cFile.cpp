@@ -5,6 +5,7 @@
 // clang-format on
 #include "PtrCast.h"
 #include "cFile.h"
+#include "cFileAsync.h"
 #include "cFileDir.h"
 #include "cLogMgr.h"
 #include "cString.h"
@@ -231,15 +232,15 @@ HANDLE cFile::DetachHandle() noexcept {
 }
 
 const FILECHAR_t* cFile::get_FileName() const {
-    return cFilePath::GetFileName(get_FilePath().get_SpanStr());
+    return cFilePath::GetFileName(_strFileName.get_SpanStr());  // NOT get_FilePath(). that is a temporary copy.
 }
 
 const FILECHAR_t* cFile::get_FileExt() const {
-    return cFilePath::GetFileNameExt(get_FilePath().get_SpanStr());
+    return cFilePath::GetFileNameExt(_strFileName.get_SpanStr());
 }
 
 bool cFile::IsFileNameExt(const cSpan<FILECHAR_t>& ext) const noexcept {
-    return cFilePath::IsFileNameExt(get_FilePath().get_SpanStr(), ext);
+    return cFilePath::IsFileNameExt(_strFileName.get_SpanStr(), ext);
 }
 
 STREAM_POS_t cFile::GetPosition() const noexcept {  // virtual
@@ -429,6 +430,28 @@ HRESULT cFile::WriteX(const cMemSpan& m) {  // virtual
     return hResLengthWritten;
 }
 
+HRESULT cFile::ReadAtAsync(cFileAsyncReq* pReq, cMemSpan ret, STREAM_POS_t nOffset, IFileAsyncCallback* pCallback) {
+    if (pReq == nullptr || ret.isNull()) return E_POINTER;
+    if (!isValidHandle()) return E_HANDLE;
+    pReq->_hFile = get_Handle();
+    pReq->_Data = ret;
+    pReq->_nOffset = nOffset;
+    pReq->_bWrite = false;
+    pReq->_pCallback = pCallback;
+    return cFileAsync::I().Submit(pReq);
+}
+
+HRESULT cFile::WriteAtAsync(cFileAsyncReq* pReq, const cMemSpan& m, STREAM_POS_t nOffset, IFileAsyncCallback* pCallback) {
+    if (pReq == nullptr || m.isNull()) return E_POINTER;
+    if (!isValidHandle()) return E_HANDLE;
+    pReq->_hFile = get_Handle();
+    pReq->_Data = m;
+    pReq->_nOffset = nOffset;
+    pReq->_bWrite = true;
+    pReq->_pCallback = pCallback;
+    return cFileAsync::I().Submit(pReq);
+}
+
 HRESULT cFile::FlushX() {  // virtual
     //! synchronous flush of write data to file.
     if (!isValidHandle()) return S_OK;
@@ -0,0 +1,388 @@
+//! @file cFileAsync.cpp
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+// clang-format off
+#include "pch.h"
+// clang-format on
+#include "cFileAsync.h"
+#include "cTimeSys.h"
+
+#ifdef USE_IOURING
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>     // mmap()
+#include <sys/syscall.h>  // __NR_io_uring_setup
+#endif
+
+namespace Gray {
+
+#ifdef USE_IOURING
+/// <summary>
+/// io_uring with raw syscalls. Submit from any thread (under _LockSubmit). A single reaper thread drains completions.
+/// cFileAsync limits requests in flight to the ring size so neither ring can overflow.
+/// </summary>
+class cFileAsyncRing final : public cThreadRef {
+    cFileAsync& _rEngine;
+    cThreadLockableX _LockSubmit;  /// protect the submit ring.
+    int _fdRing = -1;
+    void* _pSqMap = nullptr;
+    size_t _nSqMapSize = 0;
+    void* _pCqMap = nullptr;
+    size_t _nCqMapSize = 0;
+    struct ::io_uring_sqe* _pSqes = nullptr;
+    size_t _nSqesSize = 0;
+    UINT32* _pSqHead = nullptr;
+    UINT32* _pSqTail = nullptr;
+    UINT32 _nSqMask = 0;
+    UINT32* _pSqArray = nullptr;
+    UINT32* _pCqHead = nullptr;
+    UINT32* _pCqTail = nullptr;
+    UINT32 _nCqMask = 0;
+    struct ::io_uring_cqe* _pCqes = nullptr;
+
+ private:
+    static BYTE* GetMapPtr(void* pMap, UINT32 nOffset) noexcept {
+        return PtrCast<BYTE>(pMap) + nOffset;
+    }
+
+    /// <summary>
+    /// Submit nQty already in the ring. Retry if the kernel is busy.
+    /// </summary>
+    HRESULT EnterSubmit(UINT32 nQty) noexcept {
+        while (nQty > 0) {
+            const int iRet = CastN(int, ::syscall(__NR_io_uring_enter, _fdRing, nQty, 0, 0, nullptr, 0));
+            if (iRet < 0) {
+                const int iErrNo = errno;
+                if (iErrNo == EINTR || iErrNo == EAGAIN || iErrNo == EBUSY) {
+                    cThreadId::YieldCurrent();
+                    continue;
+                }
+                return HResult::FromPOSIX(iErrNo);  // left in the ring. caller must take them back.
+            }
+            nQty -= CastN(UINT32, iRet);
+        }
+        return S_OK;
+    }
+
+    /// <summary>
+    /// Drain the completion ring.
+    /// </summary>
+    /// <returns>saw the stop NOP.</returns>
+    bool ReapCompletions() noexcept {
+        bool bStop = false;
+        UINT32 nHead = *_pCqHead;
+        const UINT32 nTail = __atomic_load_n(_pCqTail, __ATOMIC_ACQUIRE);
+        for (; nHead != nTail; nHead++) {
+            const struct ::io_uring_cqe& rCqe = _pCqes[nHead & _nCqMask];
+            cFileAsyncReq* pReq = reinterpret_cast<cFileAsyncReq*>(CastN(UINT_PTR, rCqe.user_data));
+            const int iRes = rCqe.res;
+            __atomic_store_n(_pCqHead, nHead + 1, __ATOMIC_RELEASE);  // free the slot.
+            if (pReq == nullptr) {
+                bStop = true;
+                continue;
+            }
+            _rEngine.CompleteReq(pReq, (iRes < 0) ? HResult::FromPOSIX(-iRes) : CastN(HRESULT, iRes));
+        }
+        return bStop;
+    }
+
+ protected:
+    THREAD_EXITCODE_t Run() override {
+        for (;;) {
+            const int iRet = CastN(int, ::syscall(__NR_io_uring_enter, _fdRing, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (ReapCompletions() && isThreadStopping()) break;
+            if (iRet < 0 && errno != EINTR) {
+                if (isThreadStopping()) break;
+                cThreadId::SleepCurrent(1);  // should not happen. don't spin.
+            }
+        }
+        return THREAD_EXITCODE_OK;
+    }
+
+ public:
+    explicit cFileAsyncRing(cFileAsync& rEngine) noexcept : _rEngine(rEngine) {}
+    ~cFileAsyncRing() override {
+        CloseRing();
+    }
+
+    HRESULT OpenRing(UINT32 nEntries) noexcept {
+        struct ::io_uring_params params;
+        cMem::Zero(&params, sizeof(params));
+        _fdRing = CastN(int, ::syscall(__NR_io_uring_setup, nEntries, &params));
+        if (_fdRing < 0) return HResult::GetPOSIXLastDef(E_NOTIMPL);  // ENOSYS = old kernel or blocked.
+
+        _nSqMapSize = params.sq_off.array + params.sq_entries * sizeof(UINT32);
+        _nCqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(struct ::io_uring_cqe);
+        const bool bSingleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (bSingleMap) {
+            _nSqMapSize = cValT::Max(_nSqMapSize, _nCqMapSize);
+            _nCqMapSize = 0;
+        }
+        _pSqMap = ::mmap(nullptr, _nSqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fdRing, IORING_OFF_SQ_RING);
+        if (_pSqMap == MAP_FAILED) {
+            _pSqMap = nullptr;
+            return HResult::GetPOSIXLastDef(E_OUTOFMEMORY);
+        }
+        if (bSingleMap) {
+            _pCqMap = _pSqMap;
+        } else {
+            _pCqMap = ::mmap(nullptr, _nCqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fdRing, IORING_OFF_CQ_RING);
+            if (_pCqMap == MAP_FAILED) {
+                _pCqMap = nullptr;
+                return HResult::GetPOSIXLastDef(E_OUTOFMEMORY);
+            }
+        }
+        _nSqesSize = params.sq_entries * sizeof(struct ::io_uring_sqe);
+        void* pSqes = ::mmap(nullptr, _nSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fdRing, IORING_OFF_SQES);
+        if (pSqes == MAP_FAILED) return HResult::GetPOSIXLastDef(E_OUTOFMEMORY);
+        _pSqes = PtrCast<struct ::io_uring_sqe>(pSqes);
+
+        _pSqHead = PtrCast<UINT32>(GetMapPtr(_pSqMap, params.sq_off.head));
+        _pSqTail = PtrCast<UINT32>(GetMapPtr(_pSqMap, params.sq_off.tail));
+        _nSqMask = *PtrCast<UINT32>(GetMapPtr(_pSqMap, params.sq_off.ring_mask));
+        _pSqArray = PtrCast<UINT32>(GetMapPtr(_pSqMap, params.sq_off.array));
+        _pCqHead = PtrCast<UINT32>(GetMapPtr(_pCqMap, params.cq_off.head));
+        _pCqTail = PtrCast<UINT32>(GetMapPtr(_pCqMap, params.cq_off.tail));
+        _nCqMask = *PtrCast<UINT32>(GetMapPtr(_pCqMap, params.cq_off.ring_mask));
+        _pCqes = PtrCast<struct ::io_uring_cqe>(GetMapPtr(_pCqMap, params.cq_off.cqes));
+
+        return CreateThread();
+    }
+
+    void CloseRing() noexcept {
+        if (_pSqes != nullptr) ::munmap(_pSqes, _nSqesSize);
+        if (_pCqMap != nullptr && _pCqMap != _pSqMap) ::munmap(_pCqMap, _nCqMapSize);
+        if (_pSqMap != nullptr) ::munmap(_pSqMap, _nSqMapSize);
+        if (_fdRing >= 0) ::close(_fdRing);
+        _pSqes = nullptr;
+        _pCqMap = nullptr;
+        _pSqMap = nullptr;
+        _fdRing = -1;
+    }
+
+    /// <summary>
+    /// Queue a batch and submit with a single syscall. Caller reserved room in cFileAsync.
+    /// On failure the ones the kernel did not take are taken back out of the ring. so they never run.
+    /// </summary>
+    /// <param name="nSubmitted">how many the kernel took. the first nSubmitted of ppReqs.</param>
+    HRESULT SubmitRing(cFileAsyncReq* const* ppReqs, ITERATE_t nQty, OUT ITERATE_t& nSubmitted) noexcept {
+        const auto guard(_LockSubmit.Lock());
+        const UINT32 nTail = *_pSqTail;  // only we write the tail.
+        for (ITERATE_t i = 0; i < nQty; i++) {
+            cFileAsyncReq* pReq = ppReqs[i];
+            const UINT32 nIndex = (nTail + CastN(UINT32, i)) & _nSqMask;
+            struct ::io_uring_sqe* pSqe = &_pSqes[nIndex];
+            cMem::Zero(pSqe, sizeof(*pSqe));
+            if (pReq == nullptr) {
+                pSqe->opcode = IORING_OP_NOP;  // wake the reaper to stop.
+            } else {
+                pReq->_iov.iov_base = pReq->_Data.get_BytePtrW();
+                pReq->_iov.iov_len = pReq->_Data.get_SizeBytes();
+                pSqe->opcode = pReq->_bWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+                pSqe->fd = pReq->_hFile;
+                pSqe->addr = CastN(UINT64, CastPtrToNum(&pReq->_iov));
+                pSqe->len = 1;
+                pSqe->off = pReq->_nOffset;
+                pSqe->user_data = CastN(UINT64, CastPtrToNum(pReq));
+            }
+            _pSqArray[nIndex] = nIndex;
+        }
+        __atomic_store_n(_pSqTail, nTail + CastN(UINT32, nQty), __ATOMIC_RELEASE);  // publish to the kernel.
+        const HRESULT hRes = EnterSubmit(CastN(UINT32, nQty));
+        if (FAILED(hRes)) {
+            // The kernel only reads the ring inside io_uring_enter() so it is safe to move the tail back. Everything before nTail was taken.
+            const UINT32 nTaken = __atomic_load_n(_pSqHead, __ATOMIC_ACQUIRE) - nTail;
+            __atomic_store_n(_pSqTail, nTail + nTaken, __ATOMIC_RELEASE);
+            nSubmitted = CastN(ITERATE_t, nTaken);
+            return hRes;
+        }
+        nSubmitted = nQty;
+        return S_OK;
+    }
+
+    void StopRing() noexcept {
+        RequestStopThread();
+        cFileAsyncReq* pStop = nullptr;
+        ITERATE_t nSubmitted = 0;
+        SubmitRing(&pStop, 1, nSubmitted);
+        WaitForThreadExit(cTimeSys::k_INF);
+    }
+};
+#else
+class cFileAsyncRing final : public cRefBase {};  // not available.
+#endif
+
+//**************************************************************
+
+cSingleton_IMPL(cFileAsync);
+
+cFileAsync::cFileAsync() : cSingleton<cFileAsync>(this) {}
+
+cFileAsync::~cFileAsync() {
+    Stop();
+}
+
+HRESULT GRAYCALL cFileAsync::RunReqSync(cFileAsyncReq* pReq) noexcept {  // static
+    // Positional. Don't move the file position.
+    if (pReq->_Data.isEmpty()) return 0;
+#ifdef _WIN32
+    // OVERLAPPED on a synchronous handle moves the file position. Put it back. Not atomic with other requests on the same handle.
+    ::LARGE_INTEGER nPosPrev;
+    nPosPrev.QuadPart = 0;
+    const bool bPosPrev = ::SetFilePointerEx(pReq->_hFile, nPosPrev, &nPosPrev, FILE_CURRENT);
+    ::OVERLAPPED ov;
+    cMem::Zero(&ov, sizeof(ov));
+    ov.Offset = CastN(DWORD, pReq->_nOffset);
+    ov.OffsetHigh = CastN(DWORD, CastN(UINT64, pReq->_nOffset) >> 32);
+    DWORD nLengthDone = 0;
+    const bool bRet = pReq->_bWrite ? ::WriteFile(pReq->_hFile, pReq->_Data.get_BytePtrC(), CastN(DWORD, pReq->_Data.get_SizeBytes()), &nLengthDone, &ov)
+                                    : ::ReadFile(pReq->_hFile, pReq->_Data.get_BytePtrW(), CastN(DWORD, pReq->_Data.get_SizeBytes()), &nLengthDone, &ov);
+    const HRESULT hRes = bRet ? CastN(HRESULT, nLengthDone) : HResult::GetLastDef(HRESULT_WIN32_C(pReq->_bWrite ? ERROR_WRITE_FAULT : ERROR_READ_FAULT));
+    if (bPosPrev) ::SetFilePointerEx(pReq->_hFile, nPosPrev, nullptr, FILE_BEGIN);
+    return (hRes == HRESULT_WIN32_C(ERROR_HANDLE_EOF)) ? 0 : hRes;
+#else
+    const ssize_t nLengthDone = pReq->_bWrite ? ::pwrite(pReq->_hFile, pReq->_Data.get_BytePtrC(), pReq->_Data.get_SizeBytes(), CastN(off_t, pReq->_nOffset))
+                                              : ::pread(pReq->_hFile, pReq->_Data.get_BytePtrW(), pReq->_Data.get_SizeBytes(), CastN(off_t, pReq->_nOffset));
+    if (nLengthDone < 0) return HResult::GetPOSIXLastDef(HRESULT_WIN32_C(pReq->_bWrite ? ERROR_WRITE_FAULT : ERROR_READ_FAULT));
+    return CastN(HRESULT, nLengthDone);
+#endif
+}
+
+void cFileAsync::CompleteReq(cFileAsyncReq* pReq, HRESULT hResult) noexcept {
+    pReq->_hResult = hResult;
+    IFileAsyncCallback* pCallback = pReq->_pCallback;
+    if (pCallback == nullptr) {
+        const auto guard(_Lock.Lock());
+        _aDone.Add(pReq);
+    }
+    // Make room before the callback. It may Submit() more. and this may be the only thread that completes requests.
+    InterlockedN::Decrement(&_nQtyInFlight);
+    cThreadLockable::WakeAddr(&_nWakeSeq);
+    if (pCallback != nullptr) {
+        pCallback->onFileAsyncComplete(pReq);
+    }
+    pReq->DecRefCount();  // taken in Submit().
+}
+
+HRESULT cFileAsync::Start(ITERATE_t nQtyMax, bool bUseRing) {
+    const auto guard(_Lock.Lock());
+    if (isStarted()) return S_FALSE;
+    if (nQtyMax <= 0) nQtyMax = k_nQtyMaxDef;
+#ifdef USE_IOURING
+    if (bUseRing) {
+        cRefPtr<cFileAsyncRing> pRing(new cFileAsyncRing(*this));
+        const HRESULT hRes = pRing->OpenRing(CastN(UINT32, nQtyMax));
+        if (SUCCEEDED(hRes)) {
+            _pRing = pRing;
+        }
+        // else fall back to the pool.
+    }
+#else
+    UNREFERENCED_PARAMETER(bUseRing);
+#endif
+    if (!isRing()) {
+        // Blocking I/O so more threads than CPUs is fine. one per request in flight up to a point.
+        const HRESULT hRes = _Pool.StartWorkers(cValT::Min<ITERATE_t>(nQtyMax, 64));
+        if (FAILED(hRes)) return hRes;
+    }
+    _nQtyMax = nQtyMax;
+    return S_OK;
+}
+
+void cFileAsync::Stop() {
+    WaitIdle();
+    const auto guard(_Lock.Lock());
+    if (!isStarted()) return;
+#ifdef USE_IOURING
+    if (isRing()) {
+        _pRing->StopRing();
+        _pRing.ReleasePtr();
+    }
+#endif
+    _Pool.StopWorkers();
+    _nQtyMax = 0;
+}
+
+HRESULT cFileAsync::Submit(cFileAsyncReq* const* ppReqs, ITERATE_t nQty) {
+    if (!isStarted()) {
+        const HRESULT hRes = Start();
+        if (FAILED(hRes)) return hRes;
+    }
+    for (ITERATE_t i = 0; i < nQty;) {
+        // Reserve room for as many as we can. Wait for at least one.
+        ITERATE_t nChunk = 0;
+        for (;;) {
+            const INTER32_t nInFlight = _nQtyInFlight;
+            const INTER32_t nFree = CastN(INTER32_t, _nQtyMax) - nInFlight;
+            if (nFree > 0) {
+                nChunk = cValT::Min<ITERATE_t>(nFree, nQty - i);
+                if (InterlockedN::CompareExchange(&_nQtyInFlight, nInFlight + CastN(INTER32_t, nChunk), nInFlight) == nInFlight) break;
+                continue;
+            }
+            const INTER32_t nWakeSeq = _nWakeSeq;
+            if (_nQtyInFlight >= CastN(INTER32_t, _nQtyMax)) cThreadLockable::ParkAddr(&_nWakeSeq, nWakeSeq, 10);
+        }
+
+        for (ITERATE_t j = 0; j < nChunk; j++) {
+            cFileAsyncReq* pReq = ppReqs[i + j];
+            ASSERT_NN(pReq);
+            pReq->_hResult = HRESULT_WIN32_C(ERROR_IO_INCOMPLETE);
+            pReq->IncRefCount();  // held till CompleteReq().
+        }
+#ifdef USE_IOURING
+        if (isRing()) {
+            ITERATE_t nSubmitted = 0;
+            const HRESULT hRes = _pRing->SubmitRing(ppReqs + i, nChunk, nSubmitted);
+            if (FAILED(hRes)) {
+                // Undo the room and references for the ones that never went in.
+                for (ITERATE_t j = nSubmitted; j < nChunk; j++) {
+                    cFileAsyncReq* pReq = ppReqs[i + j];
+                    pReq->_hResult = hRes;
+                    pReq->DecRefCount();
+                }
+                InterlockedN::ExchangeAdd(&_nQtyInFlight, -CastN(INTER32_t, nChunk - nSubmitted));
+                cThreadLockable::WakeAddr(&_nWakeSeq);
+                i += nSubmitted;
+                return (i > 0) ? CastN(HRESULT, i) : hRes;  // the first i are in flight.
+            }
+            i += nChunk;
+            continue;
+        }
+#endif
+        for (ITERATE_t j = 0; j < nChunk; j++) {
+            cFileAsyncReq* pReq = ppReqs[i + j];
+            _Pool.SubmitFunc([this, pReq]() { CompleteReq(pReq, RunReqSync(pReq)); });
+        }
+        i += nChunk;
+    }
+    return CastN(HRESULT, nQty);
+}
+
+cRefPtr<cFileAsyncReq> cFileAsync::GetCompletion() {
+    const auto guard(_Lock.Lock());
+    if (_aDone.isEmpty()) return nullptr;
+    return _aDone.PopHead();
+}
+
+cRefPtr<cFileAsyncReq> cFileAsync::WaitCompletion(TIMESYSD_t nTimeWait) {
+    const cTimeSys tStart(cTimeSys::GetTimeNow());
+    for (;;) {
+        const INTER32_t nWakeSeq = _nWakeSeq;
+        cRefPtr<cFileAsyncReq> pReq = GetCompletion();
+        if (pReq != nullptr) return pReq;
+        TIMESYSD_t nWait = 10;  // wakes only wake one. so don't sleep long.
+        if (nTimeWait != cTimeSys::k_INF) {
+            const TIMESYSD_t nLeft = nTimeWait - tStart.get_AgeSys();
+            if (nLeft <= 0) return nullptr;
+            nWait = cValT::Min(nWait, nLeft);
+        }
+        cThreadLockable::ParkAddr(&_nWakeSeq, nWakeSeq, nWait);
+    }
+}
+
+void cFileAsync::WaitIdle() {
+    while (_nQtyInFlight > 0) {
+        const INTER32_t nWakeSeq = _nWakeSeq;
+        if (_nQtyInFlight > 0) cThreadLockable::ParkAddr(&_nWakeSeq, nWakeSeq, 10);
+    }
+}
+}  // namespace Gray
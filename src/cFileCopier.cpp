@@ -6,10 +6,96 @@
 #include "cFileCopier.h"
 #include "cFileDir.h"
 
+#ifdef __linux__
+#include <errno.h>
+#include <linux/fs.h>      // FICLONE
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>  // sendfile()
+#endif
+
 namespace Gray {
+HRESULT GRAYCALL cFileCopier::CopyFileHandle(cFile& fileSrc, cFile& fileDst, STREAM_POS_t nOffsetStart, STREAM_POS_t nSize, IStreamProgressCallback* pProgress) {  // static
+    //! Copy nSize bytes at nOffsetStart from fileSrc to the same place in fileDst. Let the kernel do it if it can.
+    //! 1. FICLONE = reflink. share the extents. whole file only. btrfs, xfs.
+    //! 2. copy_file_range() = no copy to user space. may be offloaded by the file system. NFS, SMB.
+    //! 3. sendfile() = older kernels or across file systems.
+    //! 4. large block read/write.
+    //! Does not use or move the file positions. except sendfile() moves fileDst.
+    //! @return S_OK or -lt- 0 = error. ERROR_HANDLE_EOF = fileSrc is shorter than nSize.
+
+    STREAM_POS_t nDone = 0;
+#ifdef __linux__
+    const ::HANDLE hSrc = fileSrc.get_Handle();
+    const ::HANDLE hDst = fileDst.get_Handle();
+#ifdef FICLONE
+    if (nOffsetStart == 0 && nSize > 0 && nSize == fileSrc.GetLength() && ::ioctl(hDst, FICLONE, hSrc) == 0) {
+        if (pProgress != nullptr) {
+            const HRESULT hResProg = pProgress->onProgressCallback(cStreamProgress(nSize, nSize));
+            if (FAILED(hResProg)) return hResProg;
+        }
+        return S_OK;  // one step.
+    }
+#endif
+    bool bCopyRange = true;
+    bool bSendFile = true;
+    while (nDone < nSize && (bCopyRange || bSendFile)) {
+        const size_t nSizeChunk = CastN(size_t, cValT::Min<STREAM_POS_t>(k_nSizeChunk, nSize - nDone));
+        ssize_t nRet;
+        if (bCopyRange) {
+            ::loff_t nPosIn = CastN(::loff_t, nOffsetStart + nDone);
+            ::loff_t nPosOut = nPosIn;
+            nRet = ::copy_file_range(hSrc, &nPosIn, hDst, &nPosOut, nSizeChunk, 0);
+            if (nRet < 0 && nDone == 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+                bCopyRange = false;  // old kernel or across file systems.
+                continue;
+            }
+        } else {
+            ::off_t nPosIn = CastN(::off_t, nOffsetStart + nDone);
+            if (::lseek(hDst, nPosIn, SEEK_SET) < 0) return HResult::GetPOSIXLastDef(HRESULT_WIN32_C(ERROR_WRITE_FAULT));
+            nRet = ::sendfile(hDst, hSrc, &nPosIn, nSizeChunk);
+            if (nRet < 0 && nDone == 0 && (errno == EINVAL || errno == ENOSYS)) {
+                bSendFile = false;  // not supported for these files.
+                continue;
+            }
+        }
+        if (nRet < 0) return HResult::GetPOSIXLastDef(HRESULT_WIN32_C(ERROR_WRITE_FAULT));
+        if (nRet == 0) return HRESULT_WIN32_C(ERROR_HANDLE_EOF);  // source got shorter?
+        nDone += CastN(STREAM_POS_t, nRet);
+        if (pProgress != nullptr) {
+            const HRESULT hResProg = pProgress->onProgressCallback(cStreamProgress(nDone, nSize));
+            if (FAILED(hResProg)) return hResProg;  // cancel.
+        }
+    }
+#endif
+
+    if (nDone < nSize) {
+        // Kernel can't do it. Copy large blocks via user space.
+        cBlob blob(k_nSizeBlock);
+        while (nDone < nSize) {
+            const size_t nSizeBlock = CastN(size_t, cValT::Min<STREAM_POS_t>(k_nSizeBlock, nSize - nDone));
+            const HRESULT hResRead = fileSrc.ReadAt(cMemSpan(blob, nSizeBlock), nOffsetStart + nDone);
+            if (FAILED(hResRead)) return hResRead;
+            if (hResRead == 0) return HRESULT_WIN32_C(ERROR_HANDLE_EOF);
+            for (HRESULT nWritten = 0; nWritten < hResRead;) {
+                const HRESULT hResWrite = fileDst.WriteAt(cMemSpan(blob.get_BytePtrC() + nWritten, CastN(size_t, hResRead - nWritten)), nOffsetStart + nDone + nWritten);
+                if (FAILED(hResWrite)) return hResWrite;
+                if (hResWrite == 0) return HRESULT_WIN32_C(ERROR_WRITE_FAULT);
+                nWritten += hResWrite;
+            }
+            nDone += hResRead;
+            if (pProgress != nullptr) {
+                const HRESULT hResProg = pProgress->onProgressCallback(cStreamProgress(nDone, nSize));
+                if (FAILED(hResProg)) return hResProg;  // cancel.
+            }
+        }
+    }
+    return S_OK;
+}
+
 HRESULT GRAYCALL cFileCopier::CopyFileStream(cStreamInput& stmIn, const FILECHAR_t* pszDstFileName, bool bFailIfExists, IStreamProgressCallback* pProgress, FILE_SIZE_t nOffsetStart) {
     //! Copy this (opened OF_READ) file to some other file name/path. (pszDstFileName)
-    //! manually read/copy the contents of the file via WriteStream().
+    //! manually read/copy the contents of the file via WriteStream(). Or CopyFileHandle() if stmIn is exactly a cFile.
+    //! Copies from the current position of stmIn. (or nOffsetStart)
     //! Similar effect to cFile::CopyFileX()
 
     HRESULT hRes;
@@ -32,7 +118,23 @@ HRESULT GRAYCALL cFileCopier::CopyFileStream(cStreamInput& stmIn, const FILECHAR
         if (FAILED(hRes)) return hRes;
     }
 
-    hRes = fileDst.WriteStream(stmIn, fileDst.GetLength(), pProgress);
+    const STREAM_POS_t nLengthSrc = stmIn.GetLength();
+    const STREAM_POS_t nPosSrc = stmIn.GetPosition();  // may have been preset by the caller.
+    if (nLengthSrc == k_STREAM_POS_ERR || nPosSrc == k_STREAM_POS_ERR || nLengthSrc < nPosSrc) {
+        hRes = fileDst.WriteStream(stmIn, k_STREAM_POS_ERR, pProgress);  // unknown length. till EOF.
+        if (FAILED(hRes)) return hRes;
+        return S_OK;
+    }
+
+    // Exactly cFile. Not a derived type like cFileText that buffers or translates. And same place in both. CopyFileHandle() can't shift.
+    if (typeid(stmIn) == typeid(cFile) && nPosSrc == nOffsetStart) {
+        hRes = CopyFileHandle(static_cast<cFile&>(stmIn), fileDst, nPosSrc, nLengthSrc - nPosSrc, pProgress);
+        if (FAILED(hRes)) return hRes;
+        stmIn.SeekX(CastN(STREAM_OFFSET_t, nLengthSrc), SEEK_t::_Set);  // as if read.
+        return S_OK;
+    }
+
+    hRes = fileDst.WriteStream(stmIn, nLengthSrc - nPosSrc, pProgress);
     if (FAILED(hRes)) return hRes;
 
     return S_OK;
@@ -90,10 +192,7 @@ HRESULT GRAYCALL cFileCopier::CopyFileX(const FILECHAR_t* pszSrcName, const FILE
     }
     return S_OK;
 #else
-    // copyfile() ?? in C++17
-    // sendfile()  will send up to 2G
-
-    // Fallback to stream file.
+    // CopyFileStream() uses the kernel copy. CopyFileHandle()
     cFile fileSrc;
     HRESULT hRes = fileSrc.OpenX(pszSrcName, OF_READ | OF_BINARY);
     if (FAILED(hRes)) return hRes;
@@ -450,7 +450,8 @@ HRESULT cFileDir::ReadDirPreferredExt(const FILECHAR_t* pszFilePath, const cSpan
     cFileDirEntry* aEntries[k_ExtMax];  // sorted by extension.
     cMem::Zero(aEntries, sizeof(aEntries));
     for (int i = 0; i < (int)hFiles; i++) {
-        const FILECHAR_t* pszExt = cFilePath::GetFileNameExt(_aFiles.GetAt(i).get_Name().get_SpanStr());
+        const cStringF sName = _aFiles.GetAt(i).get_Name();  // keep the copy alive. pszExt points into it.
+        const FILECHAR_t* pszExt = cFilePath::GetFileNameExt(sName.get_SpanStr());
         if (pszExt == nullptr) continue;
         const ITERATE_t iExt = StrT::SpanFind(pszExt, exts);
         if (IS_INDEX_BAD_ARRAY(iExt, aEntries)) continue;
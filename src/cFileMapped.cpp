@@ -0,0 +1,240 @@
+//! @file cFileMapped.cpp
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+// clang-format off
+#include "pch.h"
+// clang-format on
+#include "cFileMapped.h"
+#include "cSystemInfo.h"
+
+#ifdef __linux__
+#include <sys/mman.h>  // mmap()
+#endif
+
+namespace Gray {
+
+size_t GRAYCALL cFileMapped::get_Granularity() noexcept {  // static
+    // Window offsets must be aligned to this.
+#ifdef _WIN32
+    return cSystemInfo::I()._SystemInfo.dwAllocationGranularity;  // 64K
+#else
+    return cSystemInfo::I().get_PageSize();
+#endif
+}
+
+void cFileMapped::UnmapWindow() noexcept {
+    if (_pWindow == nullptr) return;
+#ifdef _WIN32
+    ::UnmapViewOfFile(_pWindow);
+#else
+    ::munmap(_pWindow, _nWindowSize);
+#endif
+    _pWindow = nullptr;
+    _nWindowSize = 0;
+    _nWindowPos = 0;
+}
+
+void cFileMapped::AdviseWindow() noexcept {
+    if (_pWindow == nullptr) return;
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602  // Win8
+    if (_eAdvise == FILEMAP_ADVISE_t::_WillNeed || _eAdvise == FILEMAP_ADVISE_t::_Sequential) {
+        ::WIN32_MEMORY_RANGE_ENTRY range;
+        range.VirtualAddress = _pWindow;
+        range.NumberOfBytes = _nWindowSize;
+        ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+    }
+#endif
+    // Other hints have no equivalent for mapped views.
+#else
+    int iAdvice = MADV_NORMAL;
+    switch (_eAdvise) {
+        case FILEMAP_ADVISE_t::_Sequential:
+            iAdvice = MADV_SEQUENTIAL;
+            break;
+        case FILEMAP_ADVISE_t::_Random:
+            iAdvice = MADV_RANDOM;
+            break;
+        case FILEMAP_ADVISE_t::_WillNeed:
+            iAdvice = MADV_WILLNEED;
+            break;
+        case FILEMAP_ADVISE_t::_DontNeed:
+            iAdvice = MADV_DONTNEED;
+            break;
+        default:
+            break;
+    }
+    ::madvise(_pWindow, _nWindowSize, iAdvice);
+#endif
+}
+
+HRESULT cFileMapped::MapWindow(STREAM_POS_t nPos, size_t nSizeMin) noexcept {
+    if (nPos >= _nSizeFile) return S_FALSE;  // EOF. nothing to map.
+    const STREAM_POS_t nPosEnd = (nSizeMin >= _nSizeFile - nPos) ? _nSizeFile : (nPos + nSizeMin);
+    if (_pWindow != nullptr && nPos >= _nWindowPos && nPosEnd <= _nWindowPos + _nWindowSize) return S_OK;  // already have it.
+
+    UnmapWindow();
+    STREAM_POS_t nWindowPos = 0;
+    STREAM_POS_t nWindowEnd = _nSizeFile;
+    if (_nSizeWindowMax > 0) {
+        const size_t nAlign = get_Granularity();
+        nWindowPos = nPos - (nPos % nAlign);
+        nWindowEnd = cValT::Max<STREAM_POS_t>(nWindowPos + _nSizeWindowMax, nPosEnd);
+        if (nWindowEnd > _nSizeFile) nWindowEnd = _nSizeFile;
+    }
+    const size_t nWindowSize = CastN(size_t, nWindowEnd - nWindowPos);
+
+#ifdef _WIN32
+    void* pWindow = ::MapViewOfFile(_hMapping, FILE_MAP_READ, CastN(DWORD, CastN(UINT64, nWindowPos) >> 32), CastN(DWORD, nWindowPos), nWindowSize);
+    if (pWindow == nullptr) return HResult::GetLastDef(E_OUTOFMEMORY);
+#else
+    void* pWindow = ::mmap(nullptr, nWindowSize, PROT_READ, MAP_PRIVATE, _File.get_Handle(), CastN(off_t, nWindowPos));
+    if (pWindow == MAP_FAILED) return HResult::GetPOSIXLastDef(E_OUTOFMEMORY);
+#endif
+    _pWindow = PtrCast<BYTE>(pWindow);
+    _nWindowPos = nWindowPos;
+    _nWindowSize = nWindowSize;
+    AdviseWindow();
+    return S_OK;
+}
+
+HRESULT cFileMapped::OpenX(cStringF sFilePath, size_t nSizeWindowMax) {
+    Close();
+    HRESULT hRes = _File.OpenX(sFilePath, OF_READ | OF_SHARE_DENY_NONE);
+    if (FAILED(hRes)) return hRes;
+    _nSizeFile = _File.GetLength();
+    if (_nSizeFile == k_STREAM_POS_ERR) {
+        Close();
+        return E_FAIL;
+    }
+
+    if (nSizeWindowMax == 0 && _nSizeFile > cTypeLimit<size_t>::Max() / 4) {
+        nSizeWindowMax = k_nSizeWindowDef;  // won't fit the address space. use windows.
+    }
+    if (nSizeWindowMax > 0) {
+        const size_t nAlign = get_Granularity();
+        nSizeWindowMax = ((nSizeWindowMax + nAlign - 1) / nAlign) * nAlign;
+    }
+    _nSizeWindowMax = nSizeWindowMax;
+
+    if (_nSizeFile <= 0) return S_OK;  // can't map 0 bytes. just EOF.
+#ifdef _WIN32
+    _hMapping = ::CreateFileMappingW(_File.get_Handle(), nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_hMapping == NULL) {
+        hRes = HResult::GetLastDef(E_HANDLE);
+        Close();
+        return hRes;
+    }
+#endif
+    hRes = MapWindow(0, 1);
+    if (FAILED(hRes)) {
+        Close();
+        return hRes;
+    }
+    return S_OK;
+}
+
+void cFileMapped::Close() noexcept {
+    UnmapWindow();
+#ifdef _WIN32
+    if (_hMapping != NULL) {
+        ::CloseHandle(_hMapping);
+        _hMapping = NULL;
+    }
+#endif
+    _File.Close();
+    _nSizeFile = 0;
+    _nPos = 0;
+}
+
+HRESULT cFileMapped::Advise(FILEMAP_ADVISE_t eAdvise) noexcept {
+    _eAdvise = eAdvise;
+    if (_pWindow == nullptr) return S_FALSE;
+    AdviseWindow();
+    return S_OK;
+}
+
+cMemSpan cFileMapped::GetSpanAt(STREAM_POS_t nPos, size_t nSizeMin) noexcept {
+    if (MapWindow(nPos, nSizeMin) != S_OK) return cMemSpan();
+    const size_t nOffset = CastN(size_t, nPos - _nWindowPos);
+    return cMemSpan(_pWindow + nOffset, _nWindowSize - nOffset);
+}
+
+cMemSpan cFileMapped::get_Span() noexcept {
+    if (_nSizeWindowMax > 0) return cMemSpan();  // windowed.
+    return GetSpanAt(0, 1);
+}
+
+HRESULT cFileMapped::ReadX(cMemSpan ret) noexcept {  // override
+    if (ret.isEmpty()) return 0;
+    if (_nPos >= _nSizeFile) return 0;  // EOF
+    const size_t nSizeRead = CastN(size_t, cValT::Min<STREAM_POS_t>(ret.get_SizeBytes(), _nSizeFile - _nPos));
+    if (ret.isNull()) {
+        _nPos += nSizeRead;  // just skip it.
+        return CastN(HRESULT, nSizeRead);
+    }
+
+    BYTE* pOut = ret.get_BytePtrW();
+    size_t nDone = 0;
+    while (nDone < nSizeRead) {
+        const cMemSpan span = GetSpanAt(_nPos, 1);  // don't force a big window. just copy across windows.
+        if (span.isEmpty()) break;
+        const size_t nSizeCopy = cValT::Min(span.get_SizeBytes(), nSizeRead - nDone);
+        cMem::Copy(pOut + nDone, span.get_BytePtrC(), nSizeCopy);
+        nDone += nSizeCopy;
+        _nPos += nSizeCopy;
+    }
+    return CastN(HRESULT, nDone);
+}
+
+HRESULT cFileMapped::ReadPeek(cMemSpan ret) noexcept {  // override
+    const STREAM_POS_t nPos = _nPos;
+    const HRESULT hRes = ReadX(ret);
+    _nPos = nPos;
+    return hRes;
+}
+
+HRESULT cFileMapped::ReadStringLine(cSpanX<char> ret) {  // override
+    //! Find the "\n" in the mapping and copy the line once.
+    //! @return length of the string in chars (includes "\n"). 0 = EOF. RPC_S_STRING_TOO_LONG = no "\n" in ret.
+
+    char* pWrite = ret.get_PtrWork();
+    if (pWrite == nullptr) return E_POINTER;
+    const StrLen_t iSizeMax = ret.get_MaxLen() - 1;
+    if (iSizeMax <= 0) return HRESULT_WIN32_C(RPC_S_STRING_TOO_LONG);
+
+    const cMemSpan span = GetSpanAt(_nPos, CastN(size_t, iSizeMax));
+    const size_t nSizeScan = cValT::Min<size_t>(span.get_SizeBytes(), CastN(size_t, iSizeMax));
+    const BYTE* pStart = span.get_BytePtrC();
+    const BYTE* pEnd = (nSizeScan > 0) ? PtrCast<BYTE>(::memchr(pStart, '\n', nSizeScan)) : nullptr;
+    size_t nSizeLine;
+    if (pEnd != nullptr) {
+        nSizeLine = CastN(size_t, pEnd - pStart) + 1;  // include it.
+    } else if (nSizeScan < CastN(size_t, iSizeMax)) {
+        nSizeLine = nSizeScan;  // last line has no "\n". or EOF.
+    } else {
+        pWrite[0] = '\0';
+        return HRESULT_WIN32_C(RPC_S_STRING_TOO_LONG);
+    }
+
+    cMem::Copy(pWrite, pStart, nSizeLine);
+    pWrite[nSizeLine] = '\0';
+    _nPos += nSizeLine;
+    return CastN(HRESULT, nSizeLine);
+}
+
+HRESULT cFileMapped::SeekX(STREAM_OFFSET_t nOffset, SEEK_t eSeekOrigin) noexcept {  // override
+    switch (eSeekOrigin) {
+        case SEEK_t::_Cur:
+            nOffset += CastN(STREAM_OFFSET_t, _nPos);
+            break;
+        case SEEK_t::_End:
+            nOffset += CastN(STREAM_OFFSET_t, _nSizeFile);
+            break;
+        default:
+            break;
+    }
+    if (nOffset < 0 || CastN(STREAM_POS_t, nOffset) > _nSizeFile) return E_INVALIDARG;
+    _nPos = CastN(STREAM_POS_t, nOffset);  // window moves on demand.
+    return CastN(HRESULT, _nPos);
+}
+}  // namespace Gray
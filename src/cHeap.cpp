@@ -7,6 +7,7 @@
 #include "cCodeProfiler.h"
 #include "cHeap.h"
 #include "cLogMgr.h"
+#include "cThreadLock.h"
 
 #if !defined(UNDER_CE) && USE_CRT
 #include <malloc.h>  // malloc_usable_size() or _msize()
@@ -17,10 +18,223 @@
 
 namespace Gray {
 cHeapStats cHeapCommon::g_Stats;
+bool cHeapCommon::sm_bThreadCache = false;
 #ifdef _WIN32
 ::HANDLE cHeapCommon::g_hHeap = ::GetProcessHeap();  // Global singleton.
 #endif
 
+static inline void* HeapAllocBlock(size_t nSize) noexcept {
+#if defined(_WIN32) && !USE_CRT
+    return ::HeapAlloc(cHeapCommon::g_hHeap, 0, nSize);  // nh_malloc_dbg.
+#else
+    return ::malloc(nSize);  // nh_malloc_dbg.
+#endif
+}
+static inline void HeapFreeBlock(void* pData) noexcept {
+#if defined(_WIN32) && !USE_CRT
+    ::HeapFree(cHeapCommon::g_hHeap, 0, pData);
+#else
+    ::free(pData);
+#endif
+}
+
+//********************************************
+
+/// <summary>
+/// Per thread cache of freed small cHeap blocks. like the tcmalloc front end. cHeapCommon::sm_bThreadCache
+/// The blocks are real heap blocks, so GetSize(), IsValidHeap() and ReAllocPtr() still work on them.
+/// A block freed on another thread just goes into that threads cache.
+/// Also holds this threads heap stats till they are added to g_Stats.
+/// </summary>
+struct cHeapThreadCache {
+    static const int k_nClasses = 10;
+    static const int k_nDepthMax = 64;            /// Max blocks kept per size class. More go back to the heap.
+    static const ITERATE_t k_nStatsFold = 1024;  /// Add stats to g_Stats every this many ops.
+    static const size_t k_aClassSize[k_nClasses];
+
+    struct cFreeBlock {
+        cFreeBlock* _pNext;
+    };
+
+    cFreeBlock* _aFree[k_nClasses] = {};  /// linked list of free blocks per size class.
+    int _aCount[k_nClasses] = {};
+    ITERATE_t _nOps = 0;  /// stats not yet in g_Stats.
+    ITERATE_t _nAllocs = 0;
+    ptrdiff_t _nTotal = 0;
+    cHeapThreadCache* _pNext = nullptr;  /// all caches. for GetStats().
+
+    static cThreadLockableFast sm_Lock;  /// for g_Stats and sm_pHead
+    static cHeapThreadCache* sm_pHead;
+
+    cHeapThreadCache() noexcept {
+        const auto guard(sm_Lock.Lock());
+        _pNext = sm_pHead;
+        sm_pHead = this;
+    }
+    ~cHeapThreadCache() noexcept;
+
+    /// <summary>
+    /// The smallest class that can hold nSize. -1 = too big to cache.
+    /// </summary>
+    static int GRAYCALL GetClassAlloc(size_t nSize) noexcept {
+        for (int i = 0; i < k_nClasses; i++) {
+            if (nSize <= k_aClassSize[i]) return i;
+        }
+        return -1;
+    }
+    /// <summary>
+    /// The class a freed block of actual nSize can serve. -1 = wrong size to cache.
+    /// </summary>
+    static int GRAYCALL GetClassFree(size_t nSize) noexcept {
+        if (nSize < k_aClassSize[0]) return -1;
+        for (int i = 1; i < k_nClasses; i++) {
+            if (nSize < k_aClassSize[i]) return i - 1;
+        }
+        if (nSize < k_aClassSize[k_nClasses - 1] * 2) return k_nClasses - 1;
+        return -1;  // Don't hold big blocks for small requests.
+    }
+
+    void* AllocBlock(int iClass) noexcept {
+        cFreeBlock* pBlock = _aFree[iClass];
+        if (pBlock == nullptr) return nullptr;
+        _aFree[iClass] = pBlock->_pNext;
+        _aCount[iClass]--;
+#ifdef _DEBUG
+        // Was it written to after it was freed ?
+        const BYTE* pFill = PtrCast<BYTE>(pBlock) + sizeof(cFreeBlock);
+        for (size_t i = 0; i < k_aClassSize[iClass] - sizeof(cFreeBlock); i++) {
+            DEBUG_CHECK(pFill[i] == cHeapCommon::kFillFreed);
+        }
+        cMem::Fill(pBlock, k_aClassSize[iClass], cHeapCommon::kFillAlloc);
+#endif
+        return pBlock;
+    }
+
+    bool FreeBlock(void* pData, size_t nSize) noexcept {
+        const int iClass = GetClassFree(nSize);
+        if (iClass < 0 || _aCount[iClass] >= k_nDepthMax) return false;
+        cFreeBlock* pBlock = PtrCast<cFreeBlock>(pData);
+#ifdef _DEBUG
+        for (const cFreeBlock* pTest = _aFree[iClass]; pTest != nullptr; pTest = pTest->_pNext) {
+            DEBUG_CHECK(pTest != pBlock);  // freed twice!
+        }
+        cMem::Fill(pBlock, k_aClassSize[iClass], cHeapCommon::kFillFreed);
+#endif
+        pBlock->_pNext = _aFree[iClass];
+        _aFree[iClass] = pBlock;
+        _aCount[iClass]++;
+        return true;
+    }
+
+    void FlushBlocks() noexcept {
+        for (int i = 0; i < k_nClasses; i++) {
+            cFreeBlock* pBlock = _aFree[i];
+            while (pBlock != nullptr) {
+                cFreeBlock* pNext = pBlock->_pNext;
+                HeapFreeBlock(pBlock);
+                pBlock = pNext;
+            }
+            _aFree[i] = nullptr;
+            _aCount[i] = 0;
+        }
+    }
+
+    void AddStats(ITERATE_t nAllocs, ptrdiff_t nSize) noexcept {
+        _nOps++;
+        _nAllocs += nAllocs;
+        _nTotal += nSize;
+        if (_nOps >= k_nStatsFold) FoldStats();
+    }
+    /// ASSUME sm_Lock
+    static void GRAYCALL AddStatsTo(cHeapStats& stats, ITERATE_t nOps, ITERATE_t nAllocs, ptrdiff_t nTotal) noexcept {
+        stats._Ops += nOps;
+        stats._Allocs += nAllocs;
+#ifdef USE_HEAP_STATS
+        stats._Total += nTotal;
+        if (stats._Total > stats._Max) stats._Max = stats._Total;
+#else
+        UNREFERENCED_PARAMETER(nTotal);
+#endif
+    }
+    void FoldStats() noexcept {
+        const auto guard(sm_Lock.Lock());
+        AddStatsTo(cHeapCommon::g_Stats, _nOps, _nAllocs, _nTotal);
+        _nOps = 0;
+        _nAllocs = 0;
+        _nTotal = 0;
+    }
+};
+
+const size_t cHeapThreadCache::k_aClassSize[cHeapThreadCache::k_nClasses] = {16, 32, 48, 64, 96, 128, 192, 256, 384, 512};
+cThreadLockableFast cHeapThreadCache::sm_Lock;
+cHeapThreadCache* cHeapThreadCache::sm_pHead = nullptr;
+
+/// This threads cache is destroyed. (thread exit) don't use it again.
+static thread_local bool s_bHeapCacheClosed = false;
+
+cHeapThreadCache::~cHeapThreadCache() noexcept {
+    s_bHeapCacheClosed = true;
+    FlushBlocks();
+    const auto guard(sm_Lock.Lock());
+    AddStatsTo(cHeapCommon::g_Stats, _nOps, _nAllocs, _nTotal);
+    for (cHeapThreadCache** ppNext = &sm_pHead; *ppNext != nullptr; ppNext = &(*ppNext)->_pNext) {
+        if (*ppNext == this) {
+            *ppNext = _pNext;
+            break;
+        }
+    }
+}
+
+/// <summary>
+/// Get the cache for the current thread. nullptr = not using a cache.
+/// </summary>
+static cHeapThreadCache* GetHeapCache() noexcept {
+    if (!cHeapCommon::sm_bThreadCache || s_bHeapCacheClosed) return nullptr;
+    static thread_local cHeapThreadCache s_HeapCache;
+    return &s_HeapCache;
+}
+
+static inline void HeapStatsAlloc(cHeapThreadCache* pCache, size_t nSize) noexcept {
+    if (pCache != nullptr) {
+        pCache->AddStats(1, CastN(ptrdiff_t, nSize));
+    } else {
+#ifdef USE_HEAP_STATS
+        cHeapCommon::g_Stats.Alloc(nSize);
+#else
+        cHeapCommon::g_Stats.Alloc();
+#endif
+    }
+}
+static inline void HeapStatsFree(cHeapThreadCache* pCache, size_t nSize) noexcept {
+    if (pCache != nullptr) {
+        pCache->AddStats(-1, -CastN(ptrdiff_t, nSize));
+    } else {
+#ifdef USE_HEAP_STATS
+        cHeapCommon::g_Stats.Free(nSize);
+#else
+        cHeapCommon::g_Stats.Free();
+#endif
+    }
+}
+
+cHeapStats GRAYCALL cHeapCommon::GetStats() noexcept {  // static
+    const auto guard(cHeapThreadCache::sm_Lock.Lock());
+    cHeapStats stats = g_Stats;
+    for (const cHeapThreadCache* pCache = cHeapThreadCache::sm_pHead; pCache != nullptr; pCache = pCache->_pNext) {
+        // Other threads may be changing these. close enough.
+        cHeapThreadCache::AddStatsTo(stats, pCache->_nOps, pCache->_nAllocs, pCache->_nTotal);
+    }
+    return stats;
+}
+
+void GRAYCALL cHeap::FlushThreadCache() noexcept {  // static
+    if (s_bHeapCacheClosed) return;
+    cHeapThreadCache* pCache = GetHeapCache();
+    if (pCache == nullptr) return;
+    pCache->FlushBlocks();
+    pCache->FoldStats();
+}
+
 size_t GRAYCALL cHeapCommon::GetAlign(const void* pData) noexcept {  // static
     // ASSUME >= k_SizeAlignDef. 1,2,4,8,16,32
     auto bits = cBits::Lowest1Bit(CastPtrToNum(pData));
@@ -80,11 +294,13 @@ UINT64 GRAYCALL cHeapCommon::get_PhysAvail() {  // static
 #endif
 }
 
-void GRAYCALL cHeapCommon::Init(int nFlags) {  // static
+void GRAYCALL cHeapCommon::Init(int nFlags, bool bThreadCache) {  // static
     //! Initialize the heap to debug if desired.
     //! @arg nFlags = _CRTDBG_ALLOC_MEM_DF | _CRTDBG_DELAY_FREE_MEM_DF
     //!  _CRTDBG_CHECK_ALWAYS_DF = auto call _CrtCheckMemory on every alloc or free.
     //! _crtDbgFlag
+    //! @arg bThreadCache = keep freed small blocks in a per thread cache. Safe to change at any time. cached blocks are real heap blocks.
+    sm_bThreadCache = bThreadCache;
 #if defined(_MSC_VER) && defined(_DEBUG) && !defined(UNDER_CE) && USE_CRT
     ::_CrtSetDbgFlag(nFlags);
 #else
@@ -125,16 +341,11 @@ void GRAYCALL cHeap::FreePtr(void* pData) noexcept {  // static
 #if defined(_DEBUG)
     DEBUG_CHECK(IsValidHeap(pData));
 #endif
-#ifdef USE_HEAP_STATS
-    g_Stats.Free(GetSize(pData));
-#else
-    g_Stats.Free();
-#endif
-#if defined(_WIN32) && !USE_CRT
-    ::HeapFree(g_hHeap, 0, pData);
-#else
-    ::free(pData);
-#endif
+    cHeapThreadCache* pCache = GetHeapCache();
+    const size_t nSize = GetSize(pData);
+    HeapStatsFree(pCache, nSize);
+    if (pCache != nullptr && pCache->FreeBlock(pData, nSize)) return;  // keep it for re-use.
+    HeapFreeBlock(pData);
 }
 
 void* GRAYCALL cHeap::AllocPtr(size_t iSize) {  // static // throw(std::bad_alloc)
@@ -147,11 +358,16 @@ void* GRAYCALL cHeap::AllocPtr(size_t iSize) {  // static // throw(std::bad_allo
 #ifdef _DEBUG
     DEBUG_ASSERT(iSize < k_ALLOC_MAX, "AllocPtr");  // 256 * 64K - remove/change this if it becomes a problem
 #endif
-#if defined(_WIN32) && !USE_CRT
-    void* pData = ::HeapAlloc(g_hHeap, 0, iSize);  // nh_malloc_dbg.
-#else
-    void* pData = ::malloc(iSize);  // nh_malloc_dbg.
-#endif
+    cHeapThreadCache* pCache = GetHeapCache();
+    void* pData = nullptr;
+    if (pCache != nullptr) {
+        const int iClass = cHeapThreadCache::GetClassAlloc(iSize);
+        if (iClass >= 0) {
+            pData = pCache->AllocBlock(iClass);
+            iSize = cHeapThreadCache::k_aClassSize[iClass];  // round up so it can be cached when freed.
+        }
+    }
+    if (pData == nullptr) pData = HeapAllocBlock(iSize);
     if (pData == nullptr) {
         DEBUG_ASSERT(0, "malloc");
         return nullptr;  // E_OUTOFMEMORY   // I asked for too much!
@@ -159,13 +375,9 @@ void* GRAYCALL cHeap::AllocPtr(size_t iSize) {  // static // throw(std::bad_allo
 #if defined(_DEBUG)
     ASSERT(cHeap::IsValidHeap(pData));
 #endif
-#ifdef USE_HEAP_STATS
     const size_t nSizeAllocated = GetSize(pData);  // the actual size.
     ASSERT(nSizeAllocated >= iSize);
-    g_Stats.Alloc(nSizeAllocated);
-#else
-    g_Stats.Alloc();
-#endif
+    HeapStatsAlloc(pCache, nSizeAllocated);
     return pData;
 }
 
@@ -177,20 +389,13 @@ void* GRAYCALL cHeap::ReAllocPtr(void* pData, size_t iSize) {  // static
 
     CODEPROFILEFUNC();
     ASSERT(iSize < k_ALLOC_MAX);  // 256 * 64K
+    cHeapThreadCache* pCache = GetHeapCache();
     void* pData2 = nullptr;
     if (pData == nullptr) {
         if (iSize <= 0) return nullptr;  // just do nothing. this is ok.
-#if defined(_WIN32) && !USE_CRT
-        pData2 = ::HeapAlloc(g_hHeap, 0, iSize);  // nh_malloc_dbg.
-#else
-        pData2 = ::malloc(iSize);          // nh_malloc_dbg.
-#endif
+        pData2 = HeapAllocBlock(iSize);
     } else {
-#ifdef USE_HEAP_STATS
-        g_Stats.Free(GetSize(pData));  // act as though it was freed.
-#else
-        g_Stats.Free();                    // act as though it was freed.
-#endif
+        HeapStatsFree(pCache, GetSize(pData));  // act as though it was freed.
 #if defined(_WIN32) && !USE_CRT
         pData2 = ::HeapReAlloc(g_hHeap, 0, pData, iSize);
 #else
@@ -203,13 +408,9 @@ void* GRAYCALL cHeap::ReAllocPtr(void* pData, size_t iSize) {  // static
         return nullptr;
     }
 
-#ifdef USE_HEAP_STATS
     const size_t nSizeAllocated = GetSize(pData2);  // alloc size may be different than requested size.
     ASSERT(nSizeAllocated >= iSize);
-    g_Stats.Alloc(nSizeAllocated);
-#else
-    g_Stats.Alloc();
-#endif
+    HeapStatsAlloc(pCache, nSizeAllocated);
     return pData2;
 }
 
@@ -0,0 +1,179 @@
+//! @file cHeapArena.cpp
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+// clang-format off
+#include "pch.h"
+// clang-format on
+#include "cHeapArena.h"
+
+namespace Gray {
+/// The innermost cHeapArenaScope for this thread. nullptr = just use cHeap.
+static thread_local cHeapArenaScope* s_pArenaScope = nullptr;
+
+BYTE* cHeapArena::AllocChunk(size_t nSizeBlock) {
+    // Make a new current chunk. or a chunk just for a big block.
+    const bool bBig = nSizeBlock > _nChunkSize / 4;
+    const size_t nSizeChunk = k_nChunkHead + (bBig ? nSizeBlock : _nChunkSize);
+    cChunk* pChunk = PtrCast<cChunk>(cHeap::AllocPtr(nSizeChunk));
+    if (pChunk == nullptr) return nullptr;
+    BYTE* pStart = PtrCast<BYTE>(pChunk) + k_nChunkHead;
+    pChunk->_pEnd = PtrCast<BYTE>(pChunk) + nSizeChunk;
+    if (_pMin == nullptr || PtrCast<BYTE>(pChunk) < _pMin) _pMin = PtrCast<BYTE>(pChunk);
+    if (pChunk->_pEnd > _pMax) _pMax = pChunk->_pEnd;
+
+    if (bBig && _pChunks != nullptr) {
+        // Keep using the current chunk. put this behind it.
+        pChunk->_pNext = _pChunks->_pNext;
+        _pChunks->_pNext = pChunk;
+        return pStart;
+    }
+
+    pChunk->_pNext = _pChunks;
+    _pChunks = pChunk;
+    _pNext = pStart + nSizeBlock;
+    _pLast = pStart;
+    if (!bBig && _nChunkSize < k_nChunkSizeMax) _nChunkSize *= 2;  // grow.
+    return pStart;
+}
+
+void cHeapArena::FreeChunks(cChunk* pKeep) noexcept {
+    cChunk* pChunk = _pChunks;
+    while (pChunk != nullptr) {
+        cChunk* pNext = pChunk->_pNext;
+        if (pChunk != pKeep) cHeap::FreePtr(pChunk);
+        pChunk = pNext;
+    }
+    _pChunks = pKeep;
+    _pNext = nullptr;
+    _pLast = nullptr;
+    _nSizeUsed = 0;
+    _pMin = nullptr;
+    _pMax = nullptr;
+    if (pKeep != nullptr) {
+        pKeep->_pNext = nullptr;
+        _pNext = PtrCast<BYTE>(pKeep) + k_nChunkHead;
+        _pMin = PtrCast<BYTE>(pKeep);
+        _pMax = pKeep->_pEnd;
+    }
+}
+
+void cHeapArena::Reset() noexcept {
+    FreeChunks(_pChunks);
+}
+
+bool cHeapArena::IsInsideChunks(const void* pData) const noexcept {
+    for (const cChunk* pChunk = _pChunks; pChunk != nullptr; pChunk = pChunk->_pNext) {
+        if (pData > static_cast<const void*>(pChunk) && pData < static_cast<const void*>(pChunk->_pEnd)) return true;
+    }
+    return false;
+}
+
+void* cHeapArena::AllocPtr(size_t nSize) {
+    const size_t nSizeBlock = GetBlockSize(nSize);
+    BYTE* pBlock;
+    if (_pChunks != nullptr && nSizeBlock <= CastN(size_t, _pChunks->_pEnd - _pNext)) {
+        pBlock = _pNext;
+        _pNext += nSizeBlock;
+        _pLast = pBlock;
+    } else {
+        pBlock = AllocChunk(nSizeBlock);
+        if (pBlock == nullptr) return nullptr;
+    }
+    _nSizeUsed += nSizeBlock;
+    void* pData = pBlock + k_nBlockHead;
+    RefSize(pData) = nSizeBlock - k_nBlockHead;  // usable size. like cHeap::GetSize()
+    return pData;
+}
+
+void cHeapArena::FreePtr(void* pData) noexcept {
+    DEBUG_CHECK(IsInside(pData));
+    BYTE* pBlock = PtrCast<BYTE>(pData) - k_nBlockHead;
+    if (pBlock != _pLast) return;  // wait for Reset().
+    _nSizeUsed -= CastN(size_t, _pNext - pBlock);
+    _pNext = pBlock;
+    _pLast = nullptr;
+}
+
+void* cHeapArena::ReAllocPtr(void* pData, size_t nSize) {
+    DEBUG_CHECK(IsInside(pData));
+    BYTE* pBlock = PtrCast<BYTE>(pData) - k_nBlockHead;
+    const size_t nSizeBlock = GetBlockSize(nSize);
+    if (pBlock == _pLast && nSizeBlock <= CastN(size_t, _pChunks->_pEnd - pBlock)) {
+        // The last block can grow/shrink in place.
+        _nSizeUsed += nSizeBlock;
+        _nSizeUsed -= CastN(size_t, _pNext - pBlock);
+        _pNext = pBlock + nSizeBlock;
+        RefSize(pData) = nSizeBlock - k_nBlockHead;
+        return pData;
+    }
+    const size_t nSizeOld = GetSize(pData);
+    if (nSize <= nSizeOld) return pData;  // it fits.
+    void* pDataNew = AllocPtr(nSize);
+    if (pDataNew == nullptr) return nullptr;
+    cMem::Copy(pDataNew, pData, nSizeOld);
+    return pDataNew;  // old block waits for Reset().
+}
+
+//*************************************************
+
+cHeapArenaScope::cHeapArenaScope(cHeapArena* pArena) noexcept : _pArena(pArena), _pPrev(s_pArenaScope) {
+    s_pArenaScope = this;
+}
+cHeapArenaScope::~cHeapArenaScope() noexcept {
+    DEBUG_CHECK(s_pArenaScope == this);  // must nest.
+    s_pArenaScope = _pPrev;
+}
+
+//*************************************************
+
+cHeapArena* GRAYCALL cHeapArenaHook::get_Arena() noexcept {  // static
+    const cHeapArenaScope* pScope = s_pArenaScope;
+    if (pScope == nullptr) return nullptr;
+    return pScope->_pArena;
+}
+
+cHeapArena* GRAYCALL cHeapArenaHook::FindArena(const void* pData) noexcept {  // static
+    if (pData == nullptr) return nullptr;
+    for (const cHeapArenaScope* pScope = s_pArenaScope; pScope != nullptr; pScope = pScope->_pPrev) {
+        if (pScope->_pArena != nullptr && pScope->_pArena->IsInside(pData)) return pScope->_pArena;
+    }
+    return nullptr;
+}
+
+bool GRAYCALL cHeapArenaHook::IsValidHeap(const void* pData) noexcept {  // static
+    if (FindArena(pData) != nullptr) return true;
+    return cHeap::IsValidHeap(pData);
+}
+
+size_t GRAYCALL cHeapArenaHook::GetSize(const void* pData) noexcept {  // static
+    if (FindArena(pData) != nullptr) return cHeapArena::GetSize(pData);
+    return cHeap::GetSize(pData);
+}
+
+void* GRAYCALL cHeapArenaHook::AllocPtr(size_t nSize) {  // static
+    cHeapArena* pArena = get_Arena();
+    if (pArena != nullptr) return pArena->AllocPtr(nSize);
+    return cHeap::AllocPtr(nSize);
+}
+
+void GRAYCALL cHeapArenaHook::FreePtr(void* pData) noexcept {  // static
+    if (pData == nullptr) return;
+    cHeapArena* pArena = FindArena(pData);
+    if (pArena != nullptr) {
+        pArena->FreePtr(pData);
+        return;
+    }
+    cHeap::FreePtr(pData);
+}
+
+void* GRAYCALL cHeapArenaHook::ReAllocPtr(void* pData, size_t nSize) {  // static
+    if (pData == nullptr) {
+        cHeapArena* pArena = get_Arena();
+        if (pArena == nullptr) return cHeap::ReAllocPtr(pData, nSize);
+        if (nSize <= 0) return nullptr;  // same as cHeap
+        return pArena->AllocPtr(nSize);
+    }
+    cHeapArena* pArena = FindArena(pData);
+    if (pArena != nullptr) return pArena->ReAllocPtr(pData, nSize);
+    return cHeap::ReAllocPtr(pData, nSize);  // heap blocks stay on the heap.
+}
+}  // namespace Gray
@@ -0,0 +1,121 @@
+//! @file cHistogramHdr.cpp
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+// clang-format off
+#include "pch.h"
+// clang-format on
+#include "cHeapArena.h"
+#include "cHistogramHdr.h"
+#include "cLogSink.h"
+
+namespace Gray {
+
+UINT64 GRAYCALL cHistogramHdr::GetBucketMin(ITERATE_t i) noexcept {  // static
+    if (i < k_nSubQty) return CastN(UINT64, i);
+    const BIT_ENUM_t nShift = CastN(BIT_ENUM_t, i / k_nHalfQty - 1);
+    return CastN(UINT64, i - nShift * k_nHalfQty) << nShift;
+}
+
+UINT64 GRAYCALL cHistogramHdr::GetBucketMax(ITERATE_t i) noexcept {  // static
+    if (i < k_nSubQty) return CastN(UINT64, i);
+    const BIT_ENUM_t nShift = CastN(BIT_ENUM_t, i / k_nHalfQty - 1);
+    return (CastN(UINT64, i - nShift * k_nHalfQty + 1) << nShift) - 1;  // last bucket wraps to max.
+}
+
+void cHistogramHdr::Merge(const cHistogramHdr& src) noexcept {
+    if (src._nCount <= 0) return;
+    for (ITERATE_t i = 0; i < k_nBuckets; i++) {
+        _aBuckets[i] += src._aBuckets[i];
+    }
+    _nCount += src._nCount;
+    _nTotal += src._nTotal;
+    if (src._nMin < _nMin) _nMin = src._nMin;
+    if (src._nMax > _nMax) _nMax = src._nMax;
+}
+
+void cHistogramHdr::Reset() noexcept {
+    cMem::Zero(_aBuckets, sizeof(_aBuckets));
+    _nCount = 0;
+    _nTotal = 0;
+    _nMin = cTypeLimit<UINT64>::Max();
+    _nMax = 0;
+}
+
+UINT64 cHistogramHdr::GetPercentile(double dPercent) const noexcept {
+    if (_nCount <= 0) return 0;
+    if (dPercent >= 100.0) return _nMax;
+    UINT64 nTarget = CastN(UINT64, (dPercent / 100.0) * CastN(double, _nCount) + 0.5);
+    if (nTarget <= 0) nTarget = 1;
+    UINT64 nSum = 0;
+    for (ITERATE_t i = 0; i < k_nBuckets; i++) {
+        nSum += _aBuckets[i];
+        if (nSum >= nTarget) {
+            return cValT::Max(_nMin, cValT::Min(_nMax, GetBucketMax(i)));
+        }
+    }
+    return _nMax;  // buckets may be slightly stale vs _nCount.
+}
+
+StrLen_t cHistogramHdr::GetSummary(cSpanX<char> ret, const char* pszName, bool bPerf) const {
+    const double dScale = bPerf ? (cTimePerf::ToSeconds(1) * 1000000.0) : 1.0;  // cTimePerf to microseconds.
+    return StrT::sprintfN(ret, "%s: count=%llu min=%.3f p50=%.3f p90=%.3f p99=%.3f p999=%.3f max=%.3f mean=%.3f%s", StrArg<char>(pszName), CastN(unsigned long long, _nCount),
+                          CastN(double, get_Min()) * dScale, CastN(double, GetPercentile(50.0)) * dScale, CastN(double, GetPercentile(90.0)) * dScale,
+                          CastN(double, GetPercentile(99.0)) * dScale, CastN(double, GetPercentile(99.9)) * dScale, CastN(double, get_Max()) * dScale, get_Mean() * dScale,
+                          bPerf ? " us" : "");
+}
+
+HRESULT cHistogramHdr::WriteSummary(ITextWriter& o, const char* pszName, bool bPerf) const {
+    char szTmp[StrT::k_LEN_Default];
+    GetSummary(TOSPAN(szTmp), pszName, bPerf);
+    const HRESULT hRes = o.WriteString(szTmp);
+    if (FAILED(hRes)) return hRes;
+    return o.WriteString(FILE_EOL);
+}
+
+HRESULT cHistogramHdr::LogSummary(cLogProcessor& rLog, const char* pszName, bool bPerf) const {
+    char szTmp[StrT::k_LEN_Default];
+    GetSummary(TOSPAN(szTmp), pszName, bPerf);
+    return rLog.addInfoF("%s", szTmp);
+}
+
+//**************************************************************
+
+cHistogramHdrShared::~cHistogramHdrShared() {
+    _aThreads.DeleteAll();
+}
+
+cHistogramHdr* cHistogramHdrShared::CreateThreadCurrent() noexcept {
+    if (!_TLS.isInit()) return nullptr;
+    const auto guard(_Lock.Lock());
+    const cHeapArenaScope scopeHeap(nullptr);  // outlives any cHeapArena.
+    cHistogramHdr* pHist = new cHistogramHdr;
+    _aThreads.Add(pHist);
+    _TLS.PutData(pHist);
+    return pHist;
+}
+
+void cHistogramHdrShared::GetSnapshot(cHistogramHdr& rHist) const {
+    const auto guard(_Lock.Lock());
+    for (const cHistogramHdr* pHist : _aThreads) {
+        rHist.Merge(*pHist);
+    }
+}
+
+void cHistogramHdrShared::Reset() {
+    const auto guard(_Lock.Lock());
+    for (cHistogramHdr* pHist : _aThreads) {
+        pHist->Reset();
+    }
+}
+
+HRESULT cHistogramHdrShared::WriteSummary(ITextWriter& o, const char* pszName, bool bPerf) const {
+    cHistogramHdr hist;
+    GetSnapshot(hist);
+    return hist.WriteSummary(o, pszName, bPerf);
+}
+
+HRESULT cHistogramHdrShared::LogSummary(cLogProcessor& rLog, const char* pszName, bool bPerf) const {
+    cHistogramHdr hist;
+    GetSnapshot(hist);
+    return hist.LogSummary(rLog, pszName, bPerf);
+}
+}  // namespace Gray
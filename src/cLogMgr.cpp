@@ -16,21 +16,169 @@ cSingleton_IMPL(cLogMgr);
 
 //************************************************************************
 
-cLogNexus::cLogNexus(LOG_ATTR_MASK_t uAttrMask, LOGLVL_t eLogLevel) : _LogFilter(uAttrMask, eLogLevel) {}
+cLogNexusAsync::cLogNexusAsync(cLogNexus& rNexus, ITERATE_t nQtyMax, LOG_OVERFLOW_t eOverflow) : _rNexus(rNexus), _Queue(nQtyMax), _eOverflow(eOverflow) {}
 
-HRESULT cLogNexus::addEvent(cLogEvent& rEvent) noexcept {  // virtual
-    CODEPROFILEFUNC();
-    if (!cLogMgr::isSingleCreated()) {
-        DEBUG_CHECK(cLogMgr::isSingleCreated());
-        return HRESULT_WIN32_C(ERROR_EMPTY);
+cLogNexusAsync::~cLogNexusAsync() {
+    DEBUG_CHECK(!isThreadRunning());
+}
+
+bool GRAYCALL cLogNexusAsync::IsDebugDetail(const cLogEvent& rEvent) noexcept {  // static
+    if (rEvent.get_LogLevel() <= LOGLVL_t::_TRACE) return true;
+    return rEvent.IsLogAttrMask(LOG_ATTR_DEBUG) && rEvent.get_LogLevel() < LOGLVL_t::_WARN;
+}
+
+void cLogNexusAsync::WakeWriter() noexcept {
+    // Only the first producer to see it parked pays for the wake.
+    if (_nWriterParked != 0 && InterlockedN::Exchange(&_nWriterParked, 0) != 0) cThreadLockable::WakeAddr(&_nWriterSeq);
+}
+
+void cLogNexusAsync::WakeProducers() noexcept {
+    for (INTER32_t n = _nProducersParked; n > 0; n--) {
+        cThreadLockable::WakeAddr(&_nSpaceSeq);
     }
-    if (!IsLogged(rEvent.get_LogAttrMask(), rEvent.get_LogLevel())) {  // I don't care about these ?
-        return HRESULT_WIN32_C(ERROR_EMPTY);                           // no sinks care about this.
+}
+
+HRESULT cLogNexusAsync::PushBlock(const cLogEventPtr& pEvent) noexcept {
+    // The queue is full. Park till the writer makes room.
+    for (;;) {
+        const INTER32_t nSpaceSeq = _nSpaceSeq;  // read before _nProducersParked++ and try so we can't miss a wake.
+        InterlockedN::Increment(&_nProducersParked);
+        if (_Queue.TryPush(pEvent)) {
+            InterlockedN::Decrement(&_nProducersParked);
+            WakeWriter();
+            return 1;
+        }
+        if (!isThreadRunning() || isThreadStopping()) {
+            InterlockedN::Decrement(&_nProducersParked);
+            return _rNexus.DispatchEvent(*pEvent);  // the writer is going away. do it myself.
+        }
+        WakeWriter();
+        cThreadLockable::ParkAddr(&_nSpaceSeq, nSpaceSeq, 10);
+        InterlockedN::Decrement(&_nProducersParked);
+    }
+}
+
+HRESULT cLogNexusAsync::Push(cLogEvent& rEvent) noexcept {
+    rEvent.MakeHeapMsg();  // The writer thread will free this. so it can't be in my cHeapArena.
+
+    cLogEventPtr pEvent(&rEvent);
+    if (_Queue.TryPush(pEvent)) {
+        WakeWriter();
+        return 1;
+    }
+
+    switch (_eOverflow) {
+        case LOG_OVERFLOW_t::_DropOldest:
+            for (;;) {
+                cLogEventPtr pEventOld;
+                if (_Queue.TryPop(pEventOld)) {
+                    _nQtyDropped.IncV();
+                } else {
+                    cThreadId::PauseCurrent();  // the oldest is still being written.
+                }
+                if (_Queue.TryPush(pEvent)) {
+                    WakeWriter();
+                    return 1;
+                }
+            }
+        case LOG_OVERFLOW_t::_DropDebug:
+            if (IsDebugDetail(rEvent)) {
+                _nQtyDropped.IncV();
+                WakeWriter();
+                return HRESULT_WIN32_C(ERROR_BUSY);
+            }
+            break;
+        default:
+            break;
+    }
+    return PushBlock(pEvent);
+}
+
+ITERATE_t cLogNexusAsync::DrainBatch() {
+    cLogEventPtr aBatch[k_nBatchMax];
+    ITERATE_t nQty = 0;
+    while (nQty < k_nBatchMax && _Queue.TryPop(aBatch[nQty])) nQty++;
+    const INTER32_t nDonePos = _Queue.get_ReadPos();  // anything before this is mine or was dropped.
+    if (nQty > 0) WakeProducers();
+
+    for (ITERATE_t i = 0; i < nQty; i++) {
+        _rNexus.DispatchEvent(*aBatch[i]);
+        aBatch[i].ReleasePtr();
+    }
+
+    const UINT nQtyDropped = _nQtyDropped.get_Value();
+    if (nQtyDropped != _nQtyDroppedLast) {
+        // Let the sinks know what they missed.
+        cLogEventPtr pEvent(new cLogEvent(LOG_ATTR_INTERNAL, LOGLVL_t::_WARN, cStringL::GetFormatf("Log queue full. Dropped %u events.", nQtyDropped - _nQtyDroppedLast)));
+        _nQtyDroppedLast = nQtyDropped;
+        _rNexus.DispatchEvent(*pEvent);
     }
-    if (rEvent._sMsg.IsEmpty()) return E_INVALIDARG;
 
-    _LogThrottle._nQtyLogLast++;
+    InterlockedN::Exchange(&_nDonePos, nDonePos);
+    return nQty;
+}
 
+THREAD_EXITCODE_t cLogNexusAsync::Run() {  // override
+    bool bDelivered = false;  // delivered something since the last idle flush.
+    for (;;) {
+        if (DrainBatch() > 0) {
+            bDelivered = true;
+            continue;
+        }
+        if (!_Queue.isEmptyApprox()) {
+            cThreadId::PauseCurrent();  // a producer is still writing its event.
+            continue;
+        }
+        if (bDelivered) {
+            // Going idle. Let buffered sinks (cLogSinkFile) write/sync everything from this burst at once.
+            bDelivered = false;
+            _rNexus.FlushSinks();
+            continue;
+        }
+        if (isThreadStopping()) break;
+
+        const INTER32_t nWriterSeq = _nWriterSeq;
+        InterlockedN::Exchange(&_nWriterParked, 1);  // Interlocked so the empty check can't move before this.
+        if (_Queue.isEmptyApprox() && !isThreadStopping()) {
+            cThreadLockable::ParkAddr(&_nWriterSeq, nWriterSeq, cTimeSys::k_FREQ);
+        }
+        InterlockedN::Exchange(&_nWriterParked, 0);
+    }
+    return THREAD_EXITCODE_OK;
+}
+
+void cLogNexusAsync::WaitForDelivered() noexcept {
+    const INTER32_t nTargetPos = _Queue.get_WritePos();
+    while (isThreadRunning() && CastN(INTER32_t, CastN(UINT32, _nDonePos) - CastN(UINT32, nTargetPos)) < 0) {
+        cThreadLockable::WakeAddr(&_nWriterSeq);
+        cThreadId::SleepCurrent(1);
+    }
+}
+
+void cLogNexusAsync::StopAsync() {
+    RequestStopThread();
+    cThreadLockable::WakeAddr(&_nWriterSeq);
+    if (!isCurrentThread()) {
+        WaitForThreadExit(10 * cTimeSys::k_FREQ);
+    }
+    // Deliver anything that got queued late.
+    cLogEventPtr pEvent;
+    while (_Queue.TryPop(pEvent)) {
+        _rNexus.DispatchEvent(*pEvent);
+    }
+    pEvent.ReleasePtr();
+    WakeProducers();
+}
+
+//************************************************************************
+
+cLogNexus::cLogNexus(LOG_ATTR_MASK_t uAttrMask, LOGLVL_t eLogLevel) : _LogFilter(uAttrMask, eLogLevel) {}
+
+cLogNexus::~cLogNexus() {
+    StopAsync();
+}
+
+HRESULT cLogNexus::DispatchEvent(cLogEvent& rEvent) noexcept {
     int iUsed = 0;
     cLogEventPtr pEventHolder(&rEvent);  // one more reference on this.
     HRESULT hResAdd = S_OK;
@@ -42,6 +190,13 @@ HRESULT cLogNexus::addEvent(cLogEvent& rEvent) noexcept {  // virtual
             pSink = EnumSinks(i);
             if (pSink == nullptr) break;
         }
+        if (pSink->_Throttle.isActive()) {
+            UINT nRepeats;
+            if (!pSink->_Throttle.CheckEvent(rEvent, nRepeats)) continue;  // too fast for this sink.
+            if (nRepeats > 0) {
+                pSink->addEvent(*cLogThrottle::MakeRepeatEvent(rEvent.get_LogAttrMask(), rEvent.get_LogLevel(), rEvent._pszSubject, rEvent._Args.get_Format(), nRepeats));
+            }
+        }
         hResAdd = pSink->addEvent(rEvent);
         if (hResAdd > 0) {
             iUsed++;  // handled.
@@ -50,22 +205,97 @@ HRESULT cLogNexus::addEvent(cLogEvent& rEvent) noexcept {  // virtual
         if (hResAdd < 0) continue;  // another form of filtering. don't process this sink.
         // FAILED ? or filtered write.
     }
+    return iUsed > 0 ? iUsed : hResAdd;  // did we do any work?
+}
 
+HRESULT cLogNexus::addEvent(cLogEvent& rEvent) noexcept {  // virtual
+    CODEPROFILEFUNC();
+    if (!cLogMgr::isSingleCreated()) {
+        DEBUG_CHECK(cLogMgr::isSingleCreated());
+        return HRESULT_WIN32_C(ERROR_EMPTY);
+    }
+    if (!IsLogged(rEvent.get_LogAttrMask(), rEvent.get_LogLevel())) {  // I don't care about these ?
+        return HRESULT_WIN32_C(ERROR_EMPTY);                           // no sinks care about this.
+    }
+    if (rEvent.isMsgEmpty()) return E_INVALIDARG;
+
+    if (_LogThrottle.isActive()) {
+        UINT nRepeats;
+        if (!_LogThrottle.CheckEvent(rEvent, nRepeats)) return HRESULT_WIN32_C(ERROR_EMPTY);  // too fast or a repeat. toss it.
+        if (nRepeats > 0) {
+            RouteEvent(*cLogThrottle::MakeRepeatEvent(rEvent.get_LogAttrMask(), rEvent.get_LogLevel(), rEvent._pszSubject, rEvent._Args.get_Format(), nRepeats));
+        }
+    }
+    return RouteEvent(rEvent);
+}
+
+HRESULT cLogNexus::RouteEvent(cLogEvent& rEvent) noexcept {
+    cLogNexusAsync* pAsync = _pAsync.get_Ptr();
+    if (pAsync != nullptr && pAsync->isAsync()) {
+        return pAsync->Push(rEvent);  // the writer thread will deliver it.
+    }
+
+    const HRESULT hRes = DispatchEvent(rEvent);
 #ifdef _DEBUG
     if (cAppState::isDebuggerPresent()) FlushLogs();
 #endif
-    return iUsed > 0 ? iUsed : hResAdd;  // did we do any work?
+    return hRes;
 }
 
 HRESULT cLogNexus::FlushLogs() {  // virtual
+    cLogNexusAsync* pAsync = _pAsync.get_Ptr();
+    if (pAsync != nullptr && pAsync->isAsync()) {
+        pAsync->WaitForDelivered();  // barrier. everything logged before this call is delivered.
+    }
+    FlushSinks();
+    return S_OK;
+}
+
+void cLogNexus::FlushSinks() {
+    // Report repeats that have not been followed by another event yet.
+    for (ITERATE_t i = 0;;) {
+        cLogEventPtr pEvent = _LogThrottle.TakeRepeatEvent(i);
+        if (pEvent == nullptr) break;
+        DispatchEvent(*pEvent);
+    }
     const auto guard(_LockLog.Lock());
     for (cLogSink* pSink : _aSinks) {
         if (pSink == nullptr) break;
+        for (ITERATE_t i = 0;;) {
+            cLogEventPtr pEvent = pSink->_Throttle.TakeRepeatEvent(i);
+            if (pEvent == nullptr) break;
+            pSink->addEvent(*pEvent);
+        }
         pSink->FlushLogs();
     }
+}
+
+HRESULT cLogNexus::StartAsync(ITERATE_t nQtyMax, LOG_OVERFLOW_t eOverflow) {
+    const auto guard(_LockLog.Lock());
+    if (isAsync()) return S_FALSE;
+    if (_pAsync != nullptr) {
+        // Restart the same writer. Producers may still hold a raw pointer to it. so it lives as long as this nexus.
+        if (_pAsync->isThreadRunning()) return HRESULT_WIN32_C(ERROR_BUSY);  // StopAsync() timed out. old writer still busy.
+        _pAsync->_eOverflow = eOverflow;
+        return _pAsync->CreateThread();
+    }
+    cRefPtr<cLogNexusAsync> pAsync(new cLogNexusAsync(*this, nQtyMax, eOverflow));
+    const HRESULT hRes = pAsync->CreateThread();
+    if (FAILED(hRes)) return hRes;
+    _pAsync = pAsync;  // never replaced after this.
     return S_OK;
 }
 
+void cLogNexus::StopAsync() {
+    cRefPtr<cLogNexusAsync> pAsync;
+    {
+        const auto guard(_LockLog.Lock());
+        pAsync = _pAsync;
+    }
+    if (pAsync == nullptr || !pAsync->isThreadRunning()) return;
+    pAsync->StopAsync();  // NOT under _LockLog. the writer needs it.
+}
+
 bool cLogNexus::HasSink(cLogSink* pSinkFind, bool bDescend) const {
     if (pSinkFind == nullptr) return false;
     const auto guard(_LockLog.Lock());
@@ -142,6 +372,7 @@ cLogMgr::cLogMgr() noexcept
 }
 
 cLogMgr::~cLogMgr() {
+    StopAsync();  // deliver anything queued while the sinks are still here.
     ASSERT(get_ThisLogNexus());
 }
 
@@ -6,6 +6,7 @@
 #include "StrBuilder.h"
 #include "cBits.h"
 #include "cCodeProfiler.h"
+#include "cHeapArena.h"
 #include "cLogEvent.h"
 #include "cLogMgr.h"
 #include "cLogSink.h"
@@ -16,6 +17,28 @@
 #endif
 
 namespace Gray {
+void cLogEvent::GetMsg(StrBuilder<LOGCHAR_t>& s) const {
+    if (_Args.isEmpty()) {
+        s.AddStr(_sMsg);
+    } else {
+        _Args.Render(s);
+    }
+}
+
+void cLogEvent::MakeHeapMsg() {
+    if (cHeapArenaHook::FindArena(_sMsg.get_CPtr()) == nullptr) return;
+    const cHeapArenaScope scopeHeap(nullptr);
+    _sMsg = cStringL(_sMsg.get_CPtr());
+}
+
+cStringL cLogEvent::get_Msg() const {
+    if (_Args.isEmpty()) return _sMsg;
+    LOGCHAR_t szTemp[StrT::k_LEN_Default];  // assume this magic number is big enough.
+    StrBuilder<LOGCHAR_t> s(TOSPAN(szTemp));
+    _Args.Render(s);
+    return s.get_CPtr();
+}
+
 void cLogEvent::GetFormattedDefault(StrBuilder<LOGCHAR_t>& s) const {
     if (get_LogLevel() >= LOGLVL_t::_WARN) {
         s.AddStr(cLogLevel::GetPrefixStr(get_LogLevel()));
@@ -31,27 +54,140 @@ void cLogEvent::GetFormattedDefault(StrBuilder<LOGCHAR_t>& s) const {
         s.AddChar(':');
     }
 
-    s.AddStr(_sMsg);
-    const StrLen_t iLen = _sMsg.GetLength();
-    ASSERT(iLen > 0);
+    const StrLen_t iLenStart = s.get_Length();
+    GetMsg(s);
+    const StrLen_t iLen = s.get_Length() - iLenStart;
+    DEBUG_CHECK(iLen > 0);
 
-    const LOGCHAR_t chLast = _sMsg[iLen - 1];
+    const LOGCHAR_t chLast = (iLen > 0) ? s.get_CPtr()[s.get_Length() - 1] : '\0';
     const bool bHasCRLF = (chLast == '\r' || chLast == '\n');  // FILE_EOL ?
     if (!bHasCRLF && !IsLogAttrMask(LOG_ATTR_NOCRLF)) {
         s.AddStr(FILE_EOL);
     }
 }
 
-cStringL cLogEvent::get_FormattedDefault() const {
-    LOGCHAR_t szTemp[StrT::k_LEN_Default];  // assume this magic number is big enough. Logging is weird and special so dont use dynamic memory.
-    StrBuilder<LOGCHAR_t> s(TOSPAN(szTemp));
-    GetFormattedDefault(s);
-    return s.get_CPtr();
+cSpan<LOGCHAR_t> cLogEvent::get_FormattedSpan() const {
+    /// <summary>
+    /// Put _nFormattedState back to 0 if rendering throws. (e.g. bad alloc) so waiters don't spin forever. Another thread may try again.
+    /// </summary>
+    struct cRenderGuard {
+        INTER32_t VOLATILE& _rnState;
+        bool _bDone = false;
+        ~cRenderGuard() {
+            if (!_bDone) InterlockedN::Exchange(&_rnState, 0);
+        }
+    };
+    for (;;) {
+        const INTER32_t nState = _nFormattedState;
+        if (nState == 2) break;
+        if (nState == 0 && InterlockedN::CompareExchange(&_nFormattedState, 1, 0) == 0) {
+            // I render it.
+            cRenderGuard guard{_nFormattedState};
+            LOGCHAR_t szTemp[StrT::k_LEN_Default];  // assume this magic number is big enough. Logging is weird and special so dont use dynamic memory.
+            StrBuilder<LOGCHAR_t> s(TOSPAN(szTemp));
+            GetFormattedDefault(s);
+            const cHeapArenaScope scopeHeap(nullptr);  // may outlive the callers cHeapArena.
+            _sFormatted = cStringL(s.get_SpanStr());
+            InterlockedN::Exchange(&_nFormattedState, 2);  // publish.
+            guard._bDone = true;
+            break;
+        }
+        cThreadId::PauseCurrent();  // another thread (sink) is rendering it.
+    }
+    return ToSpan(_sFormatted.get_CPtr(), _sFormatted.GetLength());
 }
 
 //**************************************************************
 
-cLogThrottle::cLogThrottle() noexcept : _fLogThrottle(2000.0f), _TimeLogLast(cTimeSys::k_CLEAR), _nQtyLogLast(0) {}
+cLogThrottle::cLogThrottle() noexcept {
+    cMem::Zero(_aRepeats, sizeof(_aRepeats));
+}
+
+void cLogThrottle::put_LogThrottle(float fPerSec, UINT nBurst) noexcept {
+    _fLogThrottle = fPerSec;
+    if (fPerSec <= 0) {
+        _nTimeRate = 0;
+        return;
+    }
+    _nTimeRate = cValT::Max<INT64>(CastN(INT64, CastN(double, cTimePerf::sm_nFreq) / fPerSec), 1);
+    if (nBurst <= 0) nBurst = CastN(UINT, fPerSec) + 1;
+    _nTimeBurst = _nTimeRate * (nBurst - 1);
+}
+
+void cLogThrottle::put_CoalesceTime(TIMESYSD_t nTimeMS) noexcept {
+    _nTimeCoalesce = CastN(INT64, nTimeMS) * CastN(INT64, cTimePerf::sm_nFreq / cTimeSys::k_FREQ);
+}
+
+bool cLogThrottle::AllowRate() noexcept {
+    // GCRA. a token bucket with one number. _nTimeTat moves ahead _nTimeRate for each event. bucket is empty if it gets too far ahead of now.
+    const INT64 nTimeNow = CastN(INT64, cTimePerf(true).get_Perf());
+    INT64 nTimeTat = _nTimeTat;
+    for (;;) {
+        const INT64 nTimeBase = cValT::Max(nTimeTat, nTimeNow);
+        if (nTimeBase - nTimeNow > _nTimeBurst) return false;
+        const INT64 nTimeTatPrev = InterlockedN::CompareExchange(&_nTimeTat, nTimeBase + _nTimeRate, nTimeTat);
+        if (nTimeTatPrev == nTimeTat) return true;
+        nTimeTat = nTimeTatPrev;  // another thread took one.
+    }
+}
+
+bool cLogThrottle::CheckEvent(const cLogEvent& rEvent, OUT UINT& rnRepeats) noexcept {
+    rnRepeats = 0;
+    cRepeat* pRepeat = nullptr;
+    if (_nTimeCoalesce > 0 && !rEvent._Args.isEmpty()) {
+        // Format is static so its pointer is a fine key.
+        const UINT_PTR nKey = CastPtrToNum(rEvent._Args.get_Format()) ^ (CastPtrToNum(rEvent._pszSubject) << 1);
+        pRepeat = &_aRepeats[(nKey ^ (nKey >> 6) ^ (nKey >> 12)) & (k_nQtyRepeats - 1)];
+        const INT64 nTimeNow = CastN(INT64, cTimePerf(true).get_Perf());
+        if (pRepeat->_nKey == nKey) {
+            const INT64 nTimeStart = pRepeat->_nTimeStart;
+            if (nTimeNow - nTimeStart < _nTimeCoalesce || InterlockedN::CompareExchange(&pRepeat->_nTimeStart, nTimeNow, nTimeStart) != nTimeStart) {
+                // a repeat in this window. (or another thread just started a new window)
+                InterlockedN::Increment(&pRepeat->_nQty);
+                _nQtyCoalesced.IncV();
+                return false;
+            }
+            rnRepeats = CastN(UINT, InterlockedN::Exchange(&pRepeat->_nQty, 0));  // New window. report the last one.
+        } else {
+            // Take the slot. Any repeats it had are lost. (still counted in _nQtyCoalesced)
+            InterlockedN::Exchange(&pRepeat->_nKey, CastN(UINT_PTR, 0));
+            pRepeat->_pszFormat = rEvent._Args.get_Format();
+            pRepeat->_pszSubject = rEvent._pszSubject;
+            pRepeat->_nAttrMask = rEvent.get_LogAttrMask();
+            pRepeat->_eLogLevel = rEvent.get_LogLevel();
+            InterlockedN::Exchange(&pRepeat->_nTimeStart, nTimeNow);
+            InterlockedN::Exchange(&pRepeat->_nQty, 0);
+            InterlockedN::Exchange(&pRepeat->_nKey, nKey);
+        }
+    }
+
+    if (_nTimeRate > 0 && rEvent.get_LogLevel() < _eLevelNoLimit && !AllowRate()) {
+        if (rnRepeats > 0) InterlockedN::ExchangeAdd(&pRepeat->_nQty, CastN(INTER32_t, rnRepeats));  // report them later.
+        rnRepeats = 0;
+        _nQtyDropped.IncV();
+        return false;
+    }
+    _nQtyPassed.IncV();
+    return true;
+}
+
+cLogEventPtr cLogThrottle::TakeRepeatEvent(ITERATE_t& i) {
+    for (; i < k_nQtyRepeats; i++) {
+        cRepeat& rRepeat = _aRepeats[i];
+        if (rRepeat._nKey == 0 || rRepeat._nQty == 0) continue;
+        const UINT nRepeats = CastN(UINT, InterlockedN::Exchange(&rRepeat._nQty, 0));
+        if (nRepeats == 0) continue;
+        i++;
+        return MakeRepeatEvent(rRepeat._nAttrMask, rRepeat._eLogLevel, rRepeat._pszSubject, rRepeat._pszFormat, nRepeats);
+    }
+    return nullptr;
+}
+
+cLogEventPtr GRAYCALL cLogThrottle::MakeRepeatEvent(LOG_ATTR_MASK_t uAttrMask, LOGLVL_t eLogLevel, const char* pszSubject, const LOGCHAR_t* pszFormat, UINT nRepeats) {  // static
+    cLogEventPtr pEvent(new cLogEvent(uAttrMask, eLogLevel, cStringL::GetFormatf("Repeated %u times: '%s'", nRepeats, pszFormat)));
+    pEvent->_pszSubject = pszSubject;
+    return pEvent;
+}
 
 //************************************************************************
 
@@ -68,11 +204,27 @@ HRESULT cLogProcessor::addEventV(LOG_ATTR_MASK_t uAttrMask, LOGLVL_t eLogLevel,
     //! @return <0 = failed, 0=not processed by anyone, # = number of processors.
     CODEPROFILEFUNC();
     if (StrT::IsNullOrEmpty(pszFormat)) return E_INVALIDARG;
+    if (!IsLogged(uAttrMask, eLogLevel)) return HRESULT_WIN32_C(ERROR_EMPTY);  // no log Sinks care about this. toss it.
 
+    // Defer formatting till some sink actually wants the text. Most don't.
+    cLogEventPtr pEvent(new cLogEvent(uAttrMask, eLogLevel));
+    va_list vargsCopy;
+    va_copy(vargsCopy, vargs);
+    const bool bCaptured = pEvent->_Args.Capture(pszFormat, vargsCopy);
+    va_end(vargsCopy);
+    if (!bCaptured) return addEventVNow(uAttrMask, eLogLevel, pszFormat, vargs);  // Args too big or odd format. Format it now.
+    return addEvent(*pEvent);
+}
+
+HRESULT cLogProcessor::addEventVNow(LOG_ATTR_MASK_t uAttrMask, LOGLVL_t eLogLevel, const LOGCHAR_t* pszFormat, va_list vargs) noexcept {
+    //! Format now. Nothing refers to pszFormat after this returns.
+    if (StrT::IsNullOrEmpty(pszFormat)) return E_INVALIDARG;
+    if (!IsLogged(uAttrMask, eLogLevel)) return HRESULT_WIN32_C(ERROR_EMPTY);
     LOGCHAR_t szTemp[StrT::k_LEN_Default];  // assume this magic number is big enough.
     const StrLen_t iLen = StrT::vsprintfN(TOSPAN(szTemp), pszFormat, vargs);
     if (iLen <= 0) return E_INVALIDARG;
-    return addEventS(uAttrMask, eLogLevel, szTemp);
+    cLogEventPtr pEvent(new cLogEvent(uAttrMask, eLogLevel, szTemp));
+    return addEvent(*pEvent);
 }
 
 HRESULT cLogProcessor::WriteString(const char* pszStr) {  // override
@@ -104,7 +256,7 @@ HRESULT cLogSinkDebug::WriteString(const LOGCHAR_t* pszText) {  // override
 }
 
 HRESULT cLogSinkDebug::addEvent(cLogEvent& rEvent) noexcept {  // override;
-    return WriteString(rEvent.get_FormattedDefault());
+    return WriteString(rEvent.get_FormattedSpan().get_PtrConst());
 }
 
 HRESULT GRAYCALL cLogSinkDebug::AddSinkCheck(cLogNexus* pLogger) {  // static
@@ -115,4 +267,181 @@ HRESULT GRAYCALL cLogSinkDebug::AddSinkCheck(cLogNexus* pLogger) {  // static
     pLogger->AddSink(new cLogSinkDebug);
     return S_OK;
 }
+
+//************************************************************************
+
+cInterlockedUInt cLogSinkCache::sm_nCacheIdLast;
+
+cLogSinkCache::cRing::cRing(UINT nCacheId, ITERATE_t nQty) : _nCacheId(nCacheId), _nMask(CastN(ITERATE_t, (1U << cBits::Highest1Bit(CastN(UINT32, cValT::Max<ITERATE_t>(nQty, 2) - 1))) - 1)) {
+    _pSlots = PtrCast<cSlot>(cHeap::AllocPtr((_nMask + 1) * sizeof(cSlot)));
+    cMem::Zero(_pSlots, (_nMask + 1) * sizeof(cSlot));
+}
+
+cLogSinkCache::cRing::~cRing() {
+    for (ITERATE_t i = 0; i <= _nMask; i++) {
+        cLogEvent* pEvent = CastNumToPtrT<cLogEvent>(InterlockedN::Exchange(&_pSlots[i]._nEvent, CastN(UINT_PTR, 0)));
+        if (pEvent != nullptr) pEvent->DecRefCount();
+    }
+    cHeap::FreePtr(_pSlots);
+}
+
+void cLogSinkCache::cRing::Add(cLogEvent* pEvent, TIMEPERF_t nTime) noexcept {
+    // Owner thread only.
+    cSlot& rSlot = _pSlots[_nWritePos & _nMask];
+    _nWritePos++;
+    rSlot._nTime = nTime;
+    pEvent->IncRefCount();
+    cLogEvent* pEventOld = CastNumToPtrT<cLogEvent>(InterlockedN::Exchange(&rSlot._nEvent, CastPtrToNum(pEvent)));  // publish.
+    if (pEventOld != nullptr) pEventOld->DecRefCount();  // overwrite the oldest.
+}
+
+cLogSinkCache::cLogSinkCache(cLogSink* pSinkOut, ITERATE_t nQtyRing) : _nCacheId(sm_nCacheIdLast.Inc()), _nQtyRing(nQtyRing), _pSinkOut(pSinkOut) {}
+
+cLogSinkCache::~cLogSinkCache() {
+    ClearCache();       // a thread may hold its ring a while longer.
+    _aRings.RemoveAll();
+}
+
+/// <summary>
+/// Fast path. The ring this thread used last. No thread_local init guard.
+/// </summary>
+struct cLogSinkCacheRingCur {
+    UINT _nCacheId;
+    cLogSinkCache::cRing* _pRing;
+};
+static thread_local cLogSinkCacheRingCur s_LogSinkCacheRingCur = {0, nullptr};
+static thread_local bool s_bLogSinkCacheExited = false;  // thread_local objects are being destroyed.
+
+/// <summary>
+/// All the rings this thread writes. one per cLogSinkCache. Mark them free for reuse when the thread exits.
+/// </summary>
+struct cLogSinkCacheThread {
+    cArrayRef<cLogSinkCache::cRing> _aRings;
+
+    cLogSinkCache::cRing* FindRing(UINT nCacheId) {
+        for (ITERATE_t i = _aRings.GetSize() - 1; i >= 0; i--) {
+            cLogSinkCache::cRing* pRing = _aRings.GetAt(i);
+            if (pRing->_nCacheId == nCacheId) return pRing;
+            if (pRing->get_RefCount() <= 1) _aRings.RemoveAt(i);  // its cLogSinkCache is gone.
+        }
+        return nullptr;
+    }
+
+    ~cLogSinkCacheThread() {
+        s_bLogSinkCacheExited = true;
+        s_LogSinkCacheRingCur._nCacheId = 0;
+        s_LogSinkCacheRingCur._pRing = nullptr;
+        for (ITERATE_t i = 0; i < _aRings.GetSize(); i++) {
+            InterlockedN::Exchange(&_aRings.GetAt(i)->_nFree, 1);
+        }
+    }
+};
+static thread_local cLogSinkCacheThread s_LogSinkCacheThread;
+
+cLogSinkCache::cRing* cLogSinkCache::GetRingCurrent() {
+    // Find the ring for this thread. Usually from the thread local cache. No lock.
+    if (s_LogSinkCacheRingCur._nCacheId == _nCacheId) return s_LogSinkCacheRingCur._pRing;
+    if (s_bLogSinkCacheExited) return nullptr;
+
+    // Another cLogSinkCache or first time for this thread.
+    cRing* pRing = s_LogSinkCacheThread.FindRing(_nCacheId);
+    if (pRing == nullptr) {
+        const auto guard(_Lock.Lock());
+        for (ITERATE_t i = 0; i < _aRings.GetSize(); i++) {
+            cRing* pRingFree = _aRings.GetAt(i);
+            if (pRingFree->_nFree != 0 && InterlockedN::CompareExchange(&pRingFree->_nFree, 0, 1) == 1) {  // thread exited. keep its events. they are older.
+                pRing = pRingFree;
+                break;
+            }
+        }
+        const cHeapArenaScope scopeHeap(nullptr);  // outlives any cHeapArena.
+        if (pRing == nullptr) {
+            pRing = new cRing(_nCacheId, _nQtyRing);
+            _aRings.Add(pRing);
+        }
+        s_LogSinkCacheThread._aRings.Add(pRing);
+    }
+    s_LogSinkCacheRingCur._nCacheId = _nCacheId;
+    s_LogSinkCacheRingCur._pRing = pRing;
+    return pRing;
+}
+
+void cLogSinkCache::DumpRings() {
+    // Take all events out of the rings, merge by time and send them on. ASSUME _Lock.
+    struct cEntry {
+        TIMEPERF_t _nTime;
+        cLogEvent* _pEvent;
+    };
+    const TIMEPERF_t nTimeNow = cTimePerf(true).get_Perf();
+    const TIMEPERF_t nTimeHold = CastN(TIMEPERF_t, _nCacheHold) * (cTimePerf::sm_nFreq / cTimeSys::k_FREQ);
+
+    cArrayStruct<cEntry> aEntries;
+    cArrayVal<ITERATE_t> aRingNext;  // each ring is already in time order. merge cursor per ring.
+    cArrayVal<ITERATE_t> aRingEnd;
+    for (ITERATE_t iRing = 0; iRing < _aRings.GetSize(); iRing++) {
+        cRing* pRing = _aRings.GetAt(iRing);
+        aRingNext.Add(aEntries.GetSize());
+        const ITERATE_t nWritePos = pRing->_nWritePos;
+        for (ITERATE_t i = 0; i <= pRing->_nMask; i++) {  // oldest first.
+            cSlot& rSlot = pRing->_pSlots[(nWritePos + i) & pRing->_nMask];
+            const TIMEPERF_t nTime = rSlot._nTime;  // before the Exchange. the owner may refill the slot right after.
+            cLogEvent* pEvent = CastNumToPtrT<cLogEvent>(InterlockedN::Exchange(&rSlot._nEvent, CastN(UINT_PTR, 0)));
+            if (pEvent == nullptr) continue;
+            if (nTimeNow - nTime > nTimeHold) {
+                pEvent->DecRefCount();  // too old. toss it.
+                continue;
+            }
+            aEntries.Add(cEntry{nTime, pEvent});
+        }
+        aRingEnd.Add(aEntries.GetSize());
+    }
+
+    // Merge the rings by time.
+    const ITERATE_t nRings = aRingNext.GetSize();
+    for (;;) {
+        ITERATE_t iRingMin = k_ITERATE_BAD;
+        for (ITERATE_t iRing = 0; iRing < nRings; iRing++) {
+            const ITERATE_t i = aRingNext[iRing];
+            if (i >= aRingEnd[iRing]) continue;  // this ring is done.
+            if (iRingMin == k_ITERATE_BAD || aEntries[i]._nTime < aEntries[aRingNext[iRingMin]]._nTime) iRingMin = iRing;
+        }
+        if (iRingMin == k_ITERATE_BAD) break;
+        cLogEvent* pEvent = aEntries[aRingNext[iRingMin]++]._pEvent;
+        if (_pSinkOut != nullptr) _pSinkOut->addEvent(*pEvent);
+        pEvent->DecRefCount();
+    }
+}
+
+void cLogSinkCache::ClearCache() {
+    const auto guard(_Lock.Lock());
+    for (ITERATE_t iRing = 0; iRing < _aRings.GetSize(); iRing++) {
+        cRing* pRing = _aRings.GetAt(iRing);
+        for (ITERATE_t i = 0; i <= pRing->_nMask; i++) {
+            cLogEvent* pEvent = CastNumToPtrT<cLogEvent>(InterlockedN::Exchange(&pRing->_pSlots[i]._nEvent, CastN(UINT_PTR, 0)));
+            if (pEvent != nullptr) pEvent->DecRefCount();
+        }
+    }
+}
+
+HRESULT cLogSinkCache::FlushLogs() {  // override
+    if (_pSinkOut == nullptr) return S_OK;
+    return _pSinkOut->FlushLogs();
+}
+
+HRESULT cLogSinkCache::addEvent(cLogEvent& rEvent) noexcept {  // override
+    if (rEvent.get_LogLevel() < _eLevelTrigger) {
+        // Just hold it.
+        rEvent.MakeHeapMsg();
+        cRing* pRing = GetRingCurrent();
+        if (pRing == nullptr) return 0;  // thread is exiting.
+        pRing->Add(&rEvent, cTimePerf(true).get_Perf());
+        return 1;
+    }
+
+    // Trigger. Dump everything that led up to this.
+    const auto guard(_Lock.Lock());
+    DumpRings();
+    if (_pSinkOut == nullptr) return 1;
+    return _pSinkOut->addEvent(rEvent);
+}
 }  // namespace Gray
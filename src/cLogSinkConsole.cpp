@@ -24,7 +24,7 @@ HRESULT cLogSinkConsole::FlushLogs() {  // override;
 }
 
 HRESULT cLogSinkConsole::addEvent(cLogEvent& rEvent) noexcept {  // override;
-    return WriteString(rEvent.get_FormattedDefault());
+    return WriteString(rEvent.get_FormattedSpan().get_PtrConst());
 }
 
 cLogSinkConsole* GRAYCALL cLogSinkConsole::AddSinkCheck(cLogNexus* pLogger, bool bAttachElseAlloc) {  // static
@@ -0,0 +1,141 @@
+//! @file cLogSinkFile.cpp
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+// clang-format off
+#include "pch.h"
+// clang-format on
+#include "cLogEvent.h"
+#include "cLogSinkFile.h"
+#include "cMime.h"
+#include "cTimeInt.h"
+
+namespace Gray {
+cLogSinkFile::cLogSinkFile(const FILECHAR_t* pszDir, const FILECHAR_t* pszPrefix, LOG_DURABLE_t eDurable, size_t nSizeBuf)
+    : _sDir(pszDir), _sPrefix(pszPrefix), _eDurable(eDurable), _Buf(cValT::Max<size_t>(nSizeBuf, StrT::k_LEN_Default)) {}
+
+cLogSinkFile::~cLogSinkFile() {
+    Close();
+}
+
+HRESULT cLogSinkFile::OpenFileNew() {
+    // Open a new file named for the time now. Append if it already exists.
+    const cTimeInt tNow = cTimeInt::GetTimeNow();
+    cTimeUnits tu;
+    tNow.GetTimeUnits(tu, TZ_LOCAL);
+    cStringF sFileName = cStringF::GetFormatf(_FN("%s%04d%02d%02d_%02d%02d%02d"), _sPrefix.get_CPtr(), tu._wYear, tu._wMonth, tu._wDay, tu._wHour, tu._wMinute, tu._wSecond);
+    if (sFileName.IsEqual(_sFileTitleLast)) {
+        // Rotated more than once in a second.
+        sFileName += cStringF::GetFormatf(_FN("_%u"), ++_nFileSeq);
+    } else {
+        _sFileTitleLast = sFileName;
+        _nFileSeq = 0;
+    }
+    sFileName += _FN(MIME_EXT_log);
+    const HRESULT hRes = _File.OpenX(cFilePath::CombineFilePathX(_sDir, sFileName), OF_CREATE | OF_WRITE | OF_APPEND | OF_SHARE_DENY_NONE | OF_TEXT);
+    if (FAILED(hRes)) return hRes;
+    _nFileSize = _File.GetLength();
+    _nFileTime = (_nRotateTime > 0) ? (tNow.GetTime() / _nRotateTime) : 0;
+    return S_OK;
+}
+
+HRESULT cLogSinkFile::WriteFile(const cMemSpan& m) {
+    // ASSUME _Lock.
+    // Use cOSHandle directly. cFile would log its errors back to me.
+    if (!_File.isValidHandle()) {
+        const HRESULT hRes = OpenFileNew();
+        if (FAILED(hRes)) return hRes;
+    }
+    const HRESULT hRes = static_cast<const cOSHandle&>(_File).WriteX(m);
+    if (FAILED(hRes)) return hRes;
+    _nFileSize += m.get_SizeBytes();
+    _isSyncNeeded = true;
+    return hRes;
+}
+
+HRESULT cLogSinkFile::WriteBuf(bool bSync) {
+    // Write the buffer in one call. ASSUME _Lock.
+    HRESULT hRes = S_OK;
+    if (_nBufUsed > 0) {
+        hRes = WriteFile(cMemSpan(_Buf.GetTPtrC(), _nBufUsed));
+        _nBufUsed = 0;  // toss it on failure. nowhere else for it to go.
+    }
+
+    if (_isSyncNeeded && _eDurable != LOG_DURABLE_t::_None) {
+        if (bSync || _tSyncLast.get_AgeSys() >= _nSyncInterval) {
+            static_cast<const cOSHandle&>(_File).FlushX();
+            _tSyncLast.InitTimeNow();
+            _isSyncNeeded = false;
+        }
+    }
+
+    // Time to rotate ?
+    if (_File.isValidHandle()) {
+        bool bRotate = _nRotateSize > 0 && _nFileSize >= _nRotateSize;
+        if (!bRotate && _nRotateTime > 0) {
+            bRotate = (cTimeInt::GetTimeNow().GetTime() / _nRotateTime) != _nFileTime;
+        }
+        if (bRotate) {
+            if (_isSyncNeeded && _eDurable != LOG_DURABLE_t::_None) {
+                static_cast<const cOSHandle&>(_File).FlushX();
+                _isSyncNeeded = false;
+            }
+            _File.Close();  // next write opens a new file.
+        }
+    }
+    return hRes;
+}
+
+HRESULT cLogSinkFile::AddBuf(const cMemSpan& m) {
+    // ASSUME _Lock.
+    const size_t nSize = m.get_SizeBytes();
+    if (nSize <= 0) return S_OK;
+    HRESULT hRes = S_OK;
+    if (_nBufUsed + nSize > _Buf.get_SizeBytes()) {
+        hRes = WriteBuf(false);
+    }
+    if (nSize > _Buf.get_SizeBytes()) {
+        // Too big to buffer. Just write it.
+        hRes = WriteFile(m);
+        if (FAILED(hRes)) return hRes;
+        return WriteBuf(false);  // sync and rotate.
+    }
+    if (_nBufUsed == 0) {
+        _tBufFirst.InitTimeNow();
+    }
+    cMem::Copy(_Buf.GetTPtrW() + _nBufUsed, m.GetTPtrC(), nSize);
+    _nBufUsed += nSize;
+    return hRes;
+}
+
+void cLogSinkFile::Close() {
+    const auto guard(_Lock.Lock());
+    WriteBuf(_eDurable != LOG_DURABLE_t::_None);
+    _File.Close();
+}
+
+HRESULT cLogSinkFile::WriteString(const LOGCHAR_t* pszMsg) {  // override
+    if (StrT::IsNullOrEmpty(pszMsg)) return 0;
+    const auto guard(_Lock.Lock());
+    const HRESULT hRes = AddBuf(cMemSpan(pszMsg, StrT::Len(pszMsg) * sizeof(LOGCHAR_t)));
+    if (FAILED(hRes)) return hRes;
+    return 1;
+}
+
+HRESULT cLogSinkFile::FlushLogs() {  // override
+    const auto guard(_Lock.Lock());
+    return WriteBuf(true);
+}
+
+HRESULT cLogSinkFile::addEvent(cLogEvent& rEvent) noexcept {  // override
+    const cSpan<LOGCHAR_t> span = rEvent.get_FormattedSpan();  // format outside the lock. shared with other sinks.
+
+    const auto guard(_Lock.Lock());
+    HRESULT hRes = AddBuf(span);
+    if (_eDurable == LOG_DURABLE_t::_Error && rEvent.get_LogLevel() >= LOGLVL_t::_ERROR) {
+        hRes = WriteBuf(true);
+    } else if (_nBufUsed > 0 && _tBufFirst.get_AgeSys() >= _nFlushDelay) {
+        hRes = WriteBuf(false);
+    }
+    if (FAILED(hRes)) return hRes;
+    return 1;
+}
+}  // namespace Gray
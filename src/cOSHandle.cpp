@@ -24,6 +24,80 @@ int cOSHandle::IOCtl(int nCmd, int nArgs) const {
 }
 #endif
 
+HRESULT cOSHandle::ReadV(const cSpan<cMemSpan>& aRet) const noexcept {
+    size_t nSizeTotal = 0;
+#ifdef __linux__
+    static const ITERATE_t k_nIovMax = 64;  // per syscall. IOV_MAX is larger.
+    ::iovec aIov[k_nIovMax];
+    const cMemSpan* pRet = aRet.get_PtrConst();
+    for (ITERATE_t i = 0; i < aRet.GetSize();) {
+        const ITERATE_t nQty = cValT::Min(aRet.GetSize() - i, k_nIovMax);
+        size_t nSizeWant = 0;
+        for (ITERATE_t j = 0; j < nQty; j++) {
+            aIov[j].iov_base = pRet[i + j].get_BytePtrW();
+            aIov[j].iov_len = pRet[i + j].get_SizeBytes();
+            nSizeWant += aIov[j].iov_len;
+        }
+        const ssize_t nLengthRead = ::readv(_h, aIov, nQty);
+        if (nLengthRead < 0) {
+            if (nSizeTotal > 0) break;  // report what already moved.
+            return HResult::GetLastDef(HRESULT_WIN32_C(ERROR_READ_FAULT));
+        }
+        nSizeTotal += CastN(size_t, nLengthRead);
+        if (CastN(size_t, nLengthRead) < nSizeWant) break;  // EOF
+        i += nQty;
+    }
+#else
+    for (const cMemSpan& ret : aRet) {
+        const HRESULT hRes = ReadX(ret);
+        if (FAILED(hRes)) {
+            if (nSizeTotal > 0) break;  // report what already moved. the error will come again on the next call.
+            return hRes;
+        }
+        nSizeTotal += CastN(size_t, hRes);
+        if (CastN(size_t, hRes) < ret.get_SizeBytes()) break;  // EOF
+    }
+#endif
+    return CastN(HRESULT, nSizeTotal);
+}
+
+HRESULT cOSHandle::WriteV(const cSpan<cMemSpan>& aSrc) const noexcept {
+    size_t nSizeTotal = 0;
+#ifdef __linux__
+    static const ITERATE_t k_nIovMax = 64;
+    ::iovec aIov[k_nIovMax];
+    const cMemSpan* pSrc = aSrc.get_PtrConst();
+    for (ITERATE_t i = 0; i < aSrc.GetSize();) {
+        const ITERATE_t nQty = cValT::Min(aSrc.GetSize() - i, k_nIovMax);
+        size_t nSizeWant = 0;
+        for (ITERATE_t j = 0; j < nQty; j++) {
+            aIov[j].iov_base = const_cast<BYTE*>(pSrc[i + j].get_BytePtrC());
+            aIov[j].iov_len = pSrc[i + j].get_SizeBytes();
+            nSizeWant += aIov[j].iov_len;
+        }
+        const ssize_t nLengthWritten = ::writev(_h, aIov, nQty);
+        if (nLengthWritten < 0) {
+            if (nSizeTotal > 0) break;  // report what already moved.
+            return HResult::GetLastDef(HRESULT_WIN32_C(ERROR_WRITE_FAULT));
+        }
+        nSizeTotal += CastN(size_t, nLengthWritten);
+        if (CastN(size_t, nLengthWritten) < nSizeWant) break;  // partial. caller decides.
+        i += nQty;
+    }
+#else
+    for (const cMemSpan& src : aSrc) {
+        const HRESULT hRes = WriteX(src);
+        if (FAILED(hRes)) {
+            if (nSizeTotal > 0) break;  // report what already moved. the error will come again on the next call.
+            return hRes;
+        }
+        nSizeTotal += CastN(size_t, hRes);
+        if (CastN(size_t, hRes) < src.get_SizeBytes()) break;
+    }
+#endif
+    return CastN(HRESULT, nSizeTotal);
+}
+
 HRESULT cOSHandle::WaitForSingleObject(TIMESYSD_t dwMilliseconds) const {
     //! Wait for the handle _h to be signaled.
     //! HRESULT_WIN32_C(ERROR_WAIT_TIMEOUT) = after dwMilliseconds
@@ -35,7 +35,7 @@ void cOSModDynImpl::OnProcessDetach() {
 HRESULT cOSModDyn::LoadAndRegisterModule(const FILECHAR_t* pszPath, ::IUnknown* pContainer, UINT32 nLibVer) {
     if (pContainer == nullptr) return E_HANDLE;  // Must have some mechanism to inc its use count.
 
-    const ITERATE_t nAllocCountPrev = cHeap::g_Stats._Allocs;  // must be the same if we skip/unload the DLL !
+    const ITERATE_t nAllocCountPrev = cHeap::GetStats()._Allocs;  // must be the same if we skip/unload the DLL !
     UNREFERENCED_PARAMETER(nAllocCountPrev);
 
 #ifdef USE_64BIT
@@ -7,7 +7,9 @@
 #include "cRandom.h"
 #include "cStack.h"  // include this some palce just to compile.
 #include "cStream.h"
+#include "cThreadBase.h"
 #include "cThreadLock.h"
+#include "cTimeSys.h"
 #include "cUnitTest.h"
 #include "cValT.h"
 
@@ -63,7 +65,142 @@ HRESULT cStreamOutput::WriteString(const wchar_t* pszStr) {  //  virtual
     return hRes / sizeof(wchar_t);
 }
 
+/// <summary>
+/// Reader side of a pipelined cStreamOutput::WriteStream(). Fills a ring of buffers on its own thread while the caller writes.
+/// Block size adapts to the slower of the read and the write. from cStream::k_FILE_BLOCK_SIZE up to k_nSizeBlockMax.
+/// </summary>
+class cStreamPump final : public cThreadRef {
+ public:
+    static const INTER32_t k_nQtyBlocks = 3;                     /// one being read, one being written, one spare.
+    static const size_t k_nSizeBlockMax = (4 * 1024 * 1024);     /// more than this just wastes memory.
+    static const STREAM_POS_t k_nSizePipeMin = (1 * 1024 * 1024);  /// less than this is not worth a thread.
+
+    struct cBlock {
+        cBlob _Blob;
+        HRESULT _hRes = S_OK;      /// length read. 0 = end. -lt- 0 = error.
+        double _dSecRead = 0;      /// time to read it.
+        double _dSecWrite = 0;     /// time to write it. from the last use.
+    };
+
+    cStreamInput& _rInp;
+    const STREAM_POS_t _nSizeMax;
+    cBlock _aBlocks[k_nQtyBlocks];
+    INTER32_t VOLATILE _nQtyFilled = 0;   /// blocks the reader has filled. ever.
+    INTER32_t VOLATILE _nQtyEmptied = 0;  /// blocks the writer has released. ever.
+    INTER32_t VOLATILE _nWakeSeq = 0;     /// just 2 threads park on this. cThreadLockable::ParkAddr()
+    STREAM_POS_t _nPosRead = 0;           /// total read from _rInp. reader thread. read by the writer after it exits.
+
+ private:
+    size_t _nSizeBlock = cStream::k_FILE_BLOCK_SIZE;
+
+    /// <summary>
+    /// Double the block size if blocks go quickly. halve it if they are slow. Only full blocks tell us anything.
+    /// </summary>
+    void AdaptBlockSize(const cBlock& block) noexcept {
+        const double dSec = cValT::Max(block._dSecRead, block._dSecWrite);
+        if (dSec < 0.010) {
+            if (CastN(size_t, block._hRes) >= _nSizeBlock && _nSizeBlock < k_nSizeBlockMax) _nSizeBlock *= 2;
+        } else if (dSec > 0.100) {
+            if (_nSizeBlock > cStream::k_FILE_BLOCK_SIZE) _nSizeBlock /= 2;
+        }
+    }
+
+    void Wake() noexcept {
+        cThreadLockable::WakeAddr(&_nWakeSeq);
+    }
+
+ public:
+    cStreamPump(cStreamInput& rInp, STREAM_POS_t nSizeMax) noexcept : _rInp(rInp), _nSizeMax(nSizeMax) {}
+
+    THREAD_EXITCODE_t Run() override {
+        STREAM_POS_t& nPos = _nPosRead;
+        for (;;) {
+            // Wait for an empty block.
+            for (;;) {
+                if (isThreadStopping()) return THREAD_EXITCODE_OK;
+                const INTER32_t nWakeSeq = _nWakeSeq;
+                if (_nQtyFilled - _nQtyEmptied < k_nQtyBlocks) break;
+                cThreadLockable::ParkAddr(&_nWakeSeq, nWakeSeq, 10);
+            }
+
+            cBlock& block = _aBlocks[_nQtyFilled % k_nQtyBlocks];
+            if (block._hRes > 0) AdaptBlockSize(block);  // its last use tells us how fast it went.
+            const size_t nSizeBlock = CastN(size_t, cValT::Min<STREAM_POS_t>(_nSizeBlock, _nSizeMax - nPos));
+            if (nSizeBlock == 0) {
+                block._hRes = 0;  // done.
+            } else if (block._Blob.get_SizeBytes() < nSizeBlock && !block._Blob.AllocSize(nSizeBlock)) {
+                block._hRes = E_OUTOFMEMORY;
+            } else {
+                const cTimePerf tStart(true);
+                block._hRes = _rInp.ReadX(cMemSpan(block._Blob.get_BytePtrW(), nSizeBlock));
+                block._dSecRead = tStart.get_AgeSeconds();
+                if (block._hRes == HRESULT_WIN32_C(ERROR_HANDLE_EOF)) block._hRes = 0;  // legit end of file.
+                if (block._hRes > 0) nPos += block._hRes;
+            }
+
+            const HRESULT hRes = block._hRes;
+            InterlockedN::Increment(&_nQtyFilled);  // publish it.
+            Wake();
+            if (hRes <= 0) return THREAD_EXITCODE_OK;
+        }
+    }
+
+    /// <summary>
+    /// Write the blocks as the reader fills them. On the callers thread. ASSUME CreateThread() already called.
+    /// On cancel or write error _rInp is moved back to just after what was written. if it can seek.
+    /// </summary>
+    HRESULT RunWriter(cStreamOutput& rOut, IStreamProgressCallback* pProgress) {
+        HRESULT hRes = S_OK;
+        STREAM_POS_t nAmount = 0;
+        for (;;) {
+            // Wait for a full block.
+            for (;;) {
+                const INTER32_t nWakeSeq = _nWakeSeq;
+                if (_nQtyFilled != _nQtyEmptied) break;
+                cThreadLockable::ParkAddr(&_nWakeSeq, nWakeSeq, 10);
+            }
+
+            cBlock& block = _aBlocks[_nQtyEmptied % k_nQtyBlocks];
+            if (block._hRes <= 0) {
+                hRes = block._hRes;  // done or read error.
+                break;
+            }
+            const cTimePerf tStart(true);
+            hRes = rOut.WriteSpan(cMemSpan(block._Blob.get_BytePtrC(), CastN(size_t, block._hRes)));  // write it all or fail!
+            block._dSecWrite = tStart.get_AgeSeconds();
+            if (FAILED(hRes)) break;
+            nAmount += block._hRes;
+            InterlockedN::Increment(&_nQtyEmptied);  // give it back.
+            Wake();
+
+            if (pProgress != nullptr) {
+                hRes = pProgress->onProgressCallback(cStreamProgress(nAmount, _nSizeMax));
+                if (hRes != S_OK) break;  // cancel?
+            }
+        }
+
+        RequestStopThread();
+        Wake();
+        WaitForThreadExit(cTimeSys::k_INF);
+        if (_nPosRead > nAmount) {
+            // The reader got ahead. Put back what was never written. Same as the serial loop would leave it.
+            _rInp.SeekX(-CastN(STREAM_OFFSET_t, _nPosRead - nAmount), SEEK_t::_Cur);
+        }
+        if (hRes != S_OK) return hRes;
+        return CastN(HRESULT, nAmount);
+    }
+};
+
 HRESULT cStreamOutput::WriteStream(cStreamInput& stmIn, STREAM_POS_t nSizeMax, IStreamProgressCallback* pProgress, TIMESYSD_t nTimeout) {
+    if (nTimeout <= 0 && nSizeMax >= cStreamPump::k_nSizePipeMin && dynamic_cast<const void*>(this) != dynamic_cast<const void*>(&stmIn)) {
+        // Big transfer. Overlap the reads and the writes.
+        cRefPtr<cStreamPump> pPump(new cStreamPump(stmIn, nSizeMax));
+        if (SUCCEEDED(pPump->CreateThread())) {
+            return pPump->RunWriter(*this, pProgress);
+        }
+        // else no thread. just do it serially.
+    }
+
     const cTimeSys tStart(cTimeSys::GetTimeNow());
     cBlob blob(cStream::k_FILE_BLOCK_SIZE);  // temporary buffer.
     STREAM_POS_t dwAmount = 0;               // how much written so far.
@@ -101,14 +238,56 @@ HRESULT cStreamOutput::WriteStream(cStreamInput& stmIn, STREAM_POS_t nSizeMax, I
     return CastN(HRESULT, dwAmount);  // done.
 }
 
-HRESULT cStreamOutput::WriteSize(size_t nSize) {
+size_t GRAYCALL cStreamOutput::GetSizePacked(BYTE* pOut, size_t nSize) noexcept {  // static
+    size_t i = 0;
     while (nSize >= k_SIZE_MASK) {
-        const BYTE bSize = CastN(BYTE, (nSize & ~k_SIZE_MASK) | k_SIZE_MASK);  // take 7 bits.
-        const HRESULT hRes = WriteT(bSize);
-        if (FAILED(hRes)) return hRes;
+        pOut[i++] = CastN(BYTE, (nSize & ~k_SIZE_MASK) | k_SIZE_MASK);  // take 7 bits.
         nSize >>= 7;
     }
-    return WriteT(CastN(BYTE, nSize));  // end of dynamic range. last byte
+    pOut[i++] = CastN(BYTE, nSize);  // end of dynamic range. last byte
+    return i;
+}
+
+HRESULT cStreamOutput::WriteSize(size_t nSize) {
+    BYTE abSize[k_SIZE_PACKED_MAX];
+    return WriteSpan(cMemSpan(abSize, GetSizePacked(abSize, nSize)));  // all at once.
+}
+
+HRESULT cStreamOutput::WriteBlob(const cMemSpan& b) {
+    // size and data go out together. A single syscall for cFile.
+    BYTE abSize[k_SIZE_PACKED_MAX];
+    const cMemSpan aParts[2] = {cMemSpan(abSize, GetSizePacked(abSize, b.get_SizeBytes())), b};
+    const HRESULT hRes = WriteV(cSpan<cMemSpan>(aParts, b.isEmpty() ? 1 : 2));
+    if (FAILED(hRes)) return hRes;
+    if (CastN(size_t, hRes) != aParts[0].get_SizeBytes() + b.get_SizeBytes()) return HRESULT_WIN32_C(ERROR_WRITE_FAULT);
+    return CastN(HRESULT, b.get_SizeBytes());
+}
+
+HRESULT cStreamOutput::WriteAt(const cMemSpan& m, STREAM_POS_t nPos) {  // virtual
+    const STREAM_POS_t nPosPrev = GetPosition();
+    if (nPosPrev == k_STREAM_POS_ERR) return E_NOTIMPL;
+    HRESULT hRes = SeekX(CastN(STREAM_OFFSET_t, nPos), SEEK_t::_Set);
+    if (FAILED(hRes)) return hRes;
+    const HRESULT hResWrite = WriteX(m);
+    hRes = SeekX(CastN(STREAM_OFFSET_t, nPosPrev), SEEK_t::_Set);
+    if (FAILED(hResWrite)) return hResWrite;
+    if (FAILED(hRes)) return hRes;
+    return hResWrite;
+}
+
+HRESULT cStreamOutput::WriteV(const cSpan<cMemSpan>& aSrc) {  // virtual
+    size_t nSizeTotal = 0;
+    for (const cMemSpan& src : aSrc) {
+        if (src.isEmpty()) continue;
+        const HRESULT hRes = WriteX(src);
+        if (FAILED(hRes)) {
+            if (nSizeTotal > 0) break;  // report what already moved. the error will come again on the next call.
+            return hRes;
+        }
+        nSizeTotal += CastN(size_t, hRes);
+        if (CastN(size_t, hRes) < src.get_SizeBytes()) break;  // partial.
+    }
+    return CastN(HRESULT, nSizeTotal);
 }
 
 //*************************************************************************
@@ -194,6 +373,33 @@ HRESULT cStreamInput::ReadStringLine(cSpanX<wchar_t> ret) {  // virtual
     return i;
 }
 
+HRESULT cStreamInput::ReadAt(cMemSpan ret, STREAM_POS_t nPos) noexcept {  // virtual
+    const STREAM_POS_t nPosPrev = GetPosition();
+    if (nPosPrev == k_STREAM_POS_ERR) return E_NOTIMPL;
+    HRESULT hRes = SeekX(CastN(STREAM_OFFSET_t, nPos), SEEK_t::_Set);
+    if (FAILED(hRes)) return hRes;
+    const HRESULT hResRead = ReadX(ret);
+    hRes = SeekX(CastN(STREAM_OFFSET_t, nPosPrev), SEEK_t::_Set);
+    if (FAILED(hResRead)) return hResRead;
+    if (FAILED(hRes)) return hRes;
+    return hResRead;
+}
+
+HRESULT cStreamInput::ReadV(const cSpan<cMemSpan>& aRet) noexcept {  // virtual
+    size_t nSizeTotal = 0;
+    for (const cMemSpan& ret : aRet) {
+        if (ret.isEmpty()) continue;
+        const HRESULT hRes = ReadX(ret);
+        if (FAILED(hRes)) {
+            if (nSizeTotal > 0) break;  // report what already moved. the error will come again on the next call.
+            return hRes;
+        }
+        nSizeTotal += CastN(size_t, hRes);
+        if (CastN(size_t, hRes) < ret.get_SizeBytes()) break;  // EOF or no more data yet.
+    }
+    return CastN(HRESULT, nSizeTotal);
+}
+
 HRESULT cStreamInput::ReadPeek(cMemSpan ret) noexcept {  // virtual
     //! Peek ahead in the stream if possible. Non blocking.
     //! just try to read data but not remove from the queue.
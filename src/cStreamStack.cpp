@@ -93,14 +93,42 @@ HRESULT cStreamStackOut::WriteFlush() {
     return hRes;
 }
 
+HRESULT cStreamStackOut::WriteFlush(const cMemSpan& m) {
+    //! Push m out to _pStreamOut directly. No copy into the buffer unless it is not all taken.
+    //! ASSUME nothing is buffered. get_ReadQty() == 0. else m would go out ahead of it or split a packet.
+    //! Whatever of m is not taken gets buffered. ASSUME caller checked there is room for it.
+    //! @return length of m that was taken.
+
+    DEBUG_CHECK(get_ReadQty() == 0);
+    HRESULT hRes = 0;
+    size_t nDoneM = 0;
+    if (_pStreamOut != nullptr) {
+        hRes = _pStreamOut->WriteX(m);
+        if (SUCCEEDED(hRes)) nDoneM = cValT::Min(CastN(size_t, hRes), m.get_SizeBytes());
+    }
+    if (nDoneM < m.get_SizeBytes()) {
+        this->WriteSpanQ(cSpan<BYTE>(m.get_BytePtrC() + nDoneM, m.get_SizeBytes() - nDoneM), true);  // keep the rest.
+    }
+    ReadCommitCheck();
+    return hRes;
+}
+
 HRESULT cStreamStackPackets::WriteX(const cMemSpan& m) {  // virtual
-    //! Take all pData written to me and store in buffer.
+    //! Take all pData written to me. Send it directly if nothing is buffered. else buffer it behind the rest.
     //! @arg pData = nullptr = just test if it has enough room.
 
-    const ITERATE_t nWriteQty = this->WriteSpanQ(cSpan<BYTE>(m), true);
-    if (CastN(size_t, nWriteQty) < m.get_SizeBytes()) {
-        return HRESULT_WIN32_C(WSAEWOULDBLOCK);  // Just wait for the full packet.
+    if (!m.isNull() && get_ReadQty() == 0 && CastN(size_t, this->GetSpanWrite(CastN(ITERATE_t, m.get_SizeBytes())).GetSize()) >= m.get_SizeBytes()) {
+        // Nothing buffered. m goes out alone in one call. No copy of m unless it is not taken.
+        const HRESULT hRes = this->WriteFlush(m);
+        if (FAILED(hRes)) return hRes;
+    } else {
+        // Test. or append to the buffered data so it goes out contiguous.
+        const ITERATE_t nWriteQty = this->WriteSpanQ(cSpan<BYTE>(m), true);
+        if (CastN(size_t, nWriteQty) < m.get_SizeBytes()) {
+            return HRESULT_WIN32_C(WSAEWOULDBLOCK);  // Just wait for the full packet.
+        }
     }
+    const ITERATE_t nWriteQty = CastN(ITERATE_t, m.get_SizeBytes());
 
     // Push all the data from the buffer m to _pStreamOut
     for (;;) {
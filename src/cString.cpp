@@ -13,7 +13,7 @@
 #include "StrConst.h"
 #include "StrU.h"
 #include "cArchive.h"
-#include "cHeap.h"
+#include "cHeapArena.h"
 #include "cStream.h"
 #include "cString.h"
 
@@ -33,15 +33,37 @@ void cStringT<_TYPE_CH>::AllocBuffer(StrLen_t iNewLength) {
         return;
     }
 
+    const StrLen_t nOldLen = GetLength();
+    if (iNewLength <= k_nInlineMax) {
+        // Short. Keep it inline. No heap.
+        if (!isInline() && !IsEmpty()) {
+            // Copy out first. _aInline overlaps _pchData.
+            HEAD_t* pHeadOld = get_Head();
+            _TYPE_CH aTmp[k_nInlineSize];
+            const StrLen_t nCopyLen = cValT::Min(iNewLength, nOldLen);
+            cMem::Copy(aTmp, _pchData, nCopyLen * sizeof(_TYPE_CH));
+            pHeadOld->DecRefCount();  // release ref to previous string.
+            cMem::Copy(_aInline, aTmp, nCopyLen * sizeof(_TYPE_CH));
+        }
+        put_InlineLength(iNewLength);  // might just be trimming an existing string.
+        return;
+    }
+
     HEAD_t* pHeadNew;
-    if (_pchData == &k_Nil) {
+    if (IsEmpty()) {
         // Make a new string.
         pHeadNew = HEAD_t::CreateStringData(iNewLength);  // allocate extra space and call its constructor
         ASSERT_NN(pHeadNew);
         pHeadNew->IncRefCount();
+    } else if (isInline()) {
+        // Grew too big for inline. Move it to the heap.
+        pHeadNew = HEAD_t::CreateStringData(iNewLength);
+        ASSERT_NN(pHeadNew);
+        pHeadNew->IncRefCount();
+        cMem::Copy(pHeadNew->get_PtrWork(), _aInline, nOldLen * sizeof(_TYPE_CH));
+        _aInline[k_nInlineSize - 1] = '\0';  // heap mode.
     } else {
         auto pHeadOld = get_Head();
-        StrLen_t nOldLen = pHeadOld->get_CharCount();
         const REFCOUNT_t iRefCount = pHeadOld->get_RefCount();
         if (iRefCount == 1) {
             // just change the existing ref. or it may be the same size.
@@ -60,7 +82,7 @@ void cStringT<_TYPE_CH>::AllocBuffer(StrLen_t iNewLength) {
         }
     }
 
-    ASSERT(cHeap::GetSize(pHeadNew) >= (sizeof(HEAD_t) + ((iNewLength + 1) * sizeof(_TYPE_CH))));
+    ASSERT(cHeapArenaHook::GetSize(pHeadNew) >= (sizeof(HEAD_t) + ((iNewLength + 1) * sizeof(_TYPE_CH))));
 
     _pchData = pHeadNew->get_PtrWork();
     _pchData[iNewLength] = '\0';  // might just be trimming an existing string.
@@ -69,7 +91,7 @@ void cStringT<_TYPE_CH>::AllocBuffer(StrLen_t iNewLength) {
 template <typename _TYPE_CH>
 void cStringT<_TYPE_CH>::CloneBeforeWrite() {
     // This might not be thread safe ?! if we start with 1 ref we may make another before we are done!
-    if (IsEmpty()) return;
+    if (IsEmpty() || isInline()) return;  // inline is always mine.
     const HEAD_t* pHead = get_Head();
     if (pHead->get_RefCount() > 1) {
         // dupe if there are other viewers.
@@ -77,27 +99,34 @@ void cStringT<_TYPE_CH>::CloneBeforeWrite() {
     } else {
         // i solely own this and i can do as a please with it.
     }
-    ASSERT(pHead->get_RefCount() <= 1);
+    ASSERT(get_RefCount() <= 1);
+    if (!isInline()) get_Head()->ClearHashCode();  // chars are about to change.
 }
 
 template <typename _TYPE_CH>
 void cStringT<_TYPE_CH>::ReleaseBuffer(StrLen_t nNewLength) {
-    if (_pchData == &k_Nil) {
+    if (IsEmpty()) {
         ASSERT(nNewLength == 0);
         return;
     }
-    HEAD_t* pHead = get_Head();
-    ASSERT(pHead->get_RefCount() == 1);
-    if (nNewLength <= k_StrLen_UNK) nNewLength = StrT::Len(_pchData);  // default to current length
+    _TYPE_CH* pData = get_PtrWork();
+    if (nNewLength <= k_StrLen_UNK) nNewLength = StrT::Len(pData);  // default to current length
 
     if (nNewLength <= 0) {
         SetEmptyValid();  // make sure we all use k_Nil for empty. NOT nullptr
         return;
     }
+    if (isInline()) {
+        ASSERT(nNewLength <= GetLength());
+        put_InlineLength(nNewLength);
+        return;
+    }
+    HEAD_t* pHead = get_Head();
+    ASSERT(pHead->get_RefCount() == 1);
     if (nNewLength != pHead->get_CharCount()) {
         // Shrink allocation ? or Leave allocation size the same ??
         ASSERT(nNewLength <= pHead->get_CharCount());
-        _pchData[nNewLength] = '\0';              // Can we assume this is already true ?
+        pData[nNewLength] = '\0';                 // Can we assume this is already true ?
         pHead->ShrinkHead(nNewLength + 1, false);  // just shorten length.
     }
     ASSERT(isValidString());
@@ -111,13 +140,9 @@ _TYPE_CH* cStringT<_TYPE_CH>::GetBuffer(StrLen_t iMinLength) {
     } else {
         CloneBeforeWrite();  // assume it is going to be changed.
     }
-#ifdef _DEBUG
-    if (iMinLength > 0) {  // k_Nil is special. Cant call GetData()
-        HEAD_t* pHead = get_Head();
-        ASSERT(pHead->get_CharCount() >= iMinLength);
-    }
-#endif
-    return _pchData;
+    ASSERT(GetLength() >= iMinLength);
+    if (IsEmpty()) return _pchData;  // k_Nil is special.
+    return get_PtrWork();
 }
 
 template <typename _TYPE_CH>
@@ -127,7 +152,8 @@ void cStringT<_TYPE_CH>::AssignSpanT(const cSpan<_TYPE_CH>& src) {
         return;
     }
     const StrLen_t iLenCur = GetLength();         // current stated length of the string.
-    if (src.get_PtrConst() == _pchData) {        // Same string.
+    const _TYPE_CH* pchCur = get_CPtr();
+    if (src.get_PtrConst() == pchCur) {          // Same string.
         if (src.get_MaxLen() >= iLenCur) return;  // do nothing!
         Assign(Left(src.get_MaxLen()));           // truncate length.
         return;
@@ -137,14 +163,13 @@ void cStringT<_TYPE_CH>::AssignSpanT(const cSpan<_TYPE_CH>& src) {
     if (src.isNull()) {
         // just allocate the space and leave it blank.
         AllocBuffer(src.get_MaxLen());
-        ASSERT_NN(_pchData);
-        ASSERT(_pchData != &k_Nil);
-        _pchData[0] = '\0';
+        ASSERT(!IsEmpty());
+        get_PtrWork()[0] = '\0';
         return;
     }
 
     const _TYPE_CH* pszStr = src.get_PtrConst();
-    if (pszStr >= _pchData && pszStr <= _pchData + iLenCur) {  // overlap?
+    if (pszStr >= pchCur && pszStr <= pchCur + iLenCur) {  // overlap?
         // Part of the same string so be safe !!
         THIS_t sTmp(src);  // make a copy first!
         Assign(sTmp);
@@ -153,9 +178,8 @@ void cStringT<_TYPE_CH>::AssignSpanT(const cSpan<_TYPE_CH>& src) {
 
     const StrLen_t lenNew = src.get_MaxLen();
     AllocBuffer(lenNew);
-    ASSERT_NN(_pchData);
-    ASSERT(_pchData != &k_Nil);
-    StrT::CopyLen(_pchData, pszStr, lenNew + 1);
+    ASSERT(!IsEmpty());
+    StrT::CopyLen(get_PtrWork(), pszStr, lenNew + 1);
     ASSERT(isValidString());
 }
 
@@ -165,7 +189,8 @@ void cStringT<char>::AssignSpan(const cSpan<wchar_t>& src) {
     // Convert UNICODE to UTF8
     const StrLen_t iLenNew = StrU::UNICODEtoUTF8Size(src);
     AllocBuffer(iLenNew);
-    StrU::UNICODEtoUTF8(cSpanX<char>(_pchData, iLenNew + 1), src);
+    if (iLenNew <= 0) return;
+    StrU::UNICODEtoUTF8(cSpanX<char>(get_PtrWork(), iLenNew + 1), src);
 }
 template <>
 void cStringT<char>::AssignSpan(const cSpan<char>& src) {
@@ -188,7 +213,8 @@ void cStringT<wchar_t>::AssignSpan(const cSpan<char>& src) {
     // Convert UTF8 to UNICODE
     const StrLen_t iLenNew = StrU::UTF8toUNICODELen(src);
     AllocBuffer(iLenNew);
-    StrU::UTF8toUNICODE(cSpanX<wchar_t>(_pchData, iLenNew + 1), src);
+    if (iLenNew <= 0) return;
+    StrU::UTF8toUNICODE(cSpanX<wchar_t>(get_PtrWork(), iLenNew + 1), src);
 }
 template <>
 void cStringT<wchar_t>::AssignSpan(const cSpan<wchar_t>& src) {
@@ -222,8 +248,9 @@ StrLen_t cStringT<_TYPE_CH>::Insert(StrLen_t i, _TYPE_CH ch) {
     const StrLen_t lenOld = GetLength();
     if (i > lenOld) i = lenOld;
     AllocBuffer(lenOld + 1);
-    cMem::CopyOverlap(_pchData + i + 1, _pchData + i, lenOld - i);
-    _pchData[i] = ch;
+    _TYPE_CH* pData = get_PtrWork();
+    cMem::CopyOverlap(pData + i + 1, pData + i, (lenOld - i) * sizeof(_TYPE_CH));
+    pData[i] = ch;
     return GetLength();
 }
 
@@ -239,8 +266,9 @@ StrLen_t cStringT<_TYPE_CH>::InsertSpan(StrLen_t i, const cSpan<_TYPE_CH>& src)
             return k_ITERATE_BAD;
         }
         AllocBuffer(lenOld + lenCat);
-        cMem::CopyOverlap(_pchData + i + lenCat, _pchData + i, (lenOld - i) * sizeof(_TYPE_CH));
-        cMem::Copy(_pchData + i, src, lenCat * sizeof(_TYPE_CH));
+        _TYPE_CH* pData = get_PtrWork();
+        cMem::CopyOverlap(pData + i + lenCat, pData + i, (lenOld - i) * sizeof(_TYPE_CH));
+        cMem::Copy(pData + i, src, lenCat * sizeof(_TYPE_CH));
     }
     return GetLength();
 }
@@ -278,7 +306,7 @@ template <typename _TYPE_CH>
 StrLen_t cStringT<_TYPE_CH>::Find(_TYPE_CH ch, StrLen_t nPosStart) const {
     const StrLen_t iLen = GetLength();
     if (nPosStart > iLen) return k_ITERATE_BAD;  // ch might be '\0' ?
-    const StrLen_t nIndex = StrT::FindCharN(_pchData + nPosStart, ch);
+    const StrLen_t nIndex = StrT::FindCharN(get_CPtr() + nPosStart, ch);
     if (nIndex < 0) return k_ITERATE_BAD;
     return nIndex + nPosStart;
 }
@@ -289,7 +317,7 @@ void cStringT<_TYPE_CH>::MakeUpper() {
     //! No portable __linux__ equiv to _strupr()?
     //! Like MFC CString::MakeUpper(), Similar to .NET String.ToUpper(). BUT NOT THE SAME.
     CloneBeforeWrite();
-    StrT::MakeUpperCase(_pchData, GetLength());
+    StrT::MakeUpperCase(get_PtrWork(), GetLength());
     ASSERT(isValidString());
 }
 
@@ -299,7 +327,7 @@ void cStringT<_TYPE_CH>::MakeLower() {
     //! No portable __linux__ equiv to strlwr()?
     //! Like MFC CString::MakeLower(), Similar to .NET String.ToLower() BUT NOT THE SAME.
     CloneBeforeWrite();
-    StrT::MakeLowerCase(_pchData, GetLength());
+    StrT::MakeLowerCase(get_PtrWork(), GetLength());
     ASSERT(isValidString());
 }
 
@@ -377,10 +405,11 @@ template <typename _TYPE_CH>
 cStringT<_TYPE_CH> cStringT<_TYPE_CH>::GetTrimWhitespace() const {
     // Trim whitespace from both ends.
     const StrLen_t lenOld = GetLength();
-    const StrLen_t left = StrT::GetNonWhitespaceN(_pchData, lenOld);
-    const StrLen_t right = StrT::GetWhitespaceEnd(ToSpan(_pchData, lenOld));
+    const _TYPE_CH* pData = get_CPtr();
+    const StrLen_t left = StrT::GetNonWhitespaceN(pData, lenOld);
+    const StrLen_t right = StrT::GetWhitespaceEnd(ToSpan(pData, lenOld));
     if (left == 0 && right == lenOld) return *this;  // no whitespace.
-    return ToSpan(_pchData + left, right - left);
+    return ToSpan(pData + left, right - left);
 }
 
 template <typename _TYPE_CH>
@@ -7,8 +7,26 @@
 
 namespace Gray {
 
-HRESULT cTextReaderStream::ReadStringLine(OUT const char** ppszLine) {   
+HRESULT cTextReaderStream::ReadStringLine(OUT const char** ppszLine) {
     ITERATE_t iReadAvail = this->get_ReadQty();
+    if (iReadAvail <= 0) {
+        // Zero copy. Serve the line straight from the source if it can. e.g. cFileMapped.
+        const cMemSpan span = _rInp.GetReadSpan(CastN(size_t, this->_nGrowSizeMax));
+        if (!span.isEmpty()) {
+            this->SetEmptyQ();  // nothing buffered. keep SeekX() sane.
+            const size_t nSizeScan = cValT::Min<size_t>(span.get_SizeBytes(), CastN(size_t, this->_nGrowSizeMax));
+            const char* pLine = PtrCast<char>(span.get_BytePtrC());
+            const char* pEnd = PtrCast<char>(::memchr(pLine, '\n', nSizeScan));
+            const size_t nSizeLine = (pEnd != nullptr) ? (CastN(size_t, pEnd - pLine) + 1) : nSizeScan;  // include '\n'. else line is too long or last.
+            const HRESULT hRes = _rInp.ReadX(cMemSpan(nullptr, nSizeLine));  // skip over it.
+            if (FAILED(hRes)) return hRes;
+            _iLineNumCur++;
+            if (ppszLine != nullptr) {
+                *ppszLine = pLine;
+            }
+            return CastN(HRESULT, nSizeLine);
+        }
+    }
     const char* pData = (const char*)this->get_ReadPtr();
     int i = 0;
     for (;; i++) {
@@ -5,6 +5,8 @@
 // clang-format on
 #include "cThreadBase.h"
 #include "cExceptionSystem.h"
+#include "cTraceExporter.h"
+#include "cTypeInfo.h"
 
 namespace Gray {
 bool cThreadState::WaitForThreadExit(TIMESYSD_t iTimeMSec) noexcept {  // virtual
@@ -29,6 +31,7 @@ void cThreadRef::onThreadCreate() {  // virtual
 #if defined(_CPPUNWIND)
     cExceptionSystem::InitForCurrentThread();  // must be called for each thread.
 #endif
+    cTraceScope::SetThreadName(GETTYPEINFO(*this).get_SymName());  // static text.
 }
 
 void cThreadRef::onThreadExit(THREAD_EXITCODE_t nExitCode) {  // virtual
@@ -5,54 +5,105 @@
 // clang-format on
 #include "cThreadLock.h"
 
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32) && (_WIN32_WINNT >= 0x0602)  // _WIN32_WINNT_WIN8
+#pragma comment(lib, "Synchronization.lib")        // WaitOnAddress()
+#endif
+
 namespace Gray {
 
 bool cLockableBase::WaitUnique(TIMESYSD_t nWaitMS) {
-    TIMESYSD_t nWaitCount = 0;
-    TIMESYSD_t nWaitTickMS = 0;  // No wait the first tick.
-    while (!this->isLockCount()) {
-        if (nWaitMS <= 0) return false;        // FAILED to lock in time.
-        cThreadId::SleepCurrent(nWaitTickMS);  // wait for a tick.
-        nWaitTickMS = 1;
-        if (nWaitMS != cTimeSys::k_INF) nWaitMS--;
-        nWaitCount++;  // Count how long i had to wait. for _DEBUG.
+    // Backoff: pause, then yield, then sleep a tick at a time.
+    TIMESYSD_t nWaitCount = 0;  // Count how long i had to wait. for _DEBUG.
+    while (this->isLockCount()) {
+        if (nWaitMS <= 0) return false;  // FAILED to lock in time.
+        if (nWaitCount < cThreadLockable::k_nSpinPause) {
+            cThreadId::PauseCurrent();
+        } else if (nWaitCount < cThreadLockable::k_nSpinPause + cThreadLockable::k_nSpinYield) {
+            cThreadId::YieldCurrent();
+        } else {
+            cThreadId::SleepCurrent(1);  // wait for a tick.
+            if (nWaitMS != cTimeSys::k_INF) nWaitMS--;
+        }
+        nWaitCount++;
     }
     return true;
 }
 
+#if defined(__linux__)
+void GRAYCALL cThreadLockable::ParkAddr(INTER32_t VOLATILE* pWakeSeq, INTER32_t nWakeSeq, TIMESYSD_t nWaitMS) noexcept {
+    // FUTEX_WAIT returns right away if *pWakeSeq != nWakeSeq. so we can't miss a wake.
+    cTimeSpec tSpec(nWaitMS);
+    ::syscall(SYS_futex, pWakeSeq, FUTEX_WAIT_PRIVATE, nWakeSeq, (nWaitMS == cTimeSys::k_INF) ? nullptr : &tSpec, nullptr, 0);
+}
+void GRAYCALL cThreadLockable::WakeAddr(INTER32_t VOLATILE* pWakeSeq) noexcept {
+    InterlockedN::Increment(pWakeSeq);
+    ::syscall(SYS_futex, pWakeSeq, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+#elif defined(_WIN32) && (_WIN32_WINNT >= 0x0602)  // _WIN32_WINNT_WIN8
+void GRAYCALL cThreadLockable::ParkAddr(INTER32_t VOLATILE* pWakeSeq, INTER32_t nWakeSeq, TIMESYSD_t nWaitMS) noexcept {
+    ::WaitOnAddress(const_cast<INTER32_t*>(pWakeSeq), &nWakeSeq, sizeof(nWakeSeq), (nWaitMS == cTimeSys::k_INF) ? INFINITE : CastN(DWORD, nWaitMS));
+}
+void GRAYCALL cThreadLockable::WakeAddr(INTER32_t VOLATILE* pWakeSeq) noexcept {
+    InterlockedN::Increment(pWakeSeq);
+    ::WakeByAddressSingle(const_cast<INTER32_t*>(pWakeSeq));
+}
+#else
+void GRAYCALL cThreadLockable::ParkAddr(INTER32_t VOLATILE* pWakeSeq, INTER32_t nWakeSeq, TIMESYSD_t nWaitMS) noexcept {
+    // No address wait available. just poll.
+    UNREFERENCED_PARAMETER(pWakeSeq);
+    UNREFERENCED_PARAMETER(nWakeSeq);
+    UNREFERENCED_PARAMETER(nWaitMS);
+    cThreadId::SleepCurrent(1);
+}
+void GRAYCALL cThreadLockable::WakeAddr(INTER32_t VOLATILE* pWakeSeq) noexcept {
+    InterlockedN::Increment(pWakeSeq);
+}
+#endif
+
 bool cThreadLockable::LockThread(const THREADID_t nTid, TIMESYSD_t nWaitMS) {
     ASSERT(cThreadId::IsValidId(nTid));
     ASSERT(nWaitMS == cTimeSys::k_INF || nWaitMS >= 0);  // not negative.
-#ifdef _DEBUG
-    TIMESYSD_t nWaitCount = 0;
-#endif
-    TIMESYSD_t nWaitTickMS = 0; // No wait the first tick.
-    for (;;) {
-        const THREADID_t nTidOwnerPrev = InterlockedN::CompareExchange(&_ThreadLockOwner, nTid, cThreadId::k_NULL);
-        if (nTidOwnerPrev == cThreadId::k_NULL || cThreadId::IsEqualId(nTidOwnerPrev, nTid)) {  // i got it. (or already had it)
-            IncLockCount();
+
+    // Spin first. Most collisions clear fast.
+    for (int iSpin = 0;; iSpin++) {
+        if (LockThreadTry(nTid)) {
             ASSERT(IsThreadLockOwner(nTid));  // i locked it!
             return true;
         }
+        if (nWaitMS == 0) return false;  // FAILED to lock in time.
+        if (iSpin < k_nSpinPause) {
+            cThreadId::PauseCurrent();
+        } else if (iSpin < k_nSpinPause + k_nSpinYield) {
+            cThreadId::YieldCurrent();
+        } else {
+            break;
+        }
+    }
 
-        // Some other thread owns the lock. Wait.
-        ASSERT(cThreadId::IsValidId(nTidOwnerPrev));
-
-        if (nWaitMS == 0) {
-#ifdef _DEBUG
-            if (nWaitCount) {
-                // DEBUG_CHECK(0);	// collide cleared.
+    // Some other thread owns the lock. Park till Unlock wakes me.
+    const TIMESYS_t tStart = cTimeSys::GetTimeNow();
+    for (;;) {
+        const INTER32_t nWakeSeq = _nWakeSeq;  // read before _nWaiters++ and try so we can't miss a wake.
+        InterlockedN::Increment(&_nWaiters);
+        if (LockThreadTry(nTid)) {
+            InterlockedN::Decrement(&_nWaiters);
+            ASSERT(IsThreadLockOwner(nTid));  // i locked it!
+            return true;
+        }
+        TIMESYSD_t nWaitLeft = nWaitMS;
+        if (nWaitMS != cTimeSys::k_INF) {
+            nWaitLeft = nWaitMS - CastN(TIMESYSD_t, cTimeSys::GetTimeNow() - tStart);
+            if (nWaitLeft <= 0) {
+                InterlockedN::Decrement(&_nWaiters);
+                return false;  // FAILED to lock in time.
             }
-#endif
-            return false;  // FAILED to lock in time.
         }
-        cThreadId::SleepCurrent(nWaitTickMS);  // wait for a tick.
-        nWaitTickMS = 1;
-        if (nWaitMS != cTimeSys::k_INF) nWaitMS--;
-
-#ifdef _DEBUG
-        nWaitCount++;  // Count how long i had to wait.
-#endif
+        ParkThread(nWakeSeq, nWaitLeft);
+        InterlockedN::Decrement(&_nWaiters);
     }
 }
 
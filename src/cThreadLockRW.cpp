@@ -1,9 +1,128 @@
 //! @file cThreadLockRW.cpp
 //! http://www.codeproject.com/KB/threads/ReadWriteLock.aspx?msg=1772196
 //! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
-//! @todo cThreadLockRW
 // clang-format off
 #include "pch.h"
 // clang-format on
 #include "cThreadLockRW.h"
 #include "cRefLockable.h"
+
+namespace Gray {
+
+/// How many read locks (on any cThreadLockRW) does this thread hold?
+/// If i already hold one, i must not wait for a writer, the writer may be waiting for me.
+static thread_local int s_nReadDepth = 0;
+
+int GRAYCALL cThreadLockRW::GetReaderShard() noexcept {  // static
+    // Thread ids are often aligned pointers. mix the bits to pick a shard.
+    const UINT64 nHash = CastN(UINT64, cThreadId::GetCurrentId()) * 11400714819323198485ULL;
+    return CastN(int, nHash >> 61) % kReaderShards;
+}
+
+void cThreadLockRW::UnlockReader(int iShard) noexcept {
+    InterlockedN::Decrement(&_aReaders[iShard]._nCount);  // Interlocked so the _nDrainWaiting read can't move before this.
+    if (_nDrainWaiting != 0) WakeAddr(&_nDrainSeq);
+}
+
+bool cThreadLockRW::WaitReaders(INTER32_t nReadersKeep, TIMESYSD_t nWaitMS) noexcept {
+    // ASSUME i own the base lock and _nWriterState == kWriterWait. So no new readers (except nested).
+    const TIMESYS_t tStart = cTimeSys::GetTimeNow();
+    for (int iSpin = 0;; iSpin++) {
+        const INTER32_t nDrainSeq = _nDrainSeq;  // read before the count so i can't miss a wake.
+        if (get_ReaderCount() <= nReadersKeep) {
+            // Claim it. Check again in case a reader got in before it could see kWriterOwns.
+            InterlockedN::Exchange(&_nWriterState, kWriterOwns);
+            if (get_ReaderCount() <= nReadersKeep) return true;
+            InterlockedN::Exchange(&_nWriterState, kWriterWait);
+            continue;
+        }
+        if (iSpin < k_nSpinPause) {
+            cThreadId::PauseCurrent();
+            continue;
+        }
+        if (iSpin < k_nSpinPause + k_nSpinYield) {
+            cThreadId::YieldCurrent();
+            continue;
+        }
+
+        // Readers are slow to leave. Park till the last one wakes me.
+        TIMESYSD_t nWaitLeft = nWaitMS;
+        if (nWaitMS != cTimeSys::k_INF) {
+            nWaitLeft = nWaitMS - CastN(TIMESYSD_t, cTimeSys::GetTimeNow() - tStart);
+            if (nWaitLeft <= 0) return false;  // FAILED to get exclusive in time.
+        }
+        InterlockedN::Exchange(&_nDrainWaiting, 1);
+        if (get_ReaderCount() > nReadersKeep) ParkAddr(&_nDrainSeq, nDrainSeq, nWaitLeft);
+        InterlockedN::Exchange(&_nDrainWaiting, 0);
+    }
+}
+
+bool cThreadLockRW::LockWrite(TIMESYSD_t nWaitMS) noexcept {
+    if (!LockThread(cThreadId::GetCurrentId(), nWaitMS)) return false;  // wait in line behind other writers.
+    if (get_LockCount() > 1) return true;  // I already have it.
+    InterlockedN::Exchange(&_nWriterState, kWriterWait);  // no new readers.
+    if (WaitReaders(0, nWaitMS)) return true;
+    InterlockedN::Exchange(&_nWriterState, kWriterNone);
+    UnlockThread();
+    return false;
+}
+
+void cThreadLockRW::Unlock() noexcept {  // override
+    DEBUG_CHECK(isThreadLockedByCurrent());
+    if (get_LockCount() == 1) {
+        InterlockedN::Exchange(&_nWriterState, kWriterNone);  // let readers go.
+    }
+    UnlockThread();
+}
+
+int cThreadLockRW::LockRead() noexcept {
+    if (this->isThreadLockedByCurrent()) {
+        // special case where i can allow this. downgrade.
+        SUPER_t::IncLockCount();
+        return kReaderDowngrade;
+    }
+    const int iShard = GetReaderShard();
+    InterlockedN::Increment(&_aReaders[iShard]._nCount);  // Interlocked so the _nWriterState read can't move before this.
+    const INTER32_t nWriterState = _nWriterState;
+    if (nWriterState != kWriterNone && !(nWriterState == kWriterWait && s_nReadDepth > 0)) {
+        // A writer is waiting or writing. back off and wait in line with the writers.
+        UnlockReader(iShard);
+        LockThread(cThreadId::GetCurrentId(), cTimeSys::k_INF);
+        InterlockedN::Increment(&_aReaders[iShard]._nCount);  // No writer can be here while i hold it.
+        UnlockThread();
+    }
+    s_nReadDepth++;
+    return iShard;
+}
+
+void cThreadLockRW::UnlockRead(int iShard) noexcept {
+    if (iShard == kReaderDowngrade) {
+        // special case where i can allow this. downgrade.
+        this->Unlock();
+        return;
+    }
+    ASSERT(iShard >= 0 && iShard < kReaderShards);
+    s_nReadDepth--;
+    UnlockReader(iShard);
+}
+
+bool cThreadLockRW::UpgradeRead(int iShard) noexcept {
+    if (iShard == kReaderDowngrade) {
+        SUPER_t::IncLockCount();  // I already own the write lock.
+        return true;
+    }
+    if (LockThreadTry(cThreadId::GetCurrentId())) {
+        // No other writer. Keep my read while the others drain so nothing can change under me.
+        InterlockedN::Exchange(&_nWriterState, kWriterWait);
+        WaitReaders(1, cTimeSys::k_INF);
+        UnlockRead(iShard);
+        SUPER_t::IncLockCount();  // one for the write guard and one for my old read.
+        return true;
+    }
+    // Another writer is ahead of me. It is waiting for my read to go.
+    UnlockRead(iShard);
+    LockWrite(cTimeSys::k_INF);
+    SUPER_t::IncLockCount();
+    return false;
+}
+}  // namespace Gray
@@ -0,0 +1,272 @@
+//! @file cThreadPool.cpp
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+// clang-format off
+#include "pch.h"
+// clang-format on
+#include "cBits.h"
+#include "cHeap.h"
+#include "cSystemInfo.h"
+#include "cThreadLock.h"
+#include "cThreadPool.h"
+
+namespace Gray {
+
+/// <summary>
+/// The worker (of any pool) running on the current thread. nullptr = not a pool worker.
+/// </summary>
+static thread_local cThreadPoolWorker* s_pWorkerCur = nullptr;
+
+void cThreadTaskGroup::CompleteTask() noexcept {
+    // Wait() may return and destroy this as soon as _nQtyPending is 0. _nQtyWaking holds it till we are done.
+    InterlockedN::Increment(&_nQtyWaking);
+    if (InterlockedN::Decrement(&_nQtyPending) == 0) {
+        cThreadLockable::WakeAddr(&_nWakeSeq);
+    }
+    InterlockedN::Decrement(&_nQtyWaking);
+}
+
+void cThreadTaskGroup::Run(cThreadTask* pTask) {
+    ASSERT_NN(pTask);
+    ASSERT(pTask->_pGroup == nullptr);
+    pTask->_pGroup = this;
+    InterlockedN::Increment(&_nQtyPending);
+    _rPool.SubmitX(pTask);
+}
+
+void cThreadTaskGroup::Wait() {
+    cThreadPoolWorker* pWorker = _rPool.get_WorkerCurrent();
+    for (int iSpin = 0; !isDone();) {
+        if (_nQtyPending == 0) {  // last completion is just leaving.
+            cThreadId::PauseCurrent();
+            continue;
+        }
+        // Help. Run my children (or anything else) rather than block.
+        cThreadTask* pTask = _rPool.FindTask(pWorker);
+        if (pTask != nullptr) {
+            _rPool.RunTaskX(pTask);
+            iSpin = 0;
+            continue;
+        }
+        if (iSpin < cThreadLockable::k_nSpinPause) {
+            cThreadId::PauseCurrent();
+        } else if (iSpin < cThreadLockable::k_nSpinPause + cThreadLockable::k_nSpinYield) {
+            cThreadId::YieldCurrent();
+        } else {
+            // Children are running on other workers. Park till the last one completes. Wake now and then to help.
+            const INTER32_t nWakeSeq = _nWakeSeq;
+            if (_nQtyPending != 0) cThreadLockable::ParkAddr(&_nWakeSeq, nWakeSeq, 10);
+            iSpin = 0;
+            continue;
+        }
+        iSpin++;
+    }
+}
+
+//**************************************************************
+
+cThreadPoolWorker::cThreadPoolWorker(cThreadPool& rPool, ITERATE_t iWorker, ITERATE_t nQtyTasks)
+    : _rPool(rPool),
+      _iWorker(iWorker),
+      _nMask(CastN(INTER32_t, (1U << cBits::Highest1Bit(CastN(UINT32, cValT::Max<ITERATE_t>(nQtyTasks, 2) - 1))) - 1)),
+      _nRandom(CastN(UINT32, iWorker) * 0x9E3779B9U + 1) {
+    _ppTasks = PtrCast<cThreadTask*>(cHeap::AllocPtr((_nMask + 1) * sizeof(cThreadTask*)));
+}
+
+cThreadPoolWorker::~cThreadPoolWorker() {
+    ASSERT(isEmptyApprox());
+    cHeap::FreePtr(_ppTasks);
+}
+
+bool cThreadPoolWorker::PushTask(cThreadTask* pTask) noexcept {
+    // Owner only.
+    const INTER32_t nBottom = _nBottom;
+    if (GetDiff(nBottom, _nTop) > _nMask) return false;  // full.
+    _ppTasks[nBottom & _nMask] = pTask;
+    InterlockedN::Exchange(&_nBottom, nBottom + 1);  // publish to thieves.
+    return true;
+}
+
+cThreadTask* cThreadPoolWorker::PopTask() noexcept {
+    // Owner only. Take the newest.
+    const INTER32_t nBottom = _nBottom - 1;
+    InterlockedN::Exchange(&_nBottom, nBottom);  // full barrier. thieves must see this before i read _nTop.
+    const INTER32_t nTop = _nTop;
+    const INTER32_t nDiff = GetDiff(nBottom, nTop);
+    if (nDiff < 0) {  // empty.
+        InterlockedN::Exchange(&_nBottom, nTop);
+        return nullptr;
+    }
+    cThreadTask* pTask = _ppTasks[nBottom & _nMask];
+    if (nDiff > 0) return pTask;  // more than one left. no race with thieves.
+    // Last one. Race thieves for it.
+    if (InterlockedN::CompareExchange(&_nTop, nTop + 1, nTop) != nTop) pTask = nullptr;
+    InterlockedN::Exchange(&_nBottom, nTop + 1);
+    return pTask;
+}
+
+cThreadTask* cThreadPoolWorker::StealTask() noexcept {
+    // Any thread. Take the oldest.
+    const INTER32_t nTop = _nTop;
+    const INTER32_t nBottom = _nBottom;
+    if (GetDiff(nBottom, nTop) <= 0) return nullptr;
+    cThreadTask* pTask = _ppTasks[nTop & _nMask];
+    if (InterlockedN::CompareExchange(&_nTop, nTop + 1, nTop) != nTop) return nullptr;  // lost the race. caller may try elsewhere.
+    return pTask;
+}
+
+THREAD_EXITCODE_t cThreadPoolWorker::Run() {  // override
+    s_pWorkerCur = this;
+    if (_rPool._bAffinity) {
+        const UINT nCpus = cValT::Max<UINT>(cSystemInfo::I().get_NumberOfProcessors(), 1);
+        const UINT nCpu = CastN(UINT, _iWorker) % nCpus;
+#ifdef _WIN32
+        ::SetThreadAffinityMask(::GetCurrentThread(), CastN(DWORD_PTR, 1) << (nCpu % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(nCpu % CPU_SETSIZE, &cpuset);
+        ::pthread_setaffinity_np(::pthread_self(), sizeof(cpuset), &cpuset);
+#endif
+    }
+
+    for (int iSpin = 0;;) {
+        cThreadTask* pTask = _rPool.FindTask(this);
+        if (pTask != nullptr) {
+            _rPool.RunTaskX(pTask);
+            iSpin = 0;
+            continue;
+        }
+        if (isThreadStopping()) break;  // all done.
+        if (iSpin < cThreadLockable::k_nSpinPause) {
+            cThreadId::PauseCurrent();
+        } else if (iSpin < cThreadLockable::k_nSpinPause + cThreadLockable::k_nSpinYield) {
+            cThreadId::YieldCurrent();
+        } else {
+            // Park. Submit wakes one if _nQtyIdle != 0. Interlocked so the check after can't miss a new task.
+            const INTER32_t nWakeSeq = _rPool._nWakeSeq;
+            InterlockedN::Increment(&_rPool._nQtyIdle);
+            pTask = _rPool.FindTask(this);
+            if (pTask == nullptr && !isThreadStopping()) {
+                cThreadLockable::ParkAddr(&_rPool._nWakeSeq, nWakeSeq, 100);
+            }
+            InterlockedN::Decrement(&_rPool._nQtyIdle);
+            if (pTask != nullptr) _rPool.RunTaskX(pTask);
+            iSpin = 0;
+            continue;
+        }
+        iSpin++;
+    }
+
+    s_pWorkerCur = nullptr;
+    return THREAD_EXITCODE_OK;
+}
+
+//**************************************************************
+
+cThreadPool::~cThreadPool() {
+    StopWorkers();
+}
+
+cThreadPoolWorker* cThreadPool::get_WorkerCurrent() const noexcept {
+    cThreadPoolWorker* pWorker = s_pWorkerCur;
+    if (pWorker == nullptr || &pWorker->_rPool != this) return nullptr;  // not my pool.
+    return pWorker;
+}
+
+cThreadTask* cThreadPool::FindTask(cThreadPoolWorker* pWorker) noexcept {
+    // My own newest first (cache warm), then the shared queue, then steal the oldest from someone else.
+    cThreadTask* pTask = nullptr;
+    if (pWorker != nullptr) {
+        pTask = pWorker->PopTask();
+        if (pTask != nullptr) return pTask;
+    }
+    if (_Inject.TryPop(pTask)) return pTask;
+
+    const ITERATE_t nWorkers = _aWorkers.GetSize();
+    if (nWorkers <= 0) return nullptr;
+    UINT32 nRandom;
+    if (pWorker != nullptr) {
+        pWorker->_nRandom ^= pWorker->_nRandom << 13;  // xorshift
+        pWorker->_nRandom ^= pWorker->_nRandom >> 17;
+        pWorker->_nRandom ^= pWorker->_nRandom << 5;
+        nRandom = pWorker->_nRandom;
+    } else {
+        nRandom = CastN(UINT32, CastPtrToNum(&pTask) >> 4);  // non worker helping in Wait(). any start is fine.
+    }
+    for (ITERATE_t i = 0; i < nWorkers; i++) {
+        cThreadPoolWorker* pVictim = _aWorkers[(CastN(ITERATE_t, nRandom % CastN(UINT32, nWorkers)) + i) % nWorkers];
+        if (pVictim == pWorker) continue;
+        pTask = pVictim->StealTask();
+        if (pTask != nullptr) return pTask;
+    }
+    return nullptr;
+}
+
+void cThreadPool::RunTaskX(cThreadTask* pTask) noexcept {
+    cThreadTaskGroup* pGroup = pTask->_pGroup;
+    pTask->RunTask();
+    pTask->DecRefCount();  // taken in SubmitX().
+    if (pGroup != nullptr) pGroup->CompleteTask();
+}
+
+void cThreadPool::SubmitX(cThreadTask* pTask) {
+    pTask->IncRefCount();  // held till RunTaskX().
+    cThreadPoolWorker* pWorker = get_WorkerCurrent();
+    if (pWorker != nullptr) {
+        if (!pWorker->PushTask(pTask)) {
+            RunTaskX(pTask);  // my deque is full. just do it now.
+            return;
+        }
+    } else if (_aWorkers.GetSize() <= 0 || !_Inject.TryPush(pTask)) {
+        RunTaskX(pTask);  // no workers or shared queue full. just do it now.
+        return;
+    }
+    if (_nQtyIdle != 0) cThreadLockable::WakeAddr(&_nWakeSeq);  // someone is parked. wake one.
+}
+
+void cThreadPool::Submit(cThreadTask* pTask) {
+    ASSERT_NN(pTask);
+    SubmitX(pTask);
+}
+
+HRESULT cThreadPool::StartWorkers(ITERATE_t nWorkers, bool bAffinity) {
+    StopWorkers();
+    if (nWorkers <= 0) nWorkers = CastN(ITERATE_t, cSystemInfo::I().get_NumberOfProcessors());
+    if (nWorkers <= 0) nWorkers = 1;
+    _bAffinity = bAffinity;
+
+    // Make them all before any run so they can steal from each other.
+    for (ITERATE_t i = 0; i < nWorkers; i++) {
+        _aWorkers.Add(new cThreadPoolWorker(*this, i, _Inject.get_QtyMax()));
+    }
+    for (ITERATE_t i = 0; i < nWorkers; i++) {
+        const HRESULT hRes = _aWorkers[i]->CreateThread();
+        if (FAILED(hRes)) {
+            StopWorkers();
+            return hRes;
+        }
+    }
+    return S_OK;
+}
+
+void cThreadPool::StopWorkers() {
+    const ITERATE_t nWorkers = _aWorkers.GetSize();
+    for (ITERATE_t i = 0; i < nWorkers; i++) {
+        _aWorkers[i]->RequestStopThread();
+    }
+    for (ITERATE_t i = 0; i < nWorkers; i++) {
+        cThreadLockable::WakeAddr(&_nWakeSeq);  // wakes one each.
+    }
+    for (ITERATE_t i = 0; i < nWorkers; i++) {
+        _aWorkers[i]->WaitForThreadExit(cTimeSys::k_INF);
+    }
+
+    // Run anything left in the deques of workers that never started, and the shared queue.
+    for (;;) {
+        cThreadTask* pTask = FindTask(nullptr);
+        if (pTask == nullptr) break;
+        RunTaskX(pTask);
+    }
+    _aWorkers.RemoveAll();
+}
+}  // namespace Gray
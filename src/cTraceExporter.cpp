@@ -0,0 +1,307 @@
+//! @file cTraceExporter.cpp
+//! @copyright 1992 - 2020 Dennis Robinson (http://www.menasoft.com)
+// clang-format off
+#include "pch.h"
+// clang-format on
+#include "cAppState.h"
+#include "cBits.h"
+#include "cHeap.h"
+#include "cHeapArena.h"
+#include "cThreadBase.h"
+#include "cTraceExporter.h"
+
+namespace Gray {
+
+bool cTraceScope::sm_bActive = false;  // static
+
+/// <summary>
+/// Ring of cTraceEvent for a single thread. Only the owner thread writes. Only one exporter reads (under cTraceExporter::_Lock).
+/// Positions are 32 bit and are allowed to wrap around. Events are dropped if the ring is full.
+/// Recycled for a new thread once its thread has exited and it is drained.
+/// </summary>
+struct cTraceThread {
+    ITERATE_t _nTid;                     /// 1 based id for the trace. not the system id. new for each thread using the ring.
+    bool _bFree = false;                 /// owner thread has exited. under cTraceExporter::_Lock.
+    const char* VOLATILE _pszName;       /// static text. cTraceScope::SetThreadName()
+    const char* _pszNameWritten = nullptr;  /// name last written to the trace.
+    const INTER32_t _nMask;              /// ring size - 1. power of 2.
+    cTraceEvent* _pEvents;
+    INTER32_t VOLATILE _nWritePos = 0;  /// next position to write. owner thread.
+    INTER32_t VOLATILE _nReadPos = 0;   /// next position to read. exporter.
+    UINT _nQtyDropped = 0;              /// events lost because the ring was full. owner thread.
+
+    cTraceThread(ITERATE_t nTid, const char* pszName, ITERATE_t nQtyMax)
+        : _nTid(nTid), _pszName(pszName), _nMask(CastN(INTER32_t, (1U << cBits::Highest1Bit(CastN(UINT32, cValT::Max<ITERATE_t>(nQtyMax, 2) - 1))) - 1)) {
+        _pEvents = PtrCast<cTraceEvent>(cHeap::AllocPtr((_nMask + 1) * sizeof(cTraceEvent)));
+    }
+    ~cTraceThread() {
+        cHeap::FreePtr(_pEvents);
+    }
+
+    void AddEvent(const char* pszName, TIMEPERF_t nTimeStart, TIMEPERF_t nTimeEnd) noexcept {
+        const INTER32_t nPos = _nWritePos;
+        if (CastN(UINT32, nPos) - CastN(UINT32, _nReadPos) > CastN(UINT32, _nMask)) {
+            _nQtyDropped++;
+            return;
+        }
+        cTraceEvent& rEvent = _pEvents[nPos & _nMask];
+        rEvent._pszName = pszName;
+        rEvent._nTimeStart = nTimeStart;
+        rEvent._nTimeEnd = nTimeEnd;
+        InterlockedN::Exchange(&_nWritePos, nPos + 1);  // publish to the exporter.
+    }
+};
+
+/// <summary>
+/// The current thread ring. nullptr = not yet made.
+/// </summary>
+static thread_local cTraceThread* s_pTraceThread = nullptr;
+static thread_local const char* s_pszTraceThreadName = nullptr;
+static thread_local bool s_bTraceThreadExited = false;  // don't make a new ring while thread_local objects are destroyed.
+
+/// <summary>
+/// Give the ring back when the thread exits. Separate from s_pTraceThread so the hot path has no thread_local init guard.
+/// </summary>
+struct cTraceThreadHolder {
+    cTraceThread* _pThread = nullptr;
+    ~cTraceThreadHolder() {
+        s_bTraceThreadExited = true;
+        s_pTraceThread = nullptr;
+        cTraceExporter* pExporter = cTraceExporter::get_SingleU();  // NOT I(). don't re-create it during static destruction.
+        if (_pThread != nullptr && pExporter != nullptr) pExporter->ReleaseThread(_pThread);
+    }
+};
+static thread_local cTraceThreadHolder s_TraceThreadHolder;
+
+TIMEPERF_t GRAYCALL cTraceScope::GetTimeStart() noexcept {  // static
+    return cTimePerf(true).get_Perf();
+}
+
+void cTraceScope::Record() noexcept {
+    const TIMEPERF_t nTimeEnd = cTimePerf(true).get_Perf();
+    cTraceThread* pThread = s_pTraceThread;
+    if (pThread == nullptr) {
+        cTraceExporter* pExporter = cTraceExporter::get_SingleU();  // NOT I(). may be called after the exporter is destroyed.
+        if (pExporter == nullptr) return;
+        pThread = pExporter->GetThreadCurrent();
+        if (pThread == nullptr) return;
+    }
+    pThread->AddEvent(_pszName, _nTimeStart, nTimeEnd);
+}
+
+void GRAYCALL cTraceScope::SetThreadName(const char* pszName) noexcept {  // static
+    s_pszTraceThreadName = pszName;
+    if (s_pTraceThread != nullptr) s_pTraceThread->_pszName = pszName;
+}
+
+//**************************************************************
+
+/// <summary>
+/// Background thread to drain events to the file. cTraceExporter::StartFile()
+/// </summary>
+class cTraceExportThread final : public cThreadRef {
+ public:
+    const TIMESYSD_t _nInterval;
+
+ public:
+    explicit cTraceExportThread(TIMESYSD_t nInterval) : _nInterval(nInterval) {}
+
+    THREAD_EXITCODE_t Run() override {
+        cTimeSys tLast(cTimeSys::GetTimeNow());
+        while (!isThreadStopping()) {
+            cThreadId::SleepCurrent(cValT::Min<TIMESYSD_t>(_nInterval, 100));  // check isThreadStopping() often.
+            if (tLast.get_AgeSys() < _nInterval) continue;
+            tLast.InitTimeNow();
+            cTraceExporter& rExporter = cTraceExporter::I();
+            const auto guard(rExporter._Lock.Lock());
+            if (!rExporter._File.isValidHandle()) continue;
+            rExporter.WriteEvents(rExporter._File);
+        }
+        return THREAD_EXITCODE_OK;
+    }
+};
+
+cSingleton_IMPL(cTraceExporter);
+
+cTraceExporter::cTraceExporter() : cSingleton<cTraceExporter>(this), _tStart(true) {}
+
+cTraceExporter::~cTraceExporter() {
+    cTraceScope::sm_bActive = false;
+    StopFile();
+    // Leak the rings. s_pTraceThread and open cTraceScope on other threads may still point at them.
+}
+
+cTraceThread* cTraceExporter::GetThreadCurrent() noexcept {
+    static thread_local bool s_bBusy = false;
+    if (s_pTraceThread != nullptr) return s_pTraceThread;
+    if (s_bBusy || s_bTraceThreadExited) return nullptr;  // scopes recorded while making the ring. (e.g. cHeap)
+
+    s_bBusy = true;
+    const auto guard(_Lock.Lock());
+    cTraceThread* pThread = nullptr;
+    for (cTraceThread* pThreadFree : _aThreads) {
+        // Reuse a ring from an exited thread once the exporter has drained it. or nobody is going to drain it.
+        if (pThreadFree->_bFree && (pThreadFree->_nReadPos == pThreadFree->_nWritePos || !_File.isValidHandle())) {
+            pThread = pThreadFree;
+            pThread->_nReadPos = pThread->_nWritePos;  // drop anything old.
+            pThread->_bFree = false;
+            pThread->_nTid = ++_nTidLast;
+            pThread->_pszName = s_pszTraceThreadName;
+            pThread->_pszNameWritten = nullptr;
+            pThread->_nQtyDropped = 0;
+            break;
+        }
+    }
+    if (pThread == nullptr) {
+        const cHeapArenaScope scopeHeap(nullptr);  // outlives any cHeapArena.
+        pThread = new cTraceThread(++_nTidLast, s_pszTraceThreadName, _nQtyEvents);
+        _aThreads.Add(pThread);
+    }
+    s_TraceThreadHolder._pThread = pThread;
+    s_pTraceThread = pThread;
+    s_bBusy = false;
+    return pThread;
+}
+
+void cTraceExporter::ReleaseThread(cTraceThread* pThread) noexcept {
+    const auto guard(_Lock.Lock());
+    _nQtyDroppedFree += pThread->_nQtyDropped;  // keep the total.
+    pThread->_nQtyDropped = 0;
+    pThread->_bFree = true;
+}
+
+double cTraceExporter::GetTimeStamp(TIMEPERF_t nTime) const noexcept {
+    // Chrome trace "ts" is in microseconds.
+    return cTimePerf::ToSeconds(nTime - _tStart.get_Perf()) * 1000000.0;
+}
+
+/// <summary>
+/// Copy static text as the inside of a JSON string.
+/// </summary>
+static void TraceNameJSON(cSpanX<char> ret, const char* pszName) noexcept {
+    char* pOut = ret.get_PtrWork();
+    StrLen_t iOut = 0;
+    const StrLen_t iOutMax = ret.GetSize() - 2;
+    for (const char* pIn = (pszName == nullptr) ? "" : pszName; *pIn != '\0' && iOut < iOutMax; pIn++) {
+        const char ch = *pIn;
+        if (ch == '\"' || ch == '\\') {
+            pOut[iOut++] = '\\';
+            pOut[iOut++] = ch;
+        } else {
+            pOut[iOut++] = CastN(BYTE, ch) < ' ' ? ' ' : ch;
+        }
+    }
+    pOut[iOut] = '\0';
+}
+
+HRESULT cTraceExporter::WriteEvent(ITextWriter& o, const char* pszFormat, ...) {
+    if (_nQtyWritten++ > 0) {
+        const HRESULT hRes = o.WriteString("," FILE_EOL);
+        if (FAILED(hRes)) return hRes;
+    }
+    ::va_list vargs;
+    va_start(vargs, pszFormat);
+    const HRESULT hRes = o.VPrintf(pszFormat, vargs);
+    va_end(vargs);
+    return hRes;
+}
+
+bool cTraceExporter::put_Active(bool bActive) {
+    cTraceScope::sm_bActive = bActive;
+    return true;
+}
+
+HRESULT cTraceExporter::WriteHeader(ITextWriter& o) {
+    _tStart.InitTimeNow();
+    _nQtyWritten = 0;
+    for (cTraceThread* pThread : _aThreads) {
+        pThread->_pszNameWritten = nullptr;  // write names again for the new file.
+    }
+    return o.WriteString("[" FILE_EOL);
+}
+
+HRESULT cTraceExporter::WriteEvents(ITextWriter& o) {
+    const auto guard(_Lock.Lock());
+    const unsigned nPid = CastN(unsigned, cAppState::get_CurrentProcessId());
+    char szName[StrT::k_LEN_Default];
+    HRESULT hRes = S_OK;
+    UINT nQtyDropped = _nQtyDroppedFree;
+
+    for (cTraceThread* pThread : _aThreads) {
+        nQtyDropped += pThread->_nQtyDropped;
+        const char* pszName = pThread->_pszName;
+        if (pszName != nullptr && pszName != pThread->_pszNameWritten) {
+            pThread->_pszNameWritten = pszName;
+            TraceNameJSON(TOSPAN(szName), pszName);
+            hRes = WriteEvent(o, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", nPid, pThread->_nTid, szName);
+            if (FAILED(hRes)) return hRes;
+        }
+
+        // Drain the ring. The owner may keep adding behind us.
+        const INTER32_t nWritePos = pThread->_nWritePos;
+        INTER32_t nPos = pThread->_nReadPos;
+        for (; nPos != nWritePos; nPos++) {
+            const cTraceEvent& rEvent = pThread->_pEvents[nPos & pThread->_nMask];
+            TraceNameJSON(TOSPAN(szName), rEvent._pszName);
+            hRes = WriteEvent(o, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", szName, nPid, pThread->_nTid,
+                              GetTimeStamp(rEvent._nTimeStart), cTimePerf::ToSeconds(rEvent._nTimeEnd - rEvent._nTimeStart) * 1000000.0);
+            if (FAILED(hRes)) break;
+        }
+        InterlockedN::Exchange(&pThread->_nReadPos, nPos);  // free for the owner.
+        if (FAILED(hRes)) return hRes;
+    }
+
+    // Counters as of now.
+    const double dTimeNow = GetTimeStamp(cTimePerf(true).get_Perf());
+    const cHeapStats stats = cHeap::GetStats();
+#ifdef USE_HEAP_STATS
+    hRes = WriteEvent(o, "{\"name\":\"Heap\",\"ph\":\"C\",\"pid\":%u,\"ts\":%.3f,\"args\":{\"Allocs\":%d,\"Total\":%llu}}", nPid, dTimeNow, CastN(int, stats._Allocs),
+                      CastN(unsigned long long, stats._Total));
+#else
+    hRes = WriteEvent(o, "{\"name\":\"Heap\",\"ph\":\"C\",\"pid\":%u,\"ts\":%.3f,\"args\":{\"Allocs\":%d}}", nPid, dTimeNow, CastN(int, stats._Allocs));
+#endif
+    if (FAILED(hRes) || nQtyDropped <= 0) return hRes;
+    return WriteEvent(o, "{\"name\":\"TraceDropped\",\"ph\":\"C\",\"pid\":%u,\"ts\":%.3f,\"args\":{\"Events\":%u}}", nPid, dTimeNow, nQtyDropped);
+}
+
+HRESULT cTraceExporter::WriteFooter(ITextWriter& o) {
+    return o.WriteString(FILE_EOL "]" FILE_EOL);
+}
+
+HRESULT cTraceExporter::StartFile(const FILECHAR_t* pszFile, TIMESYSD_t nInterval) {
+    StopFile();
+    {
+        const auto guard(_Lock.Lock());
+        HRESULT hRes = _File.OpenX(pszFile, OF_CREATE | OF_WRITE | OF_TEXT);
+        if (FAILED(hRes)) return hRes;
+        hRes = WriteHeader(_File);
+        if (FAILED(hRes)) return hRes;
+    }
+    put_Active(true);
+    cRefPtr<cTraceExportThread> pThread(new cTraceExportThread(nInterval));
+    const HRESULT hRes = pThread->CreateThread();
+    if (FAILED(hRes)) return hRes;
+    const auto guard(_Lock.Lock());
+    _pThread = pThread;
+    return hRes;
+}
+
+HRESULT cTraceExporter::StopFile() {
+    cRefPtr<cTraceExportThread> pThread;
+    {
+        const auto guard(_Lock.Lock());
+        pThread = _pThread;
+        _pThread.ReleasePtr();
+    }
+    if (pThread != nullptr) {
+        pThread->RequestStopThread();
+        pThread->WaitForThreadExit(10 * cTimeSys::k_FREQ);
+    }
+    const auto guard(_Lock.Lock());
+    if (!_File.isValidHandle()) return S_FALSE;
+    HRESULT hRes = WriteEvents(_File);  // final.
+    if (SUCCEEDED(hRes)) hRes = WriteFooter(_File);
+    _File.Close();
+    return hRes;
+}
+}  // namespace Gray
@@ -45,7 +45,7 @@ class GRAYCORE_LINK cUnitTestLogger : public cLogSink, public cRefBase {
 
     HRESULT addEvent(cLogEvent& rEvent) noexcept override {
         if (_File.isValidHandle()) {
-            _File.WriteString(rEvent.get_FormattedDefault());
+            _File.WriteString(rEvent.get_FormattedSpan().get_PtrConst());
         }
         return 1;
     }